@@ -0,0 +1,446 @@
+/*
+Title: GPU Simulated Particle System
+File Name: barnesHut.cpp
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "barnesHut.h"
+#include "particleSystem.h"
+#include "parallelPrimitives.h"
+#include <algorithm>
+#include <cstring>
+
+// Matches the Node struct in the barnesHut shaders.
+struct BarnesHutNode
+{
+    glm::vec4 m_centerOfMass;
+    glm::vec4 m_boundsMin;
+    glm::vec4 m_boundsMax;
+};
+
+// CPU versions of the shader functions, used to check the tree built on the GPU.
+static GLuint FloatToSortable(float f)
+{
+    GLuint u;
+    memcpy(&u, &f, sizeof(u));
+    return (u & 0x80000000) != 0 ? ~u : u | 0x80000000;
+}
+
+static float SortableToFloat(GLuint u)
+{
+    u = (u & 0x80000000) != 0 ? u & 0x7FFFFFFF : ~u;
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static GLuint ExpandBits(GLuint v)
+{
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+static glm::ivec3 MortonCell(glm::vec3 position, glm::vec3 boundsMin, glm::vec3 boundsMax)
+{
+    glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(1e-6f));
+    glm::vec3 normalized = (position - boundsMin) / extent;
+    return glm::ivec3(glm::clamp(normalized * 1024.f, glm::vec3(0), glm::vec3(1023)));
+}
+
+static int CountLeadingZeros(GLuint v)
+{
+    int count = 0;
+    for (GLuint bit = 0x80000000; bit != 0 && (v & bit) == 0; bit >>= 1)
+    {
+        count++;
+    }
+    return count;
+}
+
+static int Delta(const std::vector<GLuint>& keys, int a, int b)
+{
+    if (b < 0 || b >= (int)keys.size())
+    {
+        return -1;
+    }
+    if (keys[a] == keys[b])
+    {
+        return 32 + CountLeadingZeros(a ^ b);
+    }
+    return CountLeadingZeros(keys[a] ^ keys[b]);
+}
+
+// Same as radixTree.glsl, one internal node at a time.
+static void BuildRadixTree(const std::vector<GLuint>& keys, std::vector<glm::ivec2>& children, std::vector<int>& parents)
+{
+    int leafCount = (int)keys.size();
+    children.resize(leafCount - 1);
+    parents.resize(2 * leafCount - 1);
+    parents[0] = -1;
+
+    for (int i = 0; i < leafCount - 1; i++)
+    {
+        int direction = Delta(keys, i, i + 1) > Delta(keys, i, i - 1) ? 1 : -1;
+        int minDelta = Delta(keys, i, i - direction);
+
+        int maxLength = 2;
+        while (Delta(keys, i, i + maxLength * direction) > minDelta)
+        {
+            maxLength *= 2;
+        }
+
+        int length = 0;
+        for (int step = maxLength / 2; step >= 1; step /= 2)
+        {
+            if (Delta(keys, i, i + (length + step) * direction) > minDelta)
+            {
+                length += step;
+            }
+        }
+        int other = i + length * direction;
+
+        int nodeDelta = Delta(keys, i, other);
+        int split = 0;
+        int divisor = 2;
+        for (int step = (length + 1) / 2; step >= 1; step = (length + divisor - 1) / divisor)
+        {
+            if (Delta(keys, i, i + (split + step) * direction) > nodeDelta)
+            {
+                split += step;
+            }
+            if (step == 1)
+            {
+                break;
+            }
+            divisor *= 2;
+        }
+        int gamma = i + split * direction + std::min(direction, 0);
+
+        int left = std::min(i, other) == gamma ? leafCount - 1 + gamma : gamma;
+        int right = std::max(i, other) == gamma + 1 ? leafCount + gamma : gamma + 1;
+        children[i] = glm::ivec2(left, right);
+        parents[left] = i;
+        parents[right] = i;
+    }
+}
+
+// Number of work groups needed to give every item its own invocation.
+static int WorkGroups(int count)
+{
+    return (count + BarnesHut::WORK_GROUP_SIZE - 1) / BarnesHut::WORK_GROUP_SIZE;
+}
+
+BarnesHut::BarnesHut(int particleCount)
+{
+    m_particleCount = particleCount;
+
+    m_sortCount = BitonicSort::PaddedCount(particleCount);
+
+    m_boundsMat = CreateComputeMaterial("../Assets/barnesHutBounds.glsl");
+    m_mortonMat = CreateComputeMaterial("../Assets/barnesHutMorton.glsl");
+    m_sort = new BitonicSort();
+    m_radixTreeMat = CreateComputeMaterial("../Assets/radixTree.glsl");
+    m_summarizeMat = CreateComputeMaterial("../Assets/barnesHutSummarize.glsl");
+    m_gravityMat = CreateComputeMaterial("../Assets/barnesHutGravity.glsl");
+
+    // n leaves and n - 1 internal nodes.
+    m_boundsBuffer = CreateStorageBuffer(6 * sizeof(GLuint));
+    m_keyBuffer = CreateStorageBuffer(m_sortCount * sizeof(GLuint));
+    m_valueBuffer = CreateStorageBuffer(m_sortCount * sizeof(GLuint));
+    m_childBuffer = CreateStorageBuffer((particleCount - 1) * sizeof(glm::ivec2));
+    m_parentBuffer = CreateStorageBuffer((2 * particleCount - 1) * sizeof(GLint));
+    m_nodeBuffer = CreateStorageBuffer((2 * particleCount - 1) * sizeof(BarnesHutNode));
+    m_flagBuffer = CreateStorageBuffer((particleCount - 1) * sizeof(GLuint));
+}
+
+BarnesHut::~BarnesHut()
+{
+    GLuint buffers[] = { m_boundsBuffer, m_keyBuffer, m_valueBuffer, m_childBuffer, m_parentBuffer, m_nodeBuffer, m_flagBuffer };
+    glDeleteBuffers(7, buffers);
+
+    delete m_boundsMat;
+    delete m_mortonMat;
+    delete m_sort;
+    delete m_radixTreeMat;
+    delete m_summarizeMat;
+    delete m_gravityMat;
+}
+
+void BarnesHut::Update(GLuint particleBuffer, float dt, float particleMass, float softening, float openingAngle, glm::vec3 acceleration)
+{
+    BuildTree(particleBuffer, particleMass);
+
+    // Walk the tree for every particle.
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, particleBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_valueBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_childBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_nodeBuffer);
+
+    m_gravityMat->SetInt((char*)"particleCount", m_particleCount);
+    m_gravityMat->SetVec3((char*)"acceleration", acceleration);
+    m_gravityMat->SetFloat((char*)"dt", dt);
+    m_gravityMat->SetFloat((char*)"softening", softening);
+    m_gravityMat->SetFloat((char*)"openingAngle", openingAngle);
+    m_gravityMat->Bind();
+    glDispatchCompute(WorkGroups(m_particleCount), 1, 1);
+    m_gravityMat->Unbind();
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void BarnesHut::BuildTree(GLuint particleBuffer, float particleMass)
+{
+    // Start the bounds inside out, so the first particle replaces them.
+    GLuint emptyBounds[6] = { 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0, 0, 0 };
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_boundsBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(emptyBounds), emptyBounds);
+
+    // Nobody has reached any internal node yet.
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_flagBuffer);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // 1. Bounding box
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, particleBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_boundsBuffer);
+    m_boundsMat->SetInt((char*)"particleCount", m_particleCount);
+    m_boundsMat->Bind();
+    glDispatchCompute(WorkGroups(m_particleCount), 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // 2. Morton codes, for the padding too.
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_keyBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_valueBuffer);
+    m_mortonMat->SetInt((char*)"particleCount", m_particleCount);
+    m_mortonMat->Bind();
+    glDispatchCompute(WorkGroups(m_sortCount), 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // 3. Sort
+    m_sort->Sort(m_keyBuffer, m_valueBuffer, m_sortCount);
+
+    // 4. Radix tree
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_keyBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_childBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_parentBuffer);
+    m_radixTreeMat->SetInt((char*)"leafCount", m_particleCount);
+    m_radixTreeMat->Bind();
+    glDispatchCompute(WorkGroups(m_particleCount - 1), 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // 5. Center of mass
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, particleBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_valueBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_childBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_parentBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, m_nodeBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, m_flagBuffer);
+    m_summarizeMat->SetInt((char*)"particleCount", m_particleCount);
+    m_summarizeMat->SetFloat((char*)"particleMass", particleMass);
+    m_summarizeMat->Bind();
+    glDispatchCompute(WorkGroups(m_particleCount), 1, 1);
+    m_summarizeMat->Unbind();
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    for (int i = 0; i < 6; i++)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, 0);
+    }
+}
+
+// Copies the start of a GPU buffer into a vector.
+template <typename T>
+static std::vector<T> ReadBuffer(GLuint buffer, int count)
+{
+    std::vector<T> data(count);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(T), data.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return data;
+}
+
+bool BarnesHut::ValidateTree(GLuint particleBuffer, float particleMass)
+{
+    BuildTree(particleBuffer, particleMass);
+
+    int n = m_particleCount;
+    std::vector<Particle> particles = ReadBuffer<Particle>(particleBuffer, n);
+    std::vector<GLuint> gpuBounds = ReadBuffer<GLuint>(m_boundsBuffer, 6);
+    std::vector<GLuint> gpuKeys = ReadBuffer<GLuint>(m_keyBuffer, n);
+    std::vector<GLuint> gpuValues = ReadBuffer<GLuint>(m_valueBuffer, n);
+    std::vector<glm::ivec2> gpuChildren = ReadBuffer<glm::ivec2>(m_childBuffer, n - 1);
+    std::vector<int> gpuParents = ReadBuffer<int>(m_parentBuffer, 2 * n - 1);
+    std::vector<BarnesHutNode> gpuNodes = ReadBuffer<BarnesHutNode>(m_nodeBuffer, 2 * n - 1);
+
+    bool valid = true;
+
+    // 1. The bounding box is only made of min and max, so it should match exactly.
+    glm::vec3 boundsMin = glm::vec3(particles[0].m_position);
+    glm::vec3 boundsMax = boundsMin;
+    for (int i = 0; i < n; i++)
+    {
+        boundsMin = glm::min(boundsMin, glm::vec3(particles[i].m_position));
+        boundsMax = glm::max(boundsMax, glm::vec3(particles[i].m_position));
+    }
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (gpuBounds[axis] != FloatToSortable(boundsMin[axis]) || gpuBounds[axis + 3] != FloatToSortable(boundsMax[axis]))
+        {
+            std::cout << "Barnes-Hut: bounding box doesn't match." << std::endl;
+            valid = false;
+            break;
+        }
+    }
+    boundsMin = glm::vec3(SortableToFloat(gpuBounds[0]), SortableToFloat(gpuBounds[1]), SortableToFloat(gpuBounds[2]));
+    boundsMax = glm::vec3(SortableToFloat(gpuBounds[3]), SortableToFloat(gpuBounds[4]), SortableToFloat(gpuBounds[5]));
+
+    // 2. The keys have to be sorted, every particle has to show up once, and each key has to match its particle.
+    // GPU division can round differently, so a particle right on the edge of a cell is allowed to land in the next one.
+    std::vector<bool> seen(n, false);
+    int unsorted = 0;
+    int wrongKeys = 0;
+    int missing = 0;
+    for (int k = 0; k < n; k++)
+    {
+        GLuint particle = gpuValues[k];
+        if (particle >= (GLuint)n || seen[particle])
+        {
+            missing++;
+            continue;
+        }
+        seen[particle] = true;
+
+        if (k > 0 && (gpuKeys[k - 1] > gpuKeys[k] || (gpuKeys[k - 1] == gpuKeys[k] && gpuValues[k - 1] > gpuValues[k])))
+        {
+            unsorted++;
+        }
+
+        glm::ivec3 cell = MortonCell(glm::vec3(particles[particle].m_position), boundsMin, boundsMax);
+        GLuint key = ExpandBits(cell.x) * 4 + ExpandBits(cell.y) * 2 + ExpandBits(cell.z);
+        if (key != gpuKeys[k])
+        {
+            // Pull the cell back out of the key to see how far off it is.
+            glm::ivec3 gpuCell = glm::ivec3(0);
+            for (int bit = 0; bit < 10; bit++)
+            {
+                gpuCell.x |= ((gpuKeys[k] >> (3 * bit + 2)) & 1) << bit;
+                gpuCell.y |= ((gpuKeys[k] >> (3 * bit + 1)) & 1) << bit;
+                gpuCell.z |= ((gpuKeys[k] >> (3 * bit)) & 1) << bit;
+            }
+            glm::ivec3 difference = glm::abs(gpuCell - cell);
+            if (difference.x > 1 || difference.y > 1 || difference.z > 1)
+            {
+                wrongKeys++;
+            }
+        }
+    }
+    if (unsorted > 0 || wrongKeys > 0 || missing > 0)
+    {
+        std::cout << "Barnes-Hut: " << unsorted << " keys out of order, " << wrongKeys << " wrong keys, "
+            << missing << " particles missing or repeated." << std::endl;
+        valid = false;
+    }
+
+    // 3. The hierarchy only depends on the sorted keys, so build it on the CPU from the same keys and compare.
+    std::vector<glm::ivec2> children;
+    std::vector<int> parents;
+    BuildRadixTree(gpuKeys, children, parents);
+    int wrongLinks = 0;
+    for (int i = 0; i < n - 1; i++)
+    {
+        if (children[i] != gpuChildren[i])
+        {
+            wrongLinks++;
+        }
+    }
+    for (int i = 0; i < 2 * n - 1; i++)
+    {
+        if (parents[i] != gpuParents[i])
+        {
+            wrongLinks++;
+        }
+    }
+    if (wrongLinks > 0)
+    {
+        std::cout << "Barnes-Hut: " << wrongLinks << " parent or child links don't match." << std::endl;
+        valid = false;
+    }
+
+    // 4. Fill in the center of mass of every node, children first.
+    // Summing in a different order gives slightly different results, so these are compared with a tolerance.
+    std::vector<BarnesHutNode> nodes(2 * n - 1);
+    for (int k = 0; k < n; k++)
+    {
+        glm::vec3 position = glm::vec3(particles[gpuValues[k] % n].m_position);
+        nodes[n - 1 + k].m_centerOfMass = glm::vec4(position, particleMass);
+    }
+
+    std::vector<int> stack;
+    std::vector<bool> visited(n - 1, false);
+    stack.push_back(0);
+    while (!stack.empty())
+    {
+        int node = stack.back();
+        glm::ivec2 child = children[node];
+        if (!visited[node])
+        {
+            // Come back to this node after both children are done.
+            visited[node] = true;
+            if (child.x < n - 1)
+            {
+                stack.push_back(child.x);
+            }
+            if (child.y < n - 1)
+            {
+                stack.push_back(child.y);
+            }
+            continue;
+        }
+        stack.pop_back();
+
+        glm::vec4 left = nodes[child.x].m_centerOfMass;
+        glm::vec4 right = nodes[child.y].m_centerOfMass;
+        float mass = left.w + right.w;
+        nodes[node].m_centerOfMass = glm::vec4((glm::vec3(left) * left.w + glm::vec3(right) * right.w) / mass, mass);
+    }
+
+    float tolerance = 1e-4f * glm::length(boundsMax - boundsMin);
+    int wrongNodes = 0;
+    for (int i = 0; i < 2 * n - 1; i++)
+    {
+        glm::vec4 expected = nodes[i].m_centerOfMass;
+        glm::vec4 actual = gpuNodes[i].m_centerOfMass;
+        if (glm::length(glm::vec3(expected) - glm::vec3(actual)) > tolerance || glm::abs(expected.w - actual.w) > 1e-4f * expected.w)
+        {
+            wrongNodes++;
+        }
+    }
+    if (wrongNodes > 0)
+    {
+        std::cout << "Barnes-Hut: " << wrongNodes << " nodes have the wrong center of mass." << std::endl;
+        valid = false;
+    }
+
+    if (valid)
+    {
+        std::cout << "Barnes-Hut: tree of " << n << " particles matches the CPU reference." << std::endl;
+    }
+    return valid;
+}
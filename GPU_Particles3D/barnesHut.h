@@ -0,0 +1,76 @@
+/*
+Title: GPU Simulated Particle System
+File Name: barnesHut.h
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <vector>
+#include "GL/glew.h"
+#include "GLFW/glfw3.h"
+#include "glm/gtc/matrix_transform.hpp"
+#include "material.h"
+#include "bitonicSort.h"
+
+// Approximates n-body gravity in O(n log n) by grouping far away particles together.
+// Every frame, the tree is rebuilt on the GPU:
+// 1. Find the bounding box of all particles.
+// 2. Give every particle a morton code, which orders particles along a space filling curve.
+// 3. Sort the particles by morton code.
+// 4. Build a radix tree over the sorted codes. Every 3 levels of it are one level of an octree.
+// 5. Fill in the center of mass of every node, from the leaves up.
+// Then each particle walks the tree, and only opens nodes that are too close to be treated as a single mass.
+class BarnesHut
+{
+public:
+    // Must match WORK_GROUP_SIZE in the barnesHut shaders.
+    static const int WORK_GROUP_SIZE = 256;
+
+    BarnesHut(int particleCount);
+    ~BarnesHut();
+
+    // Rebuilds the tree from the particle buffer, and adds gravity to every particle's velocity.
+    // Positions aren't changed, that is left to the particle system.
+    void Update(GLuint particleBuffer, float dt, float particleMass, float softening, float openingAngle, glm::vec3 acceleration);
+
+    // Builds the same tree on the CPU from the current particle buffer, and compares it with the one built by the last Update.
+    // This reads everything back from the GPU, so it is very slow. Prints what it finds and returns true if the trees match.
+    bool ValidateTree(GLuint particleBuffer, float particleMass);
+
+private:
+    void BuildTree(GLuint particleBuffer, float particleMass);
+
+    int m_particleCount;
+
+    // Number of keys being sorted, padded up to a power of two.
+    int m_sortCount;
+
+    Material* m_boundsMat;
+    Material* m_mortonMat;
+    BitonicSort* m_sort;
+    Material* m_radixTreeMat;
+    Material* m_summarizeMat;
+    Material* m_gravityMat;
+
+    GLuint m_boundsBuffer;
+    GLuint m_keyBuffer;
+    GLuint m_valueBuffer;
+    GLuint m_childBuffer;
+    GLuint m_parentBuffer;
+    GLuint m_nodeBuffer;
+    GLuint m_flagBuffer;
+};
@@ -0,0 +1,741 @@
+/*
+Title: GPU Simulated Particle System
+File Name: benchmark.cpp
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "benchmark.h"
+#include "particleSystem.h"
+#include "gpuTimer.h"
+#include "collisionMesh.h"
+#include "particleBatch.h"
+#include "particleBudget.h"
+#include "gpuEmitters.h"
+#include "parallelPrimitives.h"
+#include "bitonicSort.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
+void RunBenchmarks(Texture* texture)
+{
+    RunNBodyBenchmark(texture);
+    RunBarnesHutBenchmark(texture);
+    RunCollisionBenchmark(texture);
+    RunSleepBenchmark(texture);
+    RunBatchBenchmark(texture);
+    RunBudgetBenchmark(texture);
+    RunEmitterBenchmark(texture);
+    RunRenderBenchmark(texture);
+    RunPrimitivesBenchmark();
+}
+
+void RunNBodyBenchmark(Texture* texture)
+{
+    // Commonly used count of floating point operations for one interaction:
+    // 3 subtract, 3 multiply-add for the distance, 1 add for softening, 1 inverse square root, 2 multiply for the cube,
+    // 1 multiply for mass and 3 multiply-add to accumulate (multiply-adds count as 2).
+    const double FLOPS_PER_INTERACTION = 20;
+    const int WARMUP_STEPS = 3;
+    const int TIMED_STEPS = 10;
+
+    std::cout << "N-body gravity (tiled all-pairs):" << std::endl;
+
+    // Hold a reference so the texture survives each test system being deleted.
+    texture->IncRefCount();
+
+    int particleCounts[] = { 4096, 16384, 65536 };
+    for (int particleCount : particleCounts)
+    {
+        ParticleSystem* system = new ParticleSystem(texture, particleCount);
+        system->m_gravityMode = GravityMode::AllPairs;
+        system->ScatterParticles(5, 1);
+
+        // The first few steps include shader compilation and other setup costs.
+        for (int i = 0; i < WARMUP_STEPS; i++)
+        {
+            system->Update(.016f);
+        }
+
+        GPUTimer timer;
+        timer.Begin();
+        for (int i = 0; i < TIMED_STEPS; i++)
+        {
+            system->Update(.016f);
+        }
+        timer.End();
+
+        double seconds = timer.GetMilliseconds() / 1000.0 / TIMED_STEPS;
+        double interactions = (double)particleCount * particleCount;
+
+        std::cout << "  " << particleCount << " particles: "
+            << seconds * 1000 << " ms/step, "
+            << interactions / seconds / 1e9 << " billion interactions/s, "
+            << interactions * FLOPS_PER_INTERACTION / seconds / 1e9 << " GFLOP/s" << std::endl;
+
+        delete system;
+    }
+
+    texture->DecRefCount();
+}
+
+void RunBarnesHutBenchmark(Texture* texture)
+{
+    const int WARMUP_STEPS = 3;
+    const int TIMED_STEPS = 10;
+
+    std::cout << "N-body gravity (Barnes-Hut):" << std::endl;
+    texture->IncRefCount();
+
+    int particleCounts[] = { 65536, 262144, 1048576 };
+    for (int particleCount : particleCounts)
+    {
+        ParticleSystem* system = new ParticleSystem(texture, particleCount);
+        system->m_gravityMode = GravityMode::BarnesHut;
+        system->ScatterParticles(5, 1);
+
+        // The tree is checked on the smallest system only, building it on the CPU takes a while.
+        if (particleCount == particleCounts[0])
+        {
+            system->ValidateGravityTree();
+        }
+
+        for (int i = 0; i < WARMUP_STEPS; i++)
+        {
+            system->Update(.016f);
+        }
+
+        GPUTimer timer;
+        timer.Begin();
+        for (int i = 0; i < TIMED_STEPS; i++)
+        {
+            system->Update(.016f);
+        }
+        timer.End();
+
+        double seconds = timer.GetMilliseconds() / 1000.0 / TIMED_STEPS;
+        std::cout << "  " << particleCount << " particles: "
+            << seconds * 1000 << " ms/step, "
+            << particleCount / seconds / 1e6 << " million particles/s" << std::endl;
+
+        delete system;
+    }
+
+    texture->DecRefCount();
+}
+
+// A bumpy square of ground, size cells across, with 2 triangles per cell.
+static void MakeGround(int size, float height, float bumpHeight, std::vector<glm::vec3>& vertices, std::vector<unsigned int>& indices)
+{
+    vertices.clear();
+    indices.clear();
+    for (int z = 0; z <= size; z++)
+    {
+        for (int x = 0; x <= size; x++)
+        {
+            float px = -10 + 20.f * x / size;
+            float pz = -10 + 20.f * z / size;
+            vertices.push_back(glm::vec3(px, height + bumpHeight * sinf(px) * cosf(pz), pz));
+        }
+    }
+    for (int z = 0; z < size; z++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            unsigned int corner = z * (size + 1) + x;
+            unsigned int above = corner + size + 1;
+            indices.insert(indices.end(), { corner, above, corner + 1, corner + 1, above, above + 1 });
+        }
+    }
+}
+
+void RunCollisionBenchmark(Texture* texture)
+{
+    const int WARMUP_STEPS = 3;
+    const int TIMED_STEPS = 10;
+
+    std::cout << "Collision mesh:" << std::endl;
+    texture->IncRefCount();
+
+    std::vector<glm::vec3> vertices;
+    std::vector<unsigned int> indices;
+    MakeGround(100, -1, .5f, vertices, indices);
+    CollisionMesh* mesh = new CollisionMesh(vertices, indices);
+    mesh->ValidateTree();
+
+    // Animated meshes only pay for the refit every frame.
+    MakeGround(100, -.9f, .5f, vertices, indices);
+    mesh->UpdateVertices(vertices);
+    GPUTimer refitTimer;
+    refitTimer.Begin();
+    for (int i = 0; i < TIMED_STEPS; i++)
+    {
+        mesh->UpdateVertices(vertices);
+    }
+    refitTimer.End();
+    std::cout << "  refit " << mesh->GetTriangleCount() << " triangles: "
+        << refitTimer.GetMilliseconds() / TIMED_STEPS << " ms (including the upload)" << std::endl;
+
+    int particleCounts[] = { 65536, 262144, 1048576 };
+    for (int particleCount : particleCounts)
+    {
+        ParticleSystem* system = new ParticleSystem(texture, particleCount);
+        system->m_acceleration = glm::vec3(0, -10, 0);
+        system->m_lifeTime = 2;
+
+        double milliseconds[2];
+        for (int withMesh = 0; withMesh < 2; withMesh++)
+        {
+            system->SetCollisionMesh(withMesh == 1 ? mesh : nullptr);
+
+            // Let the particles spread out and reach the ground before timing.
+            for (int i = 0; i < WARMUP_STEPS * 20; i++)
+            {
+                system->Update(.016f);
+            }
+
+            GPUTimer timer;
+            timer.Begin();
+            for (int i = 0; i < TIMED_STEPS; i++)
+            {
+                system->Update(.016f);
+            }
+            timer.End();
+            milliseconds[withMesh] = timer.GetMilliseconds() / TIMED_STEPS;
+        }
+
+        std::cout << "  " << particleCount << " particles: "
+            << milliseconds[0] << " ms/step without the mesh, "
+            << milliseconds[1] << " ms/step with it" << std::endl;
+
+        delete system;
+    }
+
+    delete mesh;
+    texture->DecRefCount();
+}
+
+void RunSleepBenchmark(Texture* texture)
+{
+    const int SETTLE_STEPS = 200;
+    const int TIMED_STEPS = 10;
+
+    std::cout << "Sleeping particles:" << std::endl;
+    texture->IncRefCount();
+
+    std::vector<glm::vec3> vertices;
+    std::vector<unsigned int> indices;
+    // Flat, because collisions have no friction, and particles would slide around on the bumps forever.
+    MakeGround(100, -1, 0, vertices, indices);
+    CollisionMesh* mesh = new CollisionMesh(vertices, indices);
+
+    int particleCounts[] = { 65536, 262144, 1048576 };
+    for (int particleCount : particleCounts)
+    {
+        double milliseconds[2];
+        for (int sleep = 0; sleep < 2; sleep++)
+        {
+            // A pile of debris: scattered above the ground, falling, and never respawning.
+            ParticleSystem* system = new ParticleSystem(texture, particleCount);
+            ParticleModules modules;
+            modules.m_spawn = false;
+            modules.m_sleep = sleep == 1;
+            system->SetModules(modules);
+            system->m_acceleration = glm::vec3(0, -10, 0);
+            system->m_lifeTime = 1000;
+            system->SetCollisionMesh(mesh);
+            system->m_position = glm::vec3(0, 1, 0);
+            system->ScatterParticles(8, 0);
+
+            for (int i = 0; i < SETTLE_STEPS; i++)
+            {
+                system->Update(.016f);
+            }
+
+            GPUTimer timer;
+            timer.Begin();
+            for (int i = 0; i < TIMED_STEPS; i++)
+            {
+                system->Update(.016f);
+            }
+            timer.End();
+            milliseconds[sleep] = timer.GetMilliseconds() / TIMED_STEPS;
+
+            delete system;
+        }
+
+        std::cout << "  " << particleCount << " resting particles: "
+            << milliseconds[0] << " ms/step awake, "
+            << milliseconds[1] << " ms/step with the sleep module" << std::endl;
+    }
+
+    delete mesh;
+    texture->DecRefCount();
+}
+
+void RunBatchBenchmark(Texture* texture)
+{
+    const int WARMUP_STEPS = 3;
+    const int TIMED_STEPS = 20;
+    const int PARTICLES_PER_SYSTEM = 256;
+
+    std::cout << "Batched systems (" << PARTICLES_PER_SYSTEM << " particles each):" << std::endl;
+    texture->IncRefCount();
+
+    int systemCounts[] = { 50, 200, 1000 };
+    for (int systemCount : systemCounts)
+    {
+        // Small sparks spread out over a field, like a scene full of torches.
+        std::vector<ParticleSystem*> systems;
+        for (int i = 0; i < systemCount; i++)
+        {
+            ParticleSystem* system = new ParticleSystem(texture, PARTICLES_PER_SYSTEM);
+            system->m_position = glm::vec3(i % 32, 0, i / 32);
+            system->m_lifeTime = .5f + (i % 5) * .1f;
+            systems.push_back(system);
+        }
+
+        double cpuMilliseconds[2];
+        double gpuMilliseconds[2];
+        ParticleBatch* batch = nullptr;
+        for (int batched = 0; batched < 2; batched++)
+        {
+            if (batched == 1)
+            {
+                batch = new ParticleBatch(systemCount * PARTICLES_PER_SYSTEM);
+                for (ParticleSystem* system : systems)
+                {
+                    batch->Add(system);
+                }
+            }
+
+            for (int i = 0; i < WARMUP_STEPS; i++)
+            {
+                if (batch != nullptr)
+                {
+                    batch->Update(.016f);
+                }
+                else
+                {
+                    for (ParticleSystem* system : systems)
+                    {
+                        system->Update(.016f);
+                    }
+                }
+            }
+            glFinish();
+
+            // The CPU time is only how long it takes to submit the work, the GPU timer covers running it.
+            GPUTimer timer;
+            timer.Begin();
+            std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < TIMED_STEPS; i++)
+            {
+                if (batch != nullptr)
+                {
+                    batch->Update(.016f);
+                }
+                else
+                {
+                    for (ParticleSystem* system : systems)
+                    {
+                        system->Update(.016f);
+                    }
+                }
+            }
+            std::chrono::duration<double, std::milli> submit = std::chrono::high_resolution_clock::now() - start;
+            timer.End();
+            cpuMilliseconds[batched] = submit.count() / TIMED_STEPS;
+            gpuMilliseconds[batched] = timer.GetMilliseconds() / TIMED_STEPS;
+        }
+
+        std::cout << "  " << systemCount << " systems: "
+            << cpuMilliseconds[0] << " ms CPU, " << gpuMilliseconds[0] << " ms GPU one by one, "
+            << cpuMilliseconds[1] << " ms CPU, " << gpuMilliseconds[1] << " ms GPU batched" << std::endl;
+
+        delete batch;
+        for (ParticleSystem* system : systems)
+        {
+            delete system;
+        }
+    }
+
+    texture->DecRefCount();
+}
+
+void RunBudgetBenchmark(Texture* texture)
+{
+    const int PARTICLES_PER_SYSTEM = 4096;
+    const int SETTLE_STEPS = 150;
+    const int TIMED_STEPS = 20;
+
+    std::cout << "Particle budget (" << PARTICLES_PER_SYSTEM << " particles per system, capped at five eighths of them):" << std::endl;
+    texture->IncRefCount();
+
+    // Looking down on the ring from above, so every system is on screen and the same distance away.
+    glm::vec3 cameraPosition = glm::vec3(0, 60, 0);
+    glm::mat4 viewProjection = glm::perspective(.8f, 1.f, .1f, 200.f)
+        * glm::lookAt(cameraPosition, glm::vec3(0), glm::vec3(0, 0, -1));
+
+    int systemCounts[] = { 64, 192 };
+    for (int systemCount : systemCounts)
+    {
+        // The memory cap fits exactly this many pools, the cap on live particles five eighths of them.
+        // Half the systems have twice the priority of the other half, so they should all be filled,
+        // and the other half should share the eighth that is left.
+        int particleCap = systemCount * PARTICLES_PER_SYSTEM / 8 * 5;
+        ParticleBudget* budget = new ParticleBudget(particleCap, systemCount * PARTICLES_PER_SYSTEM * sizeof(Particle));
+        std::vector<ParticleSystem*> systems;
+        for (int i = 0; i < systemCount; i++)
+        {
+            ParticleSystem* system = new ParticleSystem(texture, PARTICLES_PER_SYSTEM);
+            float angle = i * 6.2832f / systemCount;
+            system->m_position = glm::vec3(cos(angle), 0, sin(angle)) * 20.f;
+            system->m_lifeTime = 1;
+            budget->Add(system, i % 2 == 0 ? 2.f : 1.f);
+            systems.push_back(system);
+        }
+
+        // One more system doesn't fit in memory.
+        ParticleSystem* extra = new ParticleSystem(texture, PARTICLES_PER_SYSTEM);
+        bool extraAdded = budget->Add(extra);
+
+        // Every particle starts out alive. Give the ones over their quota a lifetime to die out,
+        // and the quotas a few frames to come back to the CPU.
+        for (int i = 0; i < SETTLE_STEPS; i++)
+        {
+            for (ParticleSystem* system : systems)
+            {
+                system->Update(.016f);
+            }
+            budget->Update(viewProjection, cameraPosition);
+        }
+        glFinish();
+        budget->Update(viewProjection, cameraPosition);
+
+        // The quotas, and the particles actually alive, which are read straight out of each system's bounds.
+        int quotaTotal = 0;
+        int aliveTotal = 0;
+        int lowPriorityTotal = 0;
+        int lowestHighPriorityQuota = PARTICLES_PER_SYSTEM;
+        for (int i = 0; i < systemCount; i++)
+        {
+            int quota = budget->GetQuota(systems[i]);
+            quotaTotal += quota;
+            if (i % 2 == 0)
+            {
+                lowestHighPriorityQuota = std::min(lowestHighPriorityQuota, quota);
+            }
+            else
+            {
+                lowPriorityTotal += quota;
+            }
+
+            ParticleBounds bounds;
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, systems[i]->GetBoundsBuffer());
+            glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(ParticleBounds), &bounds);
+            aliveTotal += bounds.m_count;
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        if (quotaTotal > particleCap || aliveTotal > particleCap)
+        {
+            std::cout << "  " << systemCount << " systems: " << quotaTotal << " particles in quotas and "
+                << aliveTotal << " alive, over the cap of " << particleCap << "." << std::endl;
+        }
+        if (extraAdded)
+        {
+            std::cout << "  " << systemCount << " systems: a system over the memory cap was added." << std::endl;
+        }
+        if (lowestHighPriorityQuota < PARTICLES_PER_SYSTEM)
+        {
+            std::cout << "  " << systemCount << " systems: a high priority system only got " << lowestHighPriorityQuota
+                << " particles, while low priority ones got " << lowPriorityTotal << " between them." << std::endl;
+        }
+
+        // Working out the quotas is one small dispatch, plus a buffer copy per system.
+        GPUTimer timer;
+        timer.Begin();
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < TIMED_STEPS; i++)
+        {
+            budget->Update(viewProjection, cameraPosition);
+        }
+        std::chrono::duration<double, std::milli> submit = std::chrono::high_resolution_clock::now() - start;
+        timer.End();
+
+        std::cout << "  " << systemCount << " systems: " << quotaTotal << " particles in quotas, " << aliveTotal << " alive, for a cap of " << particleCap
+            << ", " << lowPriorityTotal << " of them to low priority systems. "
+            << submit.count() / TIMED_STEPS << " ms CPU, " << timer.GetMilliseconds() / TIMED_STEPS << " ms GPU per budget update" << std::endl;
+
+        delete budget;
+        delete extra;
+        for (ParticleSystem* system : systems)
+        {
+            delete system;
+        }
+    }
+
+    texture->DecRefCount();
+}
+
+void RunEmitterBenchmark(Texture* texture)
+{
+    const int SETTLE_STEPS = 60;
+    const int TIMED_STEPS = 60;
+    const float RATE = 20;
+    const float LIFETIME = .5f;
+
+    std::cout << "GPU emitters (" << RATE << " particles per second each, two effects):" << std::endl;
+    texture->IncRefCount();
+
+    int emitterCounts[] = { 1000, 4000, 16000 };
+    for (int emitterCount : emitterCounts)
+    {
+        // Two effects with room for twice the particles their emitters should keep alive. Emitters alternate between them.
+        int expectedAlive = (int)(emitterCount / 2 * RATE * LIFETIME);
+        GPUEmitters* emitters = new GPUEmitters(emitterCount);
+        ParticleSystem* effects[2];
+        for (ParticleSystem*& system : effects)
+        {
+            system = new ParticleSystem(texture, expectedAlive * 2);
+            system->m_lifeTime = LIFETIME;
+            system->EnableBounds();
+            emitters->AddEffect(system);
+        }
+
+        // Projectiles flying out of a ring, moved by gameplay code on the CPU, the way a game would keep them.
+        std::vector<GPUEmitter> projectiles(emitterCount);
+        for (int i = 0; i < emitterCount; i++)
+        {
+            float angle = i * 6.2832f / emitterCount;
+            projectiles[i].m_position = glm::vec3(cos(angle), 0, sin(angle)) * 10.f;
+            projectiles[i].m_velocity = glm::vec3(-sin(angle), (i % 7) * .2f, cos(angle)) * 5.f;
+            projectiles[i].m_rate = RATE;
+            projectiles[i].m_effect = i % 2;
+        }
+
+        // The CPU cost is handing the emitters over: mapping the buffer, one memcpy, and submitting the passes.
+        double handOffMilliseconds = 0;
+        for (int step = 0; step < SETTLE_STEPS + TIMED_STEPS; step++)
+        {
+            for (GPUEmitter& projectile : projectiles)
+            {
+                projectile.m_position += projectile.m_velocity * .016f;
+            }
+
+            std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+            memcpy(emitters->Map(), projectiles.data(), emitterCount * sizeof(GPUEmitter));
+            emitters->Update(.016f, emitterCount);
+            std::chrono::duration<double, std::milli> handOff = std::chrono::high_resolution_clock::now() - start;
+            if (step >= SETTLE_STEPS)
+            {
+                handOffMilliseconds += handOff.count();
+            }
+
+            for (ParticleSystem* system : effects)
+            {
+                system->Update(.016f);
+            }
+        }
+
+        // After a few lifetimes, each effect should have about rate * lifetime particles alive per emitter.
+        int alive[2];
+        for (int i = 0; i < 2; i++)
+        {
+            ParticleBounds bounds;
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, effects[i]->GetBoundsBuffer());
+            glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(ParticleBounds), &bounds);
+            alive[i] = bounds.m_count;
+            if (abs(alive[i] - expectedAlive) > expectedAlive / 10)
+            {
+                std::cout << "  " << emitterCount << " emitters: effect " << i << " has " << alive[i]
+                    << " particles alive, instead of about " << expectedAlive << "." << std::endl;
+            }
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        std::cout << "  " << emitterCount << " emitters: " << handOffMilliseconds / TIMED_STEPS << " ms CPU per frame, "
+            << alive[0] << " and " << alive[1] << " particles alive, expecting " << expectedAlive << " each" << std::endl;
+
+        delete emitters;
+        for (ParticleSystem* system : effects)
+        {
+            delete system;
+        }
+    }
+
+    texture->DecRefCount();
+}
+
+void RunRenderBenchmark(Texture* texture)
+{
+    const int WARMUP_DRAWS = 3;
+    const int TIMED_DRAWS = 20;
+
+    // Small quads, so the time goes into making them rather than filling pixels.
+    std::cout << "Drawing particles (4 pixel quads, about half of them in view):" << std::endl;
+    texture->IncRefCount();
+
+    // Close to the middle of the disc, so a lot of it is behind the camera or off to the sides.
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glm::vec2 viewportSize = glm::vec2(viewport[2], viewport[3]);
+    glm::mat4 viewProjection = glm::perspective(.8f, viewportSize.x / viewportSize.y, .1f, 100.f)
+        * glm::lookAt(glm::vec3(0, 1.5f, 2), glm::vec3(0, 0, -2), glm::vec3(0, 1, 0));
+
+    int particleCounts[] = { 65536, 262144, 1048576 };
+    for (int particleCount : particleCounts)
+    {
+        // A disc of particles, all alive, that is never updated, so every way of drawing draws exactly the same thing.
+        ParticleSystem* system = new ParticleSystem(texture, particleCount);
+        system->m_particleSize = glm::vec2(4, 4);
+        system->ScatterParticles(5, 1);
+        system->SetView(viewProjection, viewportSize);
+
+        // Geometry shader and vertex pulling, first drawing every particle, then only the ones the cull pass keeps.
+        double milliseconds[4];
+        for (int i = 0; i < 4; i++)
+        {
+            ParticleModules modules = system->GetModules();
+            modules.m_culling = i >= 2;
+            system->SetModules(modules);
+            system->SetRenderPath(i % 2 == 0 ? ParticleRenderPath::GeometryShader : ParticleRenderPath::VertexPulling);
+            system->GetMaterial()->SetMatrix((char*)"cameraView", viewProjection);
+            system->GetMaterial()->SetVec2((char*)"viewport", viewportSize);
+
+            for (int j = 0; j < WARMUP_DRAWS; j++)
+            {
+                system->Draw();
+            }
+
+            GPUTimer timer;
+            timer.Begin();
+            for (int j = 0; j < TIMED_DRAWS; j++)
+            {
+                system->Draw();
+            }
+            timer.End();
+            milliseconds[i] = timer.GetMilliseconds() / TIMED_DRAWS;
+        }
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        std::cout << "  " << particleCount << " particles: "
+            << milliseconds[0] << " ms geometry shader, "
+            << milliseconds[1] << " ms vertex pulling, culled: "
+            << milliseconds[2] << " ms geometry shader, "
+            << milliseconds[3] << " ms vertex pulling" << std::endl;
+
+        delete system;
+    }
+
+    texture->DecRefCount();
+}
+
+void RunPrimitivesBenchmark()
+{
+    const int TIMED_RUNS = 10;
+
+    std::cout << "Parallel primitives:" << std::endl;
+    ParallelPrimitives primitives;
+    BitonicSort bitonicSort;
+
+    // Checked before timing, on sizes that end in a partly filled block, where the padding and range checks matter:
+    // less than one block, and an odd count over several levels of block sums. Then a whole number of blocks.
+    // Only small counts, the CPU side takes a while.
+    int validationCounts[] = { 300, 100003, 65536 };
+    for (int count : validationCounts)
+    {
+        primitives.Validate(count);
+    }
+
+    int counts[] = { 65536, 1048576, 4194304 };
+    for (int count : counts)
+    {
+
+        std::vector<GLuint> numbers(count);
+        std::vector<GLuint> keys(count);
+        std::vector<float> floats(count);
+        for (int i = 0; i < count; i++)
+        {
+            numbers[i] = rand() % 2;
+            keys[i] = ((GLuint)rand() << 30) ^ ((GLuint)rand() << 15) ^ (GLuint)rand();
+            floats[i] = (float)rand() / RAND_MAX;
+        }
+
+        GLuint buffers[7];
+        glGenBuffers(7, buffers);
+        GLuint numberBuffer = buffers[0];
+        GLuint resultBuffer = buffers[1];
+        GLuint countBuffer = buffers[2];
+        GLuint unsortedBuffer = buffers[3];
+        GLuint keyBuffer = buffers[4];
+        GLuint valueBuffer = buffers[5];
+        GLuint floatBuffer = buffers[6];
+        const void* data[] = { numbers.data(), nullptr, nullptr, keys.data(), nullptr, nullptr, floats.data() };
+        for (int i = 0; i < 7; i++)
+        {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[i]);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, i == 2 ? sizeof(GLuint) : count * sizeof(GLuint), data[i], GL_DYNAMIC_COPY);
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        // Sorting starts from the same unsorted keys every run. The copy is part of the time, for both sorts.
+        auto resetKeys = [&]()
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, unsortedBuffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, keyBuffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, count * sizeof(GLuint));
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        };
+
+        // Runs something once to make its scratch buffers, then times it.
+        auto time = [&](std::function<void()> run)
+        {
+            run();
+            GPUTimer timer;
+            timer.Begin();
+            for (int i = 0; i < TIMED_RUNS; i++)
+            {
+                run();
+            }
+            timer.End();
+            return timer.GetMilliseconds() / TIMED_RUNS;
+        };
+
+        float scan = time([&]() { primitives.ExclusiveScan(numberBuffer, resultBuffer, count); });
+        float compact = time([&]() { primitives.Compact(keyBuffer, numberBuffer, resultBuffer, countBuffer, count); });
+        float radixSort = time([&]() { resetKeys(); primitives.Sort(keyBuffer, valueBuffer, count); });
+        // 24 bit keys, like morton codes of a 256 cell grid, skip two of the eight passes.
+        float radixSort24 = time([&]() { resetKeys(); primitives.Sort(keyBuffer, valueBuffer, count, 24); });
+        float bitonic = time([&]() { resetKeys(); bitonicSort.Sort(keyBuffer, valueBuffer, count); });
+        float reduce = time([&]() { primitives.Reduce(floatBuffer, resultBuffer, count, ReduceOperation::Sum); });
+
+        std::cout << "  " << count << " elements: "
+            << scan << " ms scan, "
+            << compact << " ms compact, "
+            << radixSort << " ms radix sort (" << radixSort24 << " ms for 24 bit keys), "
+            << bitonic << " ms bitonic sort, "
+            << reduce << " ms reduce" << std::endl;
+
+        glDeleteBuffers(7, buffers);
+    }
+}
@@ -0,0 +1,59 @@
+/*
+Title: GPU Simulated Particle System
+File Name: benchmark.h
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "texture.h"
+
+// Benchmarks print their results to the console.
+// Run the program with --benchmark to run all of them instead of the demo.
+void RunBenchmarks(Texture* texture);
+
+// Times the tiled all-pairs gravity simulation at a few different particle counts.
+void RunNBodyBenchmark(Texture* texture);
+
+// Checks the Barnes-Hut tree against the CPU reference, then times Barnes-Hut gravity up to a million particles.
+void RunBarnesHutBenchmark(Texture* texture);
+
+// Checks the collision mesh tree, then times refitting it and particles colliding with it up to a million particles,
+// against the same particles without the mesh.
+void RunCollisionBenchmark(Texture* texture);
+
+// Drops particles onto the collision mesh, and times them once they have come to rest, with and without the sleep module.
+void RunSleepBenchmark(Texture* texture);
+
+// Times a few hundred small systems updated one by one, against the same systems in a ParticleBatch,
+// both on the CPU (submitting the frame) and the GPU (running it).
+void RunBatchBenchmark(Texture* texture);
+
+// Puts a ring of systems with two different priorities on a ParticleBudget, checks the quotas and the particles
+// left alive stay under the cap, with the higher priority systems filled first, then times working out the quotas.
+void RunBudgetBenchmark(Texture* texture);
+
+// Flies thousands of emitters around like projectiles, writing them into GPUEmitters every frame. Times what that costs
+// the CPU, and checks the effects end up with as many particles alive as the emitters should keep going.
+void RunEmitterBenchmark(Texture* texture);
+
+// Times drawing particles with quads made in the geometry shader, against quads pulled in the vertex shader,
+// with and without culling particles outside the view first.
+void RunRenderBenchmark(Texture* texture);
+
+// Checks scan, compaction, radix sort and reduction against the CPU, then times each of them up to 4 million elements.
+// Radix sort is timed next to BitonicSort on the same keys.
+void RunPrimitivesBenchmark();
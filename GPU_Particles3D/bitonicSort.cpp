@@ -0,0 +1,81 @@
+/*
+Title: GPU Simulated Particle System
+File Name: bitonicSort.cpp
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "bitonicSort.h"
+
+BitonicSort::BitonicSort()
+{
+    ShaderProgram* program = new ShaderProgram();
+    program->AttachShader(new Shader("../Assets/bitonicSort.glsl", GL_COMPUTE_SHADER));
+    m_sortMat = new Material(program);
+}
+
+BitonicSort::~BitonicSort()
+{
+    delete m_sortMat;
+}
+
+int BitonicSort::PaddedCount(int count)
+{
+    int padded = BLOCK_SIZE;
+    while (padded < count)
+    {
+        padded *= 2;
+    }
+    return padded;
+}
+
+void BitonicSort::Sort(GLuint keyBuffer, GLuint valueBuffer, int count)
+{
+    int blocks = count / BLOCK_SIZE;
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keyBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, valueBuffer);
+
+    // Sort each block on its own in shared memory.
+    m_sortMat->SetInt((char*)"mode", 2);
+    m_sortMat->Bind();
+    glDispatchCompute(blocks, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // Merge the blocks together. Steps that compare elements from different blocks go through the
+    // whole buffer, and once the distance fits inside a block, the rest are done in shared memory.
+    for (int k = BLOCK_SIZE * 2; k <= count; k *= 2)
+    {
+        m_sortMat->SetInt((char*)"k", k);
+        for (int j = k / 2; j > WORK_GROUP_SIZE; j /= 2)
+        {
+            m_sortMat->SetInt((char*)"mode", 0);
+            m_sortMat->SetInt((char*)"j", j);
+            m_sortMat->Bind();
+            glDispatchCompute(blocks, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+
+        m_sortMat->SetInt((char*)"mode", 1);
+        m_sortMat->SetInt((char*)"j", WORK_GROUP_SIZE);
+        m_sortMat->Bind();
+        glDispatchCompute(blocks, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    m_sortMat->Unbind();
+}
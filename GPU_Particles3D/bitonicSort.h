@@ -0,0 +1,51 @@
+/*
+Title: GPU Simulated Particle System
+File Name: bitonicSort.h
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+#include "GL/glew.h"
+#include "GLFW/glfw3.h"
+#include "material.h"
+
+// Sorts uint keys on the GPU, moving a uint value along with each key (see bitonicSort.glsl).
+// Used to put things in morton code order before building a tree over them.
+class BitonicSort
+{
+public:
+    // Must match WORK_GROUP_SIZE in bitonicSort.glsl
+    static const int WORK_GROUP_SIZE = 256;
+
+    // Each work group sorts a block of this many keys in shared memory.
+    static const int BLOCK_SIZE = WORK_GROUP_SIZE * 2;
+
+    BitonicSort();
+    ~BitonicSort();
+
+    // The smallest count Sort can handle that fits count keys: a power of two, and at least one block.
+    // Fill the extra keys with 0xFFFFFFFF, so they sort to the end.
+    static int PaddedCount(int count);
+
+    // Sorts count keys and values in place. count has to come from PaddedCount.
+    // Leaves the buffers bound to storage buffer bindings 0 and 1.
+    void Sort(GLuint keyBuffer, GLuint valueBuffer, int count);
+
+private:
+    Material* m_sortMat;
+};
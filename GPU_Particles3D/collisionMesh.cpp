@@ -0,0 +1,322 @@
+/*
+Title: GPU Simulated Particle System
+File Name: collisionMesh.cpp
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "collisionMesh.h"
+#include "parallelPrimitives.h"
+#include <cfloat>
+#include <iostream>
+
+// Number of work groups needed to give every item its own invocation.
+static int WorkGroups(int count)
+{
+    return (count + CollisionMesh::WORK_GROUP_SIZE - 1) / CollisionMesh::WORK_GROUP_SIZE;
+}
+
+CollisionMesh::CollisionMesh(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices)
+{
+    m_indices = indices;
+    m_vertexCount = (int)vertices.size();
+    m_triangleCount = (int)indices.size() / 3;
+    m_sortCount = BitonicSort::PaddedCount(m_triangleCount);
+
+    m_mortonMat = CreateComputeMaterial("../Assets/bvhMorton.glsl");
+    m_sort = new BitonicSort();
+    m_radixTreeMat = CreateComputeMaterial("../Assets/radixTree.glsl");
+    m_linksMat = CreateComputeMaterial("../Assets/bvhLinks.glsl");
+    m_refitMat = CreateComputeMaterial("../Assets/bvhRefit.glsl");
+
+    // n leaves and n - 1 internal nodes. A mesh with one triangle is just a leaf, but the buffers can't be empty.
+    m_triangleBuffer = CreateStorageBuffer(m_triangleCount * 3 * sizeof(glm::vec4));
+    m_keyBuffer = CreateStorageBuffer(m_sortCount * sizeof(GLuint));
+    m_valueBuffer = CreateStorageBuffer(m_sortCount * sizeof(GLuint));
+    m_childBuffer = CreateStorageBuffer(glm::max(m_triangleCount - 1, 1) * sizeof(glm::ivec2));
+    m_parentBuffer = CreateStorageBuffer((2 * m_triangleCount - 1) * sizeof(GLint));
+    m_nodeBuffer = CreateStorageBuffer((2 * m_triangleCount - 1) * sizeof(CollisionNode));
+    m_flagBuffer = CreateStorageBuffer(glm::max(m_triangleCount - 1, 1) * sizeof(GLuint));
+
+    UploadTriangles(vertices);
+    BuildTree(vertices);
+    Refit();
+    m_changedBoundsMin = m_boundsMin;
+    m_changedBoundsMax = m_boundsMax;
+}
+
+CollisionMesh::~CollisionMesh()
+{
+    GLuint buffers[] = { m_triangleBuffer, m_keyBuffer, m_valueBuffer, m_childBuffer, m_parentBuffer, m_nodeBuffer, m_flagBuffer };
+    glDeleteBuffers(7, buffers);
+
+    delete m_mortonMat;
+    delete m_sort;
+    delete m_radixTreeMat;
+    delete m_linksMat;
+    delete m_refitMat;
+}
+
+void CollisionMesh::UpdateVertices(const std::vector<glm::vec3>& vertices)
+{
+    // The indices would point past the end of a shorter array, and the tree wouldn't know about new vertices.
+    if ((int)vertices.size() != m_vertexCount)
+    {
+        std::cout << "Collision mesh: got " << vertices.size() << " vertices to update, the mesh was made with " << m_vertexCount << "." << std::endl;
+        return;
+    }
+
+    glm::vec3 oldBoundsMin = m_boundsMin;
+    glm::vec3 oldBoundsMax = m_boundsMax;
+    UploadTriangles(vertices);
+    Refit();
+
+    m_changedBoundsMin = glm::min(oldBoundsMin, m_boundsMin);
+    m_changedBoundsMax = glm::max(oldBoundsMax, m_boundsMax);
+    m_updateCount++;
+}
+
+GLuint CollisionMesh::GetNodeBuffer()
+{
+    return m_nodeBuffer;
+}
+
+GLuint CollisionMesh::GetTriangleBuffer()
+{
+    return m_triangleBuffer;
+}
+
+int CollisionMesh::GetTriangleCount()
+{
+    return m_triangleCount;
+}
+
+int CollisionMesh::GetUpdateCount()
+{
+    return m_updateCount;
+}
+
+glm::vec3 CollisionMesh::GetChangedBoundsMin()
+{
+    return m_changedBoundsMin;
+}
+
+glm::vec3 CollisionMesh::GetChangedBoundsMax()
+{
+    return m_changedBoundsMax;
+}
+
+void CollisionMesh::UploadTriangles(const std::vector<glm::vec3>& vertices)
+{
+    // Give every triangle its own copy of its corners, so the shaders don't have to go through the indices.
+    std::vector<glm::vec4> corners(m_triangleCount * 3);
+    m_boundsMin = vertices[m_indices[0]];
+    m_boundsMax = m_boundsMin;
+    for (int i = 0; i < m_triangleCount * 3; i++)
+    {
+        corners[i] = glm::vec4(vertices[m_indices[i]], 1);
+        m_boundsMin = glm::min(m_boundsMin, vertices[m_indices[i]]);
+        m_boundsMax = glm::max(m_boundsMax, vertices[m_indices[i]]);
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_triangleBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, corners.size() * sizeof(glm::vec4), corners.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void CollisionMesh::BuildTree(const std::vector<glm::vec3>& vertices)
+{
+    // The vertices are already here, so the bounds of the triangle centers are found on the CPU
+    // instead of with a reduction like barnesHutBounds.glsl.
+    glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+    glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
+    for (int i = 0; i < m_triangleCount; i++)
+    {
+        glm::vec3 center = (vertices[m_indices[i * 3]] + vertices[m_indices[i * 3 + 1]] + vertices[m_indices[i * 3 + 2]]) / 3.f;
+        boundsMin = glm::min(boundsMin, center);
+        boundsMax = glm::max(boundsMax, center);
+    }
+
+    // The radix tree only sets the root's parent when there is more than one leaf.
+    GLint noParent = -1;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_parentBuffer);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32I, GL_RED_INTEGER, GL_INT, &noParent);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // 1. Morton codes, for the padding too.
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_triangleBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_keyBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_valueBuffer);
+    m_mortonMat->SetInt((char*)"triangleCount", m_triangleCount);
+    m_mortonMat->SetVec3((char*)"boundsMin", boundsMin);
+    m_mortonMat->SetVec3((char*)"boundsSize", boundsMax - boundsMin);
+    m_mortonMat->Bind();
+    glDispatchCompute(WorkGroups(m_sortCount), 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // 2. Sort
+    m_sort->Sort(m_keyBuffer, m_valueBuffer, m_sortCount);
+
+    // 3. Radix tree
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_keyBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_childBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_parentBuffer);
+    m_radixTreeMat->SetInt((char*)"leafCount", m_triangleCount);
+    m_radixTreeMat->Bind();
+    glDispatchCompute(WorkGroups(m_triangleCount - 1), 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // 4. Links
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_childBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_parentBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_valueBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_nodeBuffer);
+    m_linksMat->SetInt((char*)"leafCount", m_triangleCount);
+    m_linksMat->Bind();
+    glDispatchCompute(WorkGroups(2 * m_triangleCount - 1), 1, 1);
+    m_linksMat->Unbind();
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    for (int i = 0; i < 4; i++)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, 0);
+    }
+}
+
+void CollisionMesh::Refit()
+{
+    // Nobody has reached any internal node yet.
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_flagBuffer);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // 5. Bounding boxes
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_triangleBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_valueBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_childBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_parentBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, m_nodeBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, m_flagBuffer);
+    m_refitMat->SetInt((char*)"leafCount", m_triangleCount);
+    m_refitMat->Bind();
+    glDispatchCompute(WorkGroups(m_triangleCount), 1, 1);
+    m_refitMat->Unbind();
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    for (int i = 0; i < 6; i++)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, 0);
+    }
+}
+
+// Copies the start of a GPU buffer into a vector.
+template <typename T>
+static std::vector<T> ReadBuffer(GLuint buffer, int count)
+{
+    std::vector<T> data(count);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(T), data.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return data;
+}
+
+// True if box a holds box b.
+static bool Contains(const CollisionNode& a, glm::vec3 boundsMin, glm::vec3 boundsMax)
+{
+    return glm::all(glm::lessThanEqual(a.m_boundsMin, boundsMin)) && glm::all(glm::greaterThanEqual(a.m_boundsMax, boundsMax));
+}
+
+bool CollisionMesh::ValidateTree()
+{
+    int n = m_triangleCount;
+    std::vector<glm::vec4> corners = ReadBuffer<glm::vec4>(m_triangleBuffer, n * 3);
+    std::vector<CollisionNode> nodes = ReadBuffer<CollisionNode>(m_nodeBuffer, 2 * n - 1);
+
+    bool valid = true;
+
+    // 1. Walk the links the same way the particles do, but without skipping anything.
+    // Every triangle has to come up once, and every leaf's box has to hold its triangle.
+    std::vector<int> seen(n, 0);
+    int wrongLeaves = 0;
+    int steps = 0;
+    for (int node = 0; node >= 0 && steps < 2 * (2 * n - 1); steps++)
+    {
+        const CollisionNode& current = nodes[node];
+        if (current.m_first >= 0)
+        {
+            node = current.m_first;
+            continue;
+        }
+
+        int triangle = ~current.m_first;
+        if (triangle < 0 || triangle >= n)
+        {
+            wrongLeaves++;
+        }
+        else
+        {
+            seen[triangle]++;
+            glm::vec3 a = glm::vec3(corners[triangle * 3]);
+            glm::vec3 b = glm::vec3(corners[triangle * 3 + 1]);
+            glm::vec3 c = glm::vec3(corners[triangle * 3 + 2]);
+            if (!Contains(current, glm::min(a, glm::min(b, c)), glm::max(a, glm::max(b, c))))
+            {
+                wrongLeaves++;
+            }
+        }
+        node = current.m_miss;
+    }
+
+    int missing = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (seen[i] != 1)
+        {
+            missing++;
+        }
+    }
+    if (missing > 0 || wrongLeaves > 0)
+    {
+        std::cout << "Collision mesh: " << missing << " triangles missing or repeated, " << wrongLeaves << " bad leaves." << std::endl;
+        valid = false;
+    }
+
+    // 2. Internal nodes have to hold both children. The right child is wherever the left child's miss link goes.
+    int wrongBoxes = 0;
+    for (int i = 0; i < n - 1; i++)
+    {
+        int left = nodes[i].m_first;
+        int right = left >= 0 && left < 2 * n - 1 ? nodes[left].m_miss : -1;
+        if (left < 0 || right < 0 || right >= 2 * n - 1 ||
+            !Contains(nodes[i], nodes[left].m_boundsMin, nodes[left].m_boundsMax) ||
+            !Contains(nodes[i], nodes[right].m_boundsMin, nodes[right].m_boundsMax))
+        {
+            wrongBoxes++;
+        }
+    }
+    if (wrongBoxes > 0)
+    {
+        std::cout << "Collision mesh: " << wrongBoxes << " boxes don't hold their children." << std::endl;
+        valid = false;
+    }
+
+    if (valid)
+    {
+        std::cout << "Collision mesh: tree of " << n << " triangles is valid." << std::endl;
+    }
+    return valid;
+}
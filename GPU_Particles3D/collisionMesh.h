@@ -0,0 +1,113 @@
+/*
+Title: GPU Simulated Particle System
+File Name: collisionMesh.h
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+#include <vector>
+#include "GL/glew.h"
+#include "GLFW/glfw3.h"
+#include "glm/gtc/matrix_transform.hpp"
+#include "material.h"
+#include "bitonicSort.h"
+
+// Matches the Node struct in the bvh shaders and in compute.glsl.
+// The links let particles walk the tree in order without keeping a stack.
+struct CollisionNode
+{
+    glm::vec3 m_boundsMin;
+    GLint m_first;          // Internal nodes: left child, the next node if the box is hit. Leaves: ~triangle index.
+    glm::vec3 m_boundsMax;
+    GLint m_miss;           // Next node once this subtree is done with, -1 when there is nothing left.
+};
+
+// A triangle mesh that particles bounce off of (see MODULE_MESH_COLLISION in compute.glsl).
+// The triangles are put in a bounding volume hierarchy on the GPU, the same way BarnesHut builds its tree:
+// 1. Give every triangle the morton code of its center.
+// 2. Sort the triangles by morton code.
+// 3. Build a radix tree over the sorted codes.
+// 4. Find the links for walking the tree.
+// 5. Fit the boxes around the triangles, from the leaves up.
+// Moving the vertices only redoes step 5, so animated meshes can be updated every frame.
+// The tree stays valid, but it gets slower to walk if the triangles move far from where they were when it was built.
+class CollisionMesh
+{
+public:
+    // Must match WORK_GROUP_SIZE in the bvh shaders.
+    static const int WORK_GROUP_SIZE = 256;
+
+    // Every 3 indices make a triangle.
+    CollisionMesh(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices);
+    ~CollisionMesh();
+
+    // Moves the vertices and refits the boxes around them. The indices stay the same as when the mesh was made,
+    // so there have to be as many vertices as there were then, or nothing changes.
+    void UpdateVertices(const std::vector<glm::vec3>& vertices);
+
+    // Nodes of the tree, internal nodes first, with the root at 0.
+    GLuint GetNodeBuffer();
+
+    // Three vec4 corners for every triangle.
+    GLuint GetTriangleBuffer();
+
+    int GetTriangleCount();
+
+    // Counts calls to UpdateVertices, so particle systems can tell when the mesh has moved.
+    int GetUpdateCount();
+
+    // A box around the mesh before and after the last UpdateVertices. Anything resting on it is inside.
+    glm::vec3 GetChangedBoundsMin();
+    glm::vec3 GetChangedBoundsMax();
+
+    // Reads the tree back from the GPU and checks that every box holds everything under it,
+    // and that walking the links reaches every triangle exactly once. Very slow, prints what it finds.
+    bool ValidateTree();
+
+private:
+    void UploadTriangles(const std::vector<glm::vec3>& vertices);
+    void BuildTree(const std::vector<glm::vec3>& vertices);
+    void Refit();
+
+    int m_triangleCount;
+    int m_vertexCount;
+    std::vector<unsigned int> m_indices;
+
+    int m_updateCount = 0;
+    glm::vec3 m_boundsMin;
+    glm::vec3 m_boundsMax;
+    glm::vec3 m_changedBoundsMin;
+    glm::vec3 m_changedBoundsMax;
+
+    // Number of keys being sorted, padded up to a power of two.
+    int m_sortCount;
+
+    Material* m_mortonMat;
+    BitonicSort* m_sort;
+    Material* m_radixTreeMat;
+    Material* m_linksMat;
+    Material* m_refitMat;
+
+    GLuint m_triangleBuffer;
+    GLuint m_keyBuffer;
+    GLuint m_valueBuffer;
+    GLuint m_childBuffer;
+    GLuint m_parentBuffer;
+    GLuint m_nodeBuffer;
+    GLuint m_flagBuffer;
+};
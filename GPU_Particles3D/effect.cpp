@@ -0,0 +1,599 @@
+/*
+Title: GPU Simulated Particle System
+File Name: effect.cpp
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "effect.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <chrono>
+#include <map>
+#include <algorithm>
+
+// Binary effect files start with this, followed by the format version.
+static const char BINARY_MAGIC[4] = { 'P', 'F', 'X', 'B' };
+static const unsigned int BINARY_VERSION = 6;
+
+// Binary files are written and read by passing every field of a definition to one of these, in the same order.
+// Fixed size fields are copied as they are, strings and lists are written as a count followed by their contents.
+struct BinaryWriter
+{
+    std::ofstream& m_file;
+
+    template<typename T> void operator()(const T& value)
+    {
+        m_file.write((const char*)&value, sizeof(T));
+    }
+
+    void operator()(const std::string& value)
+    {
+        (*this)((unsigned int)value.size());
+        m_file.write(value.data(), value.size());
+    }
+
+    template<typename T> void operator()(const std::vector<T>& values)
+    {
+        (*this)((unsigned int)values.size());
+        m_file.write((const char*)values.data(), values.size() * sizeof(T));
+    }
+};
+
+// Lengths come from the file, so they are checked against what is left of it before anything is allocated.
+// A file that is cut short or corrupt fails the stream, instead of asking for a huge allocation.
+struct BinaryReader
+{
+    std::ifstream& m_file;
+    std::streamoff m_fileSize;
+
+    template<typename T> void operator()(T& value)
+    {
+        m_file.read((char*)&value, sizeof(T));
+    }
+
+    void operator()(std::string& value)
+    {
+        unsigned int size = 0;
+        (*this)(size);
+        value.resize(Fits(size, 1) ? size : 0);
+        m_file.read(&value[0], value.size());
+    }
+
+    template<typename T> void operator()(std::vector<T>& values)
+    {
+        unsigned int size = 0;
+        (*this)(size);
+        values.resize(Fits(size, sizeof(T)) ? size : 0);
+        m_file.read((char*)values.data(), values.size() * sizeof(T));
+    }
+
+    // Whether count items of itemSize bytes each can still be in the file. Fails the stream if not.
+    bool Fits(unsigned int count, size_t itemSize)
+    {
+        if (!m_file)
+        {
+            return false;
+        }
+        std::streamoff remaining = m_fileSize - (std::streamoff)m_file.tellg();
+        if ((double)count * itemSize > (double)remaining)
+        {
+            m_file.setstate(std::ios::failbit);
+            return false;
+        }
+        return true;
+    }
+};
+
+// Adds up how many bytes the fields take in a binary file. Empty strings and lists still take their count.
+struct BinarySizer
+{
+    size_t m_size;
+
+    template<typename T> void operator()(const T&)
+    {
+        m_size += sizeof(T);
+    }
+
+    void operator()(const std::string& value)
+    {
+        m_size += sizeof(unsigned int) + value.size();
+    }
+
+    template<typename T> void operator()(const std::vector<T>& values)
+    {
+        m_size += sizeof(unsigned int) + values.size() * sizeof(T);
+    }
+};
+
+// The order fields are stored in. Changing it means changing BINARY_VERSION.
+template<typename Definition, typename Visitor> static void VisitFields(Definition& effect, Visitor& visit)
+{
+    visit(effect.m_name);
+    visit(effect.m_texturePath);
+    visit(effect.m_flipbook);
+    visit(effect.m_maxParticles);
+    visit(effect.m_position);
+    visit(effect.m_lifeTime);
+    visit(effect.m_acceleration);
+    visit(effect.m_particleSize);
+    visit(effect.m_emitterSpeed);
+
+    visit(effect.m_modules.m_spawn);
+    visit(effect.m_modules.m_forces);
+    visit(effect.m_modules.m_damping);
+    visit(effect.m_modules.m_dampingRate);
+    visit(effect.m_modules.m_rotation);
+    visit(effect.m_modules.m_color);
+    visit(effect.m_modules.m_constantColor);
+    visit(effect.m_modules.m_collision);
+    visit(effect.m_modules.m_collisionPlane);
+    visit(effect.m_modules.m_restitution);
+    visit(effect.m_modules.m_windCoupling);
+    visit(effect.m_modules.m_windSplat);
+    visit(effect.m_modules.m_sleep);
+    visit(effect.m_modules.m_sleepSpeed);
+    visit(effect.m_modules.m_sleepTime);
+    visit(effect.m_modules.m_trails);
+    visit(effect.m_modules.m_trailLength);
+    visit(effect.m_modules.m_trailSpacing);
+    visit(effect.m_modules.m_flipbookBlend);
+    visit(effect.m_modules.m_culling);
+    visit(effect.m_modules.m_constantPosition);
+    visit(effect.m_modules.m_constantLifeTime);
+    visit(effect.m_modules.m_constantAcceleration);
+    visit(effect.m_modules.m_constantParticleSize);
+    visit(effect.m_modules.m_constantEmitterSpeed);
+
+    visit(effect.m_colorTimes);
+    visit(effect.m_colors);
+    visit(effect.m_sizeTimes);
+    visit(effect.m_sizes);
+
+    visit(effect.m_deathSubEmitter);
+    visit(effect.m_deathSpawnCount);
+    visit(effect.m_inheritVelocity);
+    visit(effect.m_loadBudget);
+}
+
+static bool ReadBinaryEffectFile(const std::string& path, std::ifstream& file, std::vector<EffectDefinition>& effects)
+{
+    std::streampos start = file.tellg();
+    file.seekg(0, std::ios::end);
+    BinaryReader read = { file, (std::streamoff)file.tellg() };
+    file.seekg(start);
+
+    unsigned int version = 0;
+    unsigned int count = 0;
+    read(version);
+    read(count);
+    if (version != BINARY_VERSION)
+    {
+        std::cout << path << ": binary effect version " << version << " isn't supported, rebuild it from the text file." << std::endl;
+        return false;
+    }
+
+    // Every effect takes at least as much room as one with empty strings and lists.
+    EffectDefinition empty;
+    empty.m_name.clear();
+    empty.m_texturePath.clear();
+    empty.m_colorTimes.clear();
+    empty.m_colors.clear();
+    empty.m_sizeTimes.clear();
+    empty.m_sizes.clear();
+    empty.m_deathSubEmitter.clear();
+    BinarySizer sizer = { 0 };
+    VisitFields(empty, sizer);
+    effects.resize(read.Fits(count, sizer.m_size) ? count : 0);
+    for (EffectDefinition& effect : effects)
+    {
+        VisitFields(effect, read);
+    }
+
+    if (!file)
+    {
+        std::cout << path << ": binary effect file is cut short." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Text files have one parameter per line: a name followed by its values. # starts a comment.
+// Every effect starts with "effect <name>", and the parameters after it belong to that effect.
+static bool ReadTextEffectFile(const std::string& path, std::ifstream& file, std::vector<EffectDefinition>& effects)
+{
+    std::string text;
+    int lineNumber = 0;
+    while (std::getline(file, text))
+    {
+        lineNumber++;
+        text = text.substr(0, text.find('#'));
+
+        std::istringstream line(text);
+        std::string key;
+        if (!(line >> key))
+        {
+            // Empty line.
+            continue;
+        }
+
+        if (key == "effect")
+        {
+            effects.push_back(EffectDefinition());
+            line >> effects.back().m_name;
+
+            // Everything is compiled into the shaders unless the effect says it is animated.
+            ParticleModules& modules = effects.back().m_modules;
+            modules.m_constantPosition = true;
+            modules.m_constantLifeTime = true;
+            modules.m_constantAcceleration = true;
+            modules.m_constantParticleSize = true;
+            modules.m_constantEmitterSpeed = true;
+            continue;
+        }
+        if (effects.empty())
+        {
+            std::cout << path << " line " << lineNumber << ": \"" << key << "\" comes before the first effect." << std::endl;
+            return false;
+        }
+
+        EffectDefinition& effect = effects.back();
+        ParticleModules& modules = effect.m_modules;
+        if (key == "texture")
+        {
+            line >> effect.m_texturePath;
+        }
+        else if (key == "flipbook")
+        {
+            line >> effect.m_flipbook.x >> effect.m_flipbook.y;
+            int blend;
+            if (line >> blend)
+            {
+                modules.m_flipbookBlend = blend != 0;
+            }
+            else
+            {
+                // Blend is optional.
+                line.clear();
+            }
+        }
+        else if (key == "maxParticles")
+        {
+            line >> effect.m_maxParticles;
+        }
+        else if (key == "position")
+        {
+            line >> effect.m_position.x >> effect.m_position.y >> effect.m_position.z;
+        }
+        else if (key == "lifeTime")
+        {
+            line >> effect.m_lifeTime;
+        }
+        else if (key == "acceleration")
+        {
+            line >> effect.m_acceleration.x >> effect.m_acceleration.y >> effect.m_acceleration.z;
+        }
+        else if (key == "particleSize")
+        {
+            line >> effect.m_particleSize.x >> effect.m_particleSize.y;
+        }
+        else if (key == "emitterSpeed")
+        {
+            line >> effect.m_emitterSpeed;
+        }
+        else if (key == "modules")
+        {
+            // Only the modules listed are turned on.
+            modules.m_spawn = modules.m_forces = modules.m_damping = false;
+            modules.m_rotation = modules.m_color = modules.m_collision = modules.m_sleep = modules.m_trails = modules.m_culling = false;
+            std::string module;
+            while (line >> module)
+            {
+                if (module == "spawn") modules.m_spawn = true;
+                else if (module == "forces") modules.m_forces = true;
+                else if (module == "damping") modules.m_damping = true;
+                else if (module == "rotation") modules.m_rotation = true;
+                else if (module == "color") modules.m_color = true;
+                else if (module == "collision") modules.m_collision = true;
+                else if (module == "sleep") modules.m_sleep = true;
+                else if (module == "trails") modules.m_trails = true;
+                else if (module == "culling") modules.m_culling = true;
+                else std::cout << path << " line " << lineNumber << ": unknown module \"" << module << "\"." << std::endl;
+            }
+
+            // Reading until the end of the line leaves the stream failed.
+            line.clear();
+        }
+        else if (key == "animated")
+        {
+            // These stay uniforms, so they can be changed while the effect runs.
+            std::string parameter;
+            while (line >> parameter)
+            {
+                if (parameter == "position") modules.m_constantPosition = false;
+                else if (parameter == "lifeTime") modules.m_constantLifeTime = false;
+                else if (parameter == "acceleration") modules.m_constantAcceleration = false;
+                else if (parameter == "particleSize") modules.m_constantParticleSize = false;
+                else if (parameter == "emitterSpeed") modules.m_constantEmitterSpeed = false;
+                else std::cout << path << " line " << lineNumber << ": \"" << parameter << "\" can't be animated." << std::endl;
+            }
+            line.clear();
+        }
+        else if (key == "dampingRate")
+        {
+            line >> modules.m_dampingRate;
+        }
+        else if (key == "constantColor")
+        {
+            line >> modules.m_constantColor.r >> modules.m_constantColor.g >> modules.m_constantColor.b >> modules.m_constantColor.a;
+        }
+        else if (key == "collisionPlane")
+        {
+            line >> modules.m_collisionPlane.x >> modules.m_collisionPlane.y >> modules.m_collisionPlane.z >> modules.m_collisionPlane.w;
+        }
+        else if (key == "restitution")
+        {
+            line >> modules.m_restitution;
+        }
+        else if (key == "windCoupling")
+        {
+            line >> modules.m_windCoupling;
+        }
+        else if (key == "windSplat")
+        {
+            line >> modules.m_windSplat;
+        }
+        else if (key == "sleepSpeed")
+        {
+            line >> modules.m_sleepSpeed;
+        }
+        else if (key == "sleepTime")
+        {
+            line >> modules.m_sleepTime;
+        }
+        else if (key == "trailLength")
+        {
+            line >> modules.m_trailLength;
+        }
+        else if (key == "trailSpacing")
+        {
+            line >> modules.m_trailSpacing;
+        }
+        else if (key == "color")
+        {
+            float time;
+            glm::vec4 color;
+            line >> time >> color.r >> color.g >> color.b >> color.a;
+            effect.m_colorTimes.push_back(time);
+            effect.m_colors.push_back(color);
+        }
+        else if (key == "size")
+        {
+            float time;
+            float size;
+            line >> time >> size;
+            effect.m_sizeTimes.push_back(time);
+            effect.m_sizes.push_back(size);
+        }
+        else if (key == "deathSubEmitter")
+        {
+            line >> effect.m_deathSubEmitter >> effect.m_deathSpawnCount;
+            if (!(line >> effect.m_inheritVelocity))
+            {
+                // Inherit velocity is optional.
+                effect.m_inheritVelocity = .5f;
+                line.clear();
+            }
+        }
+        else if (key == "budget")
+        {
+            line >> effect.m_loadBudget;
+        }
+        else
+        {
+            std::cout << path << " line " << lineNumber << ": unknown parameter \"" << key << "\"." << std::endl;
+            continue;
+        }
+
+        if (line.fail())
+        {
+            std::cout << path << " line " << lineNumber << ": bad value for \"" << key << "\"." << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ReadEffectFile(const std::string& path, std::vector<EffectDefinition>& effects)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cout << "Could not open effect file: " << path << std::endl;
+        return false;
+    }
+
+    // Check for the binary header, and go back to the start if this is a text file.
+    char magic[4] = {};
+    file.read(magic, 4);
+    if (file && std::equal(magic, magic + 4, BINARY_MAGIC))
+    {
+        return ReadBinaryEffectFile(path, file, effects);
+    }
+    file.clear();
+    file.seekg(0);
+    return ReadTextEffectFile(path, file, effects);
+}
+
+bool WriteBinaryEffectFile(const std::string& path, const std::vector<EffectDefinition>& effects)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cout << "Could not write effect file: " << path << std::endl;
+        return false;
+    }
+
+    BinaryWriter write = { file };
+    file.write(BINARY_MAGIC, 4);
+    write(BINARY_VERSION);
+    write((unsigned int)effects.size());
+    for (const EffectDefinition& effect : effects)
+    {
+        VisitFields(effect, write);
+    }
+    return (bool)file;
+}
+
+Effect::Effect(const std::string& path)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    Clock::time_point readStart = Clock::now();
+
+    std::vector<EffectDefinition> definitions;
+    if (!ReadEffectFile(path, definitions))
+    {
+        return;
+    }
+    float readTime = std::chrono::duration<float, std::milli>(Clock::now() - readStart).count();
+    std::cout << "Read " << path << " in " << readTime << " ms" << std::endl;
+
+    // Systems that use the same texture, cut into the same frames, share it.
+    std::map<std::pair<std::string, std::pair<int, int>>, Texture*> textures;
+
+    // Time spent building each system. Sub-emitters change which modules their systems use,
+    // so the systems are all made first, and the shaders are only compiled once they are connected.
+    std::vector<float> buildTimes;
+    for (const EffectDefinition& definition : definitions)
+    {
+        Clock::time_point start = Clock::now();
+
+        glm::ivec2 flipbook = definition.m_flipbook;
+        Texture*& texture = textures[std::make_pair(definition.m_texturePath, std::make_pair(flipbook.x, flipbook.y))];
+        if (texture == nullptr)
+        {
+            if (flipbook.x * flipbook.y > 1)
+            {
+                texture = new Texture((char*)definition.m_texturePath.c_str(), flipbook.x, flipbook.y);
+            }
+            else
+            {
+                texture = new Texture((char*)definition.m_texturePath.c_str());
+            }
+        }
+
+        ParticleSystem* system = new ParticleSystem(texture, definition.m_maxParticles);
+        system->m_position = definition.m_position;
+        system->m_lifeTime = definition.m_lifeTime;
+        system->m_acceleration = definition.m_acceleration;
+        system->m_particleSize = definition.m_particleSize;
+        system->m_emitterSpeed = definition.m_emitterSpeed;
+        system->SetModules(definition.m_modules);
+
+        // Without the spawn module, particles only come to life when a parent system asks for them.
+        if (!definition.m_modules.m_spawn)
+        {
+            system->KillAllParticles();
+        }
+
+        if (!definition.m_colorTimes.empty() || !definition.m_sizeTimes.empty())
+        {
+            ColorGradient color;
+            for (size_t i = 0; i < definition.m_colorTimes.size(); i++)
+            {
+                color.AddKey(definition.m_colorTimes[i], definition.m_colors[i]);
+            }
+            Curve size;
+            for (size_t i = 0; i < definition.m_sizeTimes.size(); i++)
+            {
+                size.AddKey(definition.m_sizeTimes[i], definition.m_sizes[i]);
+            }
+            system->SetLifetimeCurves(color, size);
+        }
+
+        m_names.push_back(definition.m_name);
+        m_systems.push_back(system);
+        buildTimes.push_back(std::chrono::duration<float, std::milli>(Clock::now() - start).count());
+    }
+
+    for (size_t i = 0; i < definitions.size(); i++)
+    {
+        const EffectDefinition& definition = definitions[i];
+        if (definition.m_deathSubEmitter.empty())
+        {
+            continue;
+        }
+
+        Clock::time_point start = Clock::now();
+        ParticleSystem* child = GetSystem(definition.m_deathSubEmitter);
+        if (child == nullptr)
+        {
+            std::cout << path << ": effect " << definition.m_name << " has an unknown sub-emitter " << definition.m_deathSubEmitter << std::endl;
+            continue;
+        }
+        m_systems[i]->SetSubEmitter(SubEmitterEvent::Death, child, definition.m_deathSpawnCount, definition.m_inheritVelocity);
+        buildTimes[i] += std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+    }
+
+    for (size_t i = 0; i < definitions.size(); i++)
+    {
+        // Getting the material builds and compiles the shaders.
+        Clock::time_point start = Clock::now();
+        m_systems[i]->GetMaterial();
+        glFinish();
+        buildTimes[i] += std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+
+        float budget = definitions[i].m_loadBudget;
+        std::cout << "Effect " << m_names[i] << ": built in " << buildTimes[i] << " ms";
+        if (budget > 0)
+        {
+            std::cout << (buildTimes[i] > budget ? ", OVER its budget of " : ", within its budget of ") << budget << " ms";
+        }
+        std::cout << ", " << definitions[i].m_maxParticles * sizeof(Particle) / 1024 << " KB of particles" << std::endl;
+    }
+}
+
+Effect::~Effect()
+{
+    for (ParticleSystem* system : m_systems)
+    {
+        delete system;
+    }
+}
+
+ParticleSystem* Effect::GetSystem(const std::string& name)
+{
+    for (size_t i = 0; i < m_names.size(); i++)
+    {
+        if (m_names[i] == name)
+        {
+            return m_systems[i];
+        }
+    }
+    return nullptr;
+}
+
+ParticleSystem* Effect::GetSystem(int index)
+{
+    return m_systems[index];
+}
+
+int Effect::GetSystemCount()
+{
+    return (int)m_systems.size();
+}
@@ -0,0 +1,86 @@
+/*
+Title: GPU Simulated Particle System
+File Name: effect.h
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+#include <string>
+#include <vector>
+#include "particleSystem.h"
+
+// Everything needed to build one particle system, as read from an effect file.
+// See demo.effect in the assets folder for the text format.
+struct EffectDefinition
+{
+    std::string m_name;
+    std::string m_texturePath = "../assets/particle.png";
+    // Columns and rows of flipbook frames in the texture. 1 by 1 is a plain texture.
+    glm::ivec2 m_flipbook = glm::ivec2(1, 1);
+    int m_maxParticles = ParticleSystem::DEFAULT_MAX_PARTICLES;
+
+    glm::vec3 m_position = glm::vec3(0, 0, 0);
+    float m_lifeTime = 1.f;
+    glm::vec3 m_acceleration = glm::vec3(0, 0, 0);
+    glm::vec2 m_particleSize = glm::vec2(100, 100);
+    float m_emitterSpeed = 1.f;
+
+    // Which modules are on, and which parameters are compiled into the shaders.
+    // Parameters the text file lists as animated stay uniforms, every other one becomes a constant.
+    ParticleModules m_modules;
+
+    // Lifetime curve keys. The system keeps its default look if there are none.
+    std::vector<float> m_colorTimes;
+    std::vector<glm::vec4> m_colors;
+    std::vector<float> m_sizeTimes;
+    std::vector<float> m_sizes;
+
+    // Name of another effect in the same file, to spawn when particles die. Empty for none.
+    std::string m_deathSubEmitter;
+    int m_deathSpawnCount = 0;
+    float m_inheritVelocity = .5f;
+
+    // How long building this effect should take, in milliseconds. 0 for no budget.
+    float m_loadBudget = 0;
+};
+
+// Reads every effect in a text or binary effect file. Binary files are recognized by their header.
+// Prints what went wrong and returns false if the file can't be read.
+bool ReadEffectFile(const std::string& path, std::vector<EffectDefinition>& effects);
+
+// Writes effects in the binary format, which is smaller and loads without any parsing.
+bool WriteBinaryEffectFile(const std::string& path, const std::vector<EffectDefinition>& effects);
+
+// The particle systems built from one effect file.
+class Effect
+{
+public:
+    // Builds every system in the file, and compiles their shaders right away instead of on the first frame.
+    // Prints how long each one took, and whether it went over its budget.
+    Effect(const std::string& path);
+    ~Effect();
+
+    // Returns nullptr if there's no system with that name.
+    ParticleSystem* GetSystem(const std::string& name);
+    ParticleSystem* GetSystem(int index);
+    int GetSystemCount();
+
+private:
+    std::vector<std::string> m_names;
+    std::vector<ParticleSystem*> m_systems;
+};
@@ -0,0 +1,167 @@
+/*
+Title: GPU Simulated Particle System
+File Name: gpuEmitters.cpp
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gpuEmitters.h"
+
+GPUEmitters::GPUEmitters(int maxEmitters, int ringSize)
+{
+    m_maxEmitters = maxEmitters;
+    m_persistent = GLEW_ARB_buffer_storage != 0;
+
+    ShaderProgram* program = new ShaderProgram();
+    program->AttachShader(new Shader("../Assets/gpuEmitters.glsl", GL_COMPUTE_SHADER));
+    m_emitMat = new Material(program);
+
+    GLsizeiptr size = maxEmitters * sizeof(GPUEmitter);
+    m_slots.resize(ringSize);
+    for (Slot& slot : m_slots)
+    {
+        glGenBuffers(1, &slot.m_buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot.m_buffer);
+        if (m_persistent)
+        {
+            // Coherent, so whatever the CPU writes is there for the next dispatch without flushing anything.
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_SHADER_STORAGE_BUFFER, size, nullptr, flags);
+            slot.m_mapped = glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, size, flags);
+        }
+        else
+        {
+            glBufferData(GL_SHADER_STORAGE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        }
+    }
+    if (!m_persistent)
+    {
+        m_staging.resize(maxEmitters);
+    }
+
+    // Nobody is owed anything yet.
+    glGenBuffers(1, &m_carryBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_carryBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, maxEmitters * sizeof(float), nullptr, GL_DYNAMIC_COPY);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32F, GL_RED, GL_FLOAT, nullptr);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+GPUEmitters::~GPUEmitters()
+{
+    for (Slot& slot : m_slots)
+    {
+        if (slot.m_fence != 0)
+        {
+            glDeleteSync(slot.m_fence);
+        }
+        if (m_persistent)
+        {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot.m_buffer);
+            glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &slot.m_buffer);
+    }
+    glDeleteBuffers(1, &m_carryBuffer);
+    delete m_emitMat;
+}
+
+int GPUEmitters::AddEffect(ParticleSystem* system, float inheritVelocity)
+{
+    Effect effect;
+    effect.m_system = system;
+    effect.m_spawnRequestBuffer = system->EnableSpawnRequests();
+    effect.m_inheritVelocity = inheritVelocity;
+    m_effects.push_back(effect);
+    return (int)m_effects.size() - 1;
+}
+
+GPUEmitter* GPUEmitters::Map()
+{
+    if (!m_persistent)
+    {
+        return m_staging.data();
+    }
+
+    // The GPU could still be reading this buffer from a ring of frames ago.
+    Slot& slot = m_slots[m_currentSlot];
+    if (slot.m_fence != 0)
+    {
+        glClientWaitSync(slot.m_fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(slot.m_fence);
+        slot.m_fence = 0;
+    }
+    return (GPUEmitter*)slot.m_mapped;
+}
+
+void GPUEmitters::Update(float dt, int emitterCount)
+{
+    emitterCount = glm::min(emitterCount, m_maxEmitters);
+    Slot& slot = m_slots[m_currentSlot];
+    m_currentSlot = (m_currentSlot + 1) % (int)m_slots.size();
+    if (emitterCount <= 0 || m_effects.empty())
+    {
+        return;
+    }
+
+    if (m_persistent)
+    {
+        // Writes through the mapping have to land before the dispatch reads them.
+        glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+    }
+    else
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot.m_buffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, emitterCount * sizeof(GPUEmitter), m_staging.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, slot.m_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_carryBuffer);
+    m_emitMat->SetInt((char*)"emitterCount", emitterCount);
+    m_emitMat->SetFloat((char*)"dt", dt);
+
+    // One pass per effect, each appending to its own system's requests. Effects are few, emitters are many.
+    int workGroups = (emitterCount + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE;
+    for (int i = 0; i < (int)m_effects.size(); i++)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_effects[i].m_spawnRequestBuffer);
+        m_emitMat->SetInt((char*)"effect", i);
+        m_emitMat->SetFloat((char*)"inheritVelocity", m_effects[i].m_inheritVelocity);
+        m_emitMat->Bind();
+        glDispatchCompute(workGroups, 1, 1);
+    }
+    m_emitMat->Unbind();
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, 0);
+
+    // The systems read the requests in their own Update.
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // Map waits on this before handing the buffer out again.
+    if (m_persistent)
+    {
+        slot.m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+}
+
+int GPUEmitters::GetMaxEmitters()
+{
+    return m_maxEmitters;
+}
@@ -0,0 +1,102 @@
+/*
+Title: GPU Simulated Particle System
+File Name: gpuEmitters.h
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <vector>
+#include "GL/glew.h"
+#include "GLFW/glfw3.h"
+#include "glm/gtc/matrix_transform.hpp"
+#include "material.h"
+#include "particleSystem.h"
+
+// A point that sprays particles into one of the effects of a GPUEmitters, written straight into GPU memory.
+// Laid out the way gpuEmitters.glsl reads it.
+struct GPUEmitter
+{
+    glm::vec3 m_position;
+    float m_rate;           // Particles per second.
+    glm::vec3 m_velocity;   // How fast the emitter itself is moving. Particles inherit part of it.
+    GLint m_effect;         // Id from AddEffect, or negative to emit nothing.
+};
+
+// Thousands of moving emitters, like sparks coming off projectiles, without a ParticleSystem each.
+// Gameplay code writes every emitter straight into a mapped buffer each frame, so the CPU cost of an emitter
+// is the bytes it takes up. On the GPU, one pass per effect turns the emitters into spawn requests for the
+// effect's particle system, which dead particles pick up in that system's next Update.
+// Every emitter of an effect shares its system's particle pool, lifetime and look.
+// The buffer is one of a ring, so the CPU can write the next frame's emitters while the GPU reads the last ones.
+// With ARB_buffer_storage the ring stays mapped the whole time, otherwise Map hands out a CPU copy,
+// which Update uploads.
+class GPUEmitters
+{
+public:
+    // Must match WORK_GROUP_SIZE in gpuEmitters.glsl
+    static const int WORK_GROUP_SIZE = 256;
+
+    // Enough for the CPU to write one frame while the GPU is still reading the two before it.
+    static const int DEFAULT_RING_SIZE = 3;
+
+    GPUEmitters(int maxEmitters, int ringSize = DEFAULT_RING_SIZE);
+    ~GPUEmitters();
+
+    // Makes emitters with the returned id spawn into system, which from then on only spawns when asked to
+    // (see ParticleSystem::EnableSpawnRequests). Particles start with inheritVelocity times the emitter's velocity.
+    // The system isn't owned, and has to be updated after the emitters every frame.
+    int AddEffect(ParticleSystem* system, float inheritVelocity = .5f);
+
+    // Room for GetMaxEmitters emitters for the next Update. The buffer is a different one every frame, so write
+    // every emitter each time, memcpy a whole array in if you keep one. Only waits if the GPU is a whole ring
+    // of frames behind.
+    GPUEmitter* Map();
+
+    // Spawns this frame's particles from the first emitterCount emitters written since the last Map.
+    void Update(float dt, int emitterCount);
+
+    int GetMaxEmitters();
+
+private:
+    struct Effect
+    {
+        ParticleSystem* m_system;
+        GLuint m_spawnRequestBuffer;
+        float m_inheritVelocity;
+    };
+
+    struct Slot
+    {
+        GLuint m_buffer = 0;
+        GLsync m_fence = 0;
+        void* m_mapped = nullptr;
+    };
+
+    std::vector<Effect> m_effects;
+    std::vector<Slot> m_slots;
+    int m_currentSlot = 0;
+    int m_maxEmitters;
+    bool m_persistent;
+
+    // Written by Map when the ring can't stay mapped, and uploaded by Update.
+    std::vector<GPUEmitter> m_staging;
+
+    // Fraction of a particle each emitter is owed, kept on the GPU.
+    GLuint m_carryBuffer;
+
+    Material* m_emitMat;
+};
@@ -0,0 +1,159 @@
+/*
+Title: GPU Simulated Particle System
+File Name: gpuReadback.cpp
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "gpuReadback.h"
+
+GPUReadback::GPUReadback(GLsizeiptr size, int ringSize)
+{
+    m_size = size;
+    m_persistent = GLEW_ARB_buffer_storage != 0;
+    m_slots.resize(ringSize);
+    for (Slot& slot : m_slots)
+    {
+        glGenBuffers(1, &slot.m_buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, slot.m_buffer);
+        if (m_persistent)
+        {
+            // Coherent, so finished copies show up in the mapping without flushing anything.
+            GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+            slot.m_mapped = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+        }
+        else
+        {
+            glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STREAM_READ);
+        }
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+GPUReadback::~GPUReadback()
+{
+    FinishRead();
+    for (Slot& slot : m_slots)
+    {
+        if (slot.m_fence != 0)
+        {
+            glDeleteSync(slot.m_fence);
+        }
+        if (m_persistent)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, slot.m_buffer);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &slot.m_buffer);
+    }
+}
+
+int GPUReadback::Copy(GLuint source, GLintptr offset, GLsizeiptr size)
+{
+    FinishRead();
+
+    // Never wait for the CPU to catch up, drop the oldest copy instead.
+    int ringSize = (int)m_slots.size();
+    if (m_pending == ringSize)
+    {
+        glDeleteSync(m_slots[m_oldest].m_fence);
+        m_slots[m_oldest].m_fence = 0;
+        m_oldest = (m_oldest + 1) % ringSize;
+        m_pending--;
+        m_droppedCount++;
+    }
+
+    Slot& slot = m_slots[(m_oldest + m_pending) % ringSize];
+    m_pending++;
+
+    // Shader writes to the source have to land before the copy reads it.
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_COPY_READ_BUFFER, source);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, slot.m_buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, 0, size < m_size ? size : m_size);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    // The fence passes once the copy is done, and is the only thing Read ever waits on, without blocking.
+    if (m_persistent)
+    {
+        glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+    }
+    slot.m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.m_copyNumber = m_copyCount;
+    return m_copyCount++;
+}
+
+int GPUReadback::Read(const void** data)
+{
+    FinishRead();
+    if (m_pending == 0)
+    {
+        return -1;
+    }
+
+    // A timeout of 0 only checks the fence. Flushing makes sure the fence gets to the GPU at all,
+    // in case nothing else flushes before the next check.
+    Slot& slot = m_slots[m_oldest];
+    GLenum status = glClientWaitSync(slot.m_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+    {
+        return -1;
+    }
+    glDeleteSync(slot.m_fence);
+    slot.m_fence = 0;
+
+    if (m_persistent)
+    {
+        *data = slot.m_mapped;
+    }
+    else
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, slot.m_buffer);
+        *data = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, m_size, GL_MAP_READ_BIT);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        m_mappedSlot = m_oldest;
+    }
+
+    m_oldest = (m_oldest + 1) % (int)m_slots.size();
+    m_pending--;
+    return slot.m_copyNumber;
+}
+
+int GPUReadback::GetCopyCount()
+{
+    return m_copyCount;
+}
+
+int GPUReadback::GetDroppedCount()
+{
+    return m_droppedCount;
+}
+
+void GPUReadback::FinishRead()
+{
+    if (m_mappedSlot < 0)
+    {
+        return;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_slots[m_mappedSlot].m_buffer);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    m_mappedSlot = -1;
+}
@@ -0,0 +1,82 @@
+/*
+Title: GPU Simulated Particle System
+File Name: gpuReadback.h
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+#include <vector>
+#include "GL/glew.h"
+#include "GLFW/glfw3.h"
+
+// Copies small GPU buffers back to the CPU without ever waiting for the GPU.
+// Each Copy goes into the next of a ring of readback buffers, followed by a fence. Read only hands a copy
+// back once its fence has passed, which is usually a frame or two later, so the pipeline never stalls.
+// With ARB_buffer_storage the readback buffers stay mapped the whole time, otherwise a finished one is
+// mapped when it is read, which doesn't stall either, because the GPU is already done with it.
+class GPUReadback
+{
+public:
+    // Enough for the CPU to run two frames ahead of the GPU without dropping anything.
+    static const int DEFAULT_RING_SIZE = 3;
+
+    // size is the most a single copy can hold.
+    GPUReadback(GLsizeiptr size, int ringSize = DEFAULT_RING_SIZE);
+    ~GPUReadback();
+
+    // Starts copying size bytes from offset in source. Shader writes to source before this are included.
+    // If every buffer in the ring is still waiting to be read, the oldest copy is dropped to make room.
+    // Returns the number of this copy, counting up from 0.
+    int Copy(GLuint source, GLintptr offset, GLsizeiptr size);
+
+    // If the oldest copy is finished, points data at it and returns its number. Otherwise returns -1.
+    // Copies come back in order. The data stays valid until the next call to Copy or Read.
+    int Read(const void** data);
+
+    // Number of the next copy, so GetCopyCount() - 1 - Read(...) is how many copies behind a result is.
+    int GetCopyCount();
+
+    // Copies that were dropped because the ring was full.
+    int GetDroppedCount();
+
+private:
+    struct Slot
+    {
+        GLuint m_buffer = 0;
+        GLsync m_fence = 0;
+        void* m_mapped = nullptr;
+        int m_copyNumber = 0;
+    };
+
+    // Unmaps the buffer the last Read mapped, when it isn't persistently mapped.
+    void FinishRead();
+
+    std::vector<Slot> m_slots;
+    GLsizeiptr m_size;
+    bool m_persistent;
+
+    // Oldest copy that hasn't been read, and how many are waiting.
+    int m_oldest = 0;
+    int m_pending = 0;
+
+    int m_copyCount = 0;
+    int m_droppedCount = 0;
+
+    // Slot mapped by the last Read, -1 if none.
+    int m_mappedSlot = -1;
+};
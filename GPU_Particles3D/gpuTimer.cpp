@@ -0,0 +1,83 @@
+/*
+Title: GPU Simulated Particle System
+File Name: gpuTimer.cpp
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gpuTimer.h"
+
+GPUTimer::GPUTimer(int ringSize)
+{
+    m_queries.resize(ringSize);
+    glGenQueries(ringSize, m_queries.data());
+}
+
+GPUTimer::~GPUTimer()
+{
+    glDeleteQueries((GLsizei)m_queries.size(), m_queries.data());
+}
+
+void GPUTimer::Begin()
+{
+    if (m_pending == (int)m_queries.size())
+    {
+        m_oldest = (m_oldest + 1) % m_queries.size();
+        m_pending--;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, m_queries[m_next]);
+}
+
+void GPUTimer::End()
+{
+    glEndQuery(GL_TIME_ELAPSED);
+    m_next = (m_next + 1) % m_queries.size();
+    m_pending++;
+}
+
+float GPUTimer::GetMilliseconds()
+{
+    // Asking for the result blocks until the query is finished.
+    int latest = (m_next + (int)m_queries.size() - 1) % m_queries.size();
+    GLuint64 nanoseconds = 0;
+    glGetQueryObjectui64v(m_queries[latest], GL_QUERY_RESULT, &nanoseconds);
+    m_oldest = m_next;
+    m_pending = 0;
+    return nanoseconds / 1000000.f;
+}
+
+bool GPUTimer::ReadMilliseconds(float& milliseconds)
+{
+    if (m_pending == 0)
+    {
+        return false;
+    }
+
+    // Asking if the result is there doesn't block.
+    GLuint available = 0;
+    glGetQueryObjectuiv(m_queries[m_oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+    {
+        return false;
+    }
+
+    GLuint64 nanoseconds = 0;
+    glGetQueryObjectui64v(m_queries[m_oldest], GL_QUERY_RESULT, &nanoseconds);
+    m_oldest = (m_oldest + 1) % m_queries.size();
+    m_pending--;
+    milliseconds = nanoseconds / 1000000.f;
+    return true;
+}
@@ -0,0 +1,59 @@
+/*
+Title: GPU Simulated Particle System
+File Name: gpuTimer.h
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <vector>
+#include "GL/glew.h"
+#include "GLFW/glfw3.h"
+
+// Measures how long the GPU spends on the commands issued between Begin and End.
+// CPU timers can't do this, because gl calls return long before the GPU has done the work.
+// Timings can be read without waiting, a few frames late: each Begin uses the next query in a ring,
+// and ReadMilliseconds hands back the oldest one once the GPU has finished it.
+class GPUTimer
+{
+private:
+    // GL index for each timer query in the ring
+    std::vector<GLuint> m_queries;
+
+    // Query the next Begin uses, the oldest one that hasn't been read, and how many are waiting.
+    int m_next = 0;
+    int m_oldest = 0;
+    int m_pending = 0;
+
+public:
+    // Enough for the CPU to run a couple of frames ahead of the GPU without losing timings.
+    static const int DEFAULT_RING_SIZE = 4;
+
+    // The default of one query is all a benchmark that waits with GetMilliseconds needs.
+    GPUTimer(int ringSize = 1);
+    ~GPUTimer();
+
+    // If every query in the ring is still waiting to be read, the oldest timing is thrown away to make room.
+    void Begin();
+    void End();
+
+    // Waits for the GPU to finish the timed commands, and returns the time they took in milliseconds.
+    // This stalls the CPU, so only use it for benchmarks. Timings before the latest one are thrown away.
+    float GetMilliseconds();
+
+    // If the oldest timing is finished, sets milliseconds to it and returns true. Never waits for the GPU.
+    bool ReadMilliseconds(float& milliseconds);
+};
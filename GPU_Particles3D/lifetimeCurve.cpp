@@ -0,0 +1,102 @@
+/*
+Title: GPU Simulated Particle System
+File Name: lifetimeCurve.cpp
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "lifetimeCurve.h"
+
+void ColorGradient::AddKey(float time, glm::vec4 color)
+{
+    // Insert the key in order.
+    int i = 0;
+    while (i < (int)m_times.size() && m_times[i] <= time)
+    {
+        i++;
+    }
+    m_times.insert(m_times.begin() + i, time);
+    m_colors.insert(m_colors.begin() + i, color);
+}
+
+glm::vec4 ColorGradient::Evaluate(float time) const
+{
+    if (m_times.empty())
+    {
+        return glm::vec4(1);
+    }
+    if (time <= m_times.front())
+    {
+        return m_colors.front();
+    }
+
+    // Find the two keys on either side, and blend between them.
+    for (int i = 1; i < (int)m_times.size(); i++)
+    {
+        if (time < m_times[i])
+        {
+            float t = (time - m_times[i - 1]) / (m_times[i] - m_times[i - 1]);
+            return glm::mix(m_colors[i - 1], m_colors[i], t);
+        }
+    }
+    return m_colors.back();
+}
+
+void Curve::AddKey(float time, float value)
+{
+    int i = 0;
+    while (i < (int)m_times.size() && m_times[i] <= time)
+    {
+        i++;
+    }
+    m_times.insert(m_times.begin() + i, time);
+    m_values.insert(m_values.begin() + i, value);
+}
+
+float Curve::Evaluate(float time) const
+{
+    if (m_times.empty())
+    {
+        return 1;
+    }
+    if (time <= m_times.front())
+    {
+        return m_values.front();
+    }
+
+    for (int i = 1; i < (int)m_times.size(); i++)
+    {
+        if (time < m_times[i])
+        {
+            float t = (time - m_times[i - 1]) / (m_times[i] - m_times[i - 1]);
+            return glm::mix(m_values[i - 1], m_values[i], t);
+        }
+    }
+    return m_values.back();
+}
+
+Texture* BakeLifetimeTexture(const ColorGradient& color, const Curve& size)
+{
+    std::vector<glm::vec4> pixels(LIFETIME_TEXTURE_RESOLUTION * 2);
+    for (int i = 0; i < LIFETIME_TEXTURE_RESOLUTION; i++)
+    {
+        // Sample at the center of each texel, which is where linear filtering returns exactly that texel.
+        float time = (i + .5f) / LIFETIME_TEXTURE_RESOLUTION;
+        pixels[i] = color.Evaluate(time);
+        pixels[LIFETIME_TEXTURE_RESOLUTION + i] = glm::vec4(size.Evaluate(time), 0, 0, 0);
+    }
+    return new Texture(LIFETIME_TEXTURE_RESOLUTION, 2, &pixels[0].x);
+}
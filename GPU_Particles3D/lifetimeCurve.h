@@ -0,0 +1,59 @@
+/*
+Title: GPU Simulated Particle System
+File Name: lifetimeCurve.h
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <vector>
+#include "glm/gtc/matrix_transform.hpp"
+#include "texture.h"
+
+// A color that changes over a particle's life.
+// Time goes from 0 when the particle is born to 1 when it dies, and the color
+// blends linearly between keys. Before the first key and after the last, it holds still.
+class ColorGradient
+{
+public:
+    void AddKey(float time, glm::vec4 color);
+    glm::vec4 Evaluate(float time) const;
+
+private:
+    // Kept sorted by time.
+    std::vector<float> m_times;
+    std::vector<glm::vec4> m_colors;
+};
+
+// A single value that changes over a particle's life, works the same way as ColorGradient.
+class Curve
+{
+public:
+    void AddKey(float time, float value);
+    float Evaluate(float time) const;
+
+private:
+    std::vector<float> m_times;
+    std::vector<float> m_values;
+};
+
+// Number of samples across a baked lifetime texture.
+const int LIFETIME_TEXTURE_RESOLUTION = 256;
+
+// Bakes color and size into a texture with two rows, so shaders can look them up
+// with a single texture read instead of calculating them for every particle.
+// The first row is color, the red channel of the second row is size.
+Texture* BakeLifetimeTexture(const ColorGradient& color, const Curve& size);
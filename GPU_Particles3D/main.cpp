@@ -32,11 +32,109 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "texture.h"
 #include "particleSystem.h"
 #include "fpsController.h"
+#include "benchmark.h"
+#include "effect.h"
+#include "qualityScaler.h"
 
 glm::vec2 viewportDimensions = glm::vec2(800, 600);
 glm::vec2 mousePosition;
 ParticleSystem* particleSystem;
 
+// Owns particleSystem and sparks.
+Effect* effect;
+
+// Spawned by particleSystem when its particles die, like fireworks.
+ParticleSystem* sparks;
+bool sparksEnabled = false;
+
+// Air around the emitter that particles are blown around by, when turned on.
+WindGrid* wind;
+bool windEnabled = false;
+
+// A rippling sheet under the emitter that particles bounce off, when turned on.
+CollisionMesh* ground;
+bool groundEnabled = false;
+
+// Scales particle quality down when the GPU can't keep up. At lower render scales the particles are drawn
+// into a smaller target, which is stretched over the window afterwards.
+QualityScaler* quality;
+GLuint particleFramebuffer = 0;
+GLuint particleColorTexture = 0;
+glm::ivec2 particleTargetSize = glm::ivec2(0);
+
+
+// Makes a torus lying flat around the origin, used as an emitter mesh.
+void makeTorus(float radius, float thickness, int rings, int sides, std::vector<glm::vec3>& vertices, std::vector<unsigned int>& indices)
+{
+    for (int ring = 0; ring < rings; ring++)
+    {
+        float u = ring * 6.2832f / rings;
+        for (int side = 0; side < sides; side++)
+        {
+            float v = side * 6.2832f / sides;
+            float distance = radius + cos(v) * thickness;
+            vertices.push_back(glm::vec3(cos(u) * distance, sin(v) * thickness, sin(u) * distance));
+
+            // Two triangles joining this vertex to the next ring and side.
+            unsigned int a = ring * sides + side;
+            unsigned int b = ((ring + 1) % rings) * sides + side;
+            unsigned int c = ((ring + 1) % rings) * sides + (side + 1) % sides;
+            unsigned int d = ring * sides + (side + 1) % sides;
+            unsigned int quad[] = { a, d, b, b, d, c };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+}
+
+// Makes a square sheet of waves around center, cells across on each side.
+// Only the heights change with time, so the indices stay the same and the collision mesh only has to be refit.
+void makeRipples(glm::vec3 center, float size, int cells, float time, std::vector<glm::vec3>& vertices, std::vector<unsigned int>& indices)
+{
+    vertices.clear();
+    indices.clear();
+    for (int z = 0; z <= cells; z++)
+    {
+        for (int x = 0; x <= cells; x++)
+        {
+            float px = (x / (float)cells - .5f) * size;
+            float pz = (z / (float)cells - .5f) * size;
+            float height = sin(px * 2 + time) * cos(pz * 2 + time) * .3f;
+            vertices.push_back(center + glm::vec3(px, height, pz));
+
+            // Two triangles for the cell next to this vertex.
+            if (x < cells && z < cells)
+            {
+                unsigned int a = z * (cells + 1) + x;
+                unsigned int b = a + cells + 1;
+                unsigned int quad[] = { a, b, a + 1, a + 1, b, b + 1 };
+                indices.insert(indices.end(), quad, quad + 6);
+            }
+        }
+    }
+}
+
+// Makes the low resolution particle target the given size, if it isn't already.
+void resizeParticleTarget(glm::ivec2 size)
+{
+    if (size == particleTargetSize)
+    {
+        return;
+    }
+    particleTargetSize = size;
+    if (particleFramebuffer == 0)
+    {
+        glGenFramebuffers(1, &particleFramebuffer);
+        glGenTextures(1, &particleColorTexture);
+    }
+    glBindTexture(GL_TEXTURE_2D, particleColorTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, particleFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, particleColorTexture, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
 
 // Window resize callback
 void resizeCallback(GLFWwindow* window, int width, int height)
@@ -70,10 +168,111 @@ void keyPressCallback(GLFWwindow* window, int key, int scancode, int action, int
     {
         particleSystem->m_particleSize -= 50;
     }
+    if (key == GLFW_KEY_N && action == GLFW_PRESS)
+    {
+        // Cycle through the gravity modes, starting from a spinning disc.
+        if (particleSystem->m_gravityMode == GravityMode::None)
+        {
+            particleSystem->m_gravityMode = GravityMode::AllPairs;
+            particleSystem->ScatterParticles(2, 1);
+            std::cout << "Gravity: all pairs" << std::endl;
+        }
+        else if (particleSystem->m_gravityMode == GravityMode::AllPairs)
+        {
+            particleSystem->m_gravityMode = GravityMode::BarnesHut;
+            std::cout << "Gravity: Barnes-Hut" << std::endl;
+        }
+        else
+        {
+            particleSystem->m_gravityMode = GravityMode::None;
+            std::cout << "Gravity: off" << std::endl;
+        }
+    }
+    if (key == GLFW_KEY_U && action == GLFW_PRESS)
+    {
+        // Toggle the sparks sub-emitter.
+        sparksEnabled = !sparksEnabled;
+        particleSystem->SetSubEmitter(SubEmitterEvent::Death, sparksEnabled ? sparks : nullptr, 4);
+        if (!sparksEnabled)
+        {
+            sparks->KillAllParticles();
+        }
+    }
+    if (key == GLFW_KEY_M && action == GLFW_PRESS)
+    {
+        // Toggle emitting from the surface of a torus.
+        static bool meshEmitter = false;
+        meshEmitter = !meshEmitter;
+        if (meshEmitter)
+        {
+            std::vector<glm::vec3> vertices;
+            std::vector<unsigned int> indices;
+            makeTorus(1, .3f, 48, 16, vertices, indices);
+            particleSystem->SetEmitterMesh(vertices, indices);
+        }
+        else
+        {
+            particleSystem->ClearEmitterMesh();
+        }
+    }
+    if (key == GLFW_KEY_V && action == GLFW_PRESS)
+    {
+        // Toggle a few force fields around the emitter.
+        if (particleSystem->GetForceFieldCount() == 0)
+        {
+            glm::vec3 center = particleSystem->m_position;
+            particleSystem->AddForceField(ForceField::Vortex(center, glm::vec3(0, 1, 0), 8, 1.5f, 2));
+            particleSystem->AddForceField(ForceField::Attractor(center + glm::vec3(1, .5f, 0), 6, 1));
+            particleSystem->AddForceField(ForceField::Attractor(center + glm::vec3(-1, -.5f, 0), 6, 1));
+            particleSystem->AddForceField(ForceField::DragBox(center + glm::vec3(0, 0, 1), glm::vec3(.5f), 10));
+        }
+        else
+        {
+            particleSystem->ClearForceFields();
+        }
+    }
+    if (key == GLFW_KEY_B && action == GLFW_PRESS)
+    {
+        // Toggle the wind grid.
+        windEnabled = !windEnabled;
+        particleSystem->SetWindGrid(windEnabled ? wind : nullptr);
+    }
+    if (key == GLFW_KEY_C && action == GLFW_PRESS)
+    {
+        // Toggle the collision module, with a floor a little below the emitter.
+        ParticleModules modules = particleSystem->GetModules();
+        modules.m_collision = !modules.m_collision;
+        modules.m_collisionPlane = glm::vec4(0, 1, 0, 1);
+        modules.m_restitution = .6f;
+        particleSystem->SetModules(modules);
+    }
+    if (key == GLFW_KEY_K && action == GLFW_PRESS)
+    {
+        // Toggle the rippling collision mesh.
+        groundEnabled = !groundEnabled;
+        particleSystem->SetCollisionMesh(groundEnabled ? ground : nullptr);
+    }
+    if (key == GLFW_KEY_P && action == GLFW_PRESS)
+    {
+        // Switch between expanding quads in the geometry shader and pulling them in the vertex shader.
+        bool pulling = particleSystem->GetRenderPath() == ParticleRenderPath::VertexPulling;
+        ParticleRenderPath renderPath = pulling ? ParticleRenderPath::GeometryShader : ParticleRenderPath::VertexPulling;
+        particleSystem->SetRenderPath(renderPath);
+        sparks->SetRenderPath(renderPath);
+        std::cout << (pulling ? "Quads: geometry shader" : "Quads: vertex pulling") << std::endl;
+    }
 }
 
 int main(int argc, char **argv)
 {
+    // Turn a text effect file into a binary one for shipping, instead of running the demo.
+    if (argc > 3 && std::string(argv[1]) == "--compile-effect")
+    {
+        std::vector<EffectDefinition> effects;
+        bool compiled = ReadEffectFile(argv[2], effects) && WriteBinaryEffectFile(argv[3], effects);
+        return compiled ? 0 : 1;
+    }
+
 	// Initializes the GLFW library
 	glfwInit();
 
@@ -90,20 +289,70 @@ int main(int argc, char **argv)
 	// Initializes the glew library
 	glewInit();
 
+    // Run the benchmarks instead of the demo if asked to.
+    if (argc > 1 && std::string(argv[1]) == "--benchmark")
+    {
+        // Hold a reference for the whole run. Each benchmark only holds one while it runs, and would delete the texture on its way out.
+        Texture* benchmarkTexture = new Texture((char*)"../assets/particle.png");
+        benchmarkTexture->IncRefCount();
+        RunBenchmarks(benchmarkTexture);
+        benchmarkTexture->DecRefCount();
+        ClearParticleProgramCache();
+        glfwTerminate();
+        return 0;
+    }
+
+
+    // The particle systems and their parameters are described in an effect file.
+    effect = new Effect("../assets/demo.effect");
+    particleSystem = effect->GetSystem("main");
+    sparks = effect->GetSystem("sparks");
+    if (particleSystem == nullptr || sparks == nullptr)
+    {
+        std::cout << "demo.effect needs a main and a sparks effect." << std::endl;
+        delete effect;
+        glfwTerminate();
+        return 1;
+    }
+
+    // A 64x64x64 grid of air in a 6 unit box around the emitter.
+    wind = new WindGrid(particleSystem->m_position - glm::vec3(3), particleSystem->m_position + glm::vec3(3));
 
+    // 80x80 cells of ripples, 12800 triangles, a little below the emitter.
+    std::vector<glm::vec3> groundVertices;
+    std::vector<unsigned int> groundIndices;
+    glm::vec3 groundCenter = particleSystem->m_position - glm::vec3(0, 1.5f, 0);
+    makeRipples(groundCenter, 8, 80, 0, groundVertices, groundIndices);
+    ground = new CollisionMesh(groundVertices, groundIndices);
 
-    // Initialize the particle system class with a bunch of parameters:
-    particleSystem = new ParticleSystem(new Texture((char*)"../assets/particle.png"));
-    particleSystem->m_position = glm::vec3(0, 0, -.5);
-    particleSystem->m_lifeTime = 1.0f;
-    particleSystem->m_acceleration = glm::vec3(0, 0, 0);
-    particleSystem->m_particleSize = glm::vec2(100, 100);
+    // Count deaths and bounces for the window title, the way gameplay or audio would listen for them.
+    particleSystem->EnableEvents(4096);
+    std::vector<ParticleEvent> events;
+    int deathCount = 0;
+    int bounceCount = 0;
 
+    // Ask the GPU how crowded it is around the emitter, and which particle is in the middle of the screen.
+    std::vector<ParticleQueryResult> queryResults;
+    int nearEmitter = 0;
+    int lookingAt = -1;
+
+    // Aim to keep the particles under 60fps worth of GPU time.
+    quality = new QualityScaler(16.6f);
+    quality->Add(particleSystem);
+    quality->Add(sparks);
 
     std::cout << "Controls:" << std::endl;
     std::cout << "Use the mouse to look around, and wasd to move." << std::endl;
     std::cout << "R and F control acceleration." << std::endl;
     std::cout << "T and G control particle size." << std::endl;
+    std::cout << "N cycles through n-body gravity modes." << std::endl;
+    std::cout << "V toggles force fields." << std::endl;
+    std::cout << "U toggles sparks when particles die." << std::endl;
+    std::cout << "M toggles emitting from a mesh." << std::endl;
+    std::cout << "C toggles a floor for particles to bounce off." << std::endl;
+    std::cout << "B toggles wind." << std::endl;
+    std::cout << "K toggles rippling ground for particles to bounce off." << std::endl;
+    std::cout << "P toggles drawing quads without the geometry shader." << std::endl;
     std::cout << "Press escape to exit the demo." << std::endl;
 
     // Make a first person controller for the camera.
@@ -126,10 +375,14 @@ int main(int argc, char **argv)
         secCounter += dt;
         if (secCounter > 1.f)
         {
-            std::string title = "FPS: " + std::to_string(frames);
+            std::string title = "FPS: " + std::to_string(frames) + ", deaths/s: " + std::to_string(deathCount) + ", bounces/s: " + std::to_string(bounceCount)
+                + ", near emitter: " + std::to_string(nearEmitter) + ", looking at: " + std::to_string(lookingAt)
+                + ", quality: " + std::to_string(quality->GetLevel());
             glfwSetWindowTitle(window, title.c_str());
             secCounter = 0;
             frames = 0;
+            deathCount = 0;
+            bounceCount = 0;
         }
         glfwSetTime(0);
 
@@ -140,30 +393,116 @@ int main(int argc, char **argv)
         // Update the player controller.
         controller.Update(window, viewportDimensions, mousePosition, dt);
 
+        // Calculate view-projection matrix.
+        glm::mat4 viewMatrix = controller.GetTransform().GetInverseMatrix();
+        glm::mat4 perspectiveProjection = glm::perspective(.75f, viewportDimensions.x / viewportDimensions.y, .1f, 100.f);
+        glm::mat4 viewProjection = perspectiveProjection * viewMatrix;
+
+        // Systems behind the camera barely update, and far away ones keep fewer particles.
+        particleSystem->SetView(viewProjection, viewportDimensions);
+        sparks->SetView(viewProjection, viewportDimensions);
+
+        // Blow a gust of air around in a circle, the grid takes care of making it swirl.
+        if (windEnabled)
+        {
+            glm::vec3 center = particleSystem->m_position;
+            glm::vec3 fan = glm::vec3(cos(totalTime), 0, sin(totalTime)) * 1.5f;
+            wind->AddImpulse(center + fan, glm::vec3(-fan.z, 1, fan.x) * 20.f, 1);
+            wind->Update(dt);
+        }
+
+        // Move the ripples along. Only the boxes are refit, the tree over the triangles stays the same.
+        if (groundEnabled)
+        {
+            makeRipples(groundCenter, 8, 80, totalTime, groundVertices, groundIndices);
+            ground->UpdateVertices(groundVertices);
+        }
+
+        // Queries run at the end of the next Update.
+        particleSystem->QueryCountInSphere(particleSystem->m_position, .5f);
+        Transform3D camera = controller.GetTransform();
+        particleSystem->QueryNearestToRay(camera.Position(), camera.GetForward(), 20.f);
+
         // Update the particle simulation
         // This is what runs the compute shader.
+        // Sparks are updated by particleSystem, so they are timed along with it.
+        quality->BeginUpdate();
         particleSystem->Update(dt);
+        quality->EndUpdate();
+
+        // Answers to queries from a frame or two ago. Like events, this never waits for the GPU.
+        queryResults.clear();
+        particleSystem->ReadQueryResults(queryResults);
+        for (const ParticleQueryResult& result : queryResults)
+        {
+            if (result.m_type == ParticleQueryType::CountInSphere)
+            {
+                nearEmitter = result.m_count;
+            }
+            else
+            {
+                lookingAt = result.m_particle;
+            }
+        }
+
+        // Events from a frame or two ago. This never waits for the GPU.
+        events.clear();
+        particleSystem->ReadEvents(events);
+        for (const ParticleEvent& event : events)
+        {
+            if (event.m_type == (GLuint)ParticleEventType::Death)
+            {
+                deathCount++;
+            }
+            else
+            {
+                bounceCount++;
+            }
+        }
 
         /////////////////
         // Draw       //
         ///////////////
 
-        // Calculate view-projection matrix.
-        glm::mat4 viewMatrix = controller.GetTransform().GetInverseMatrix();
-        glm::mat4 perspectiveProjection = glm::perspective(.75f, viewportDimensions.x / viewportDimensions.y, .1f, 100.f);
-        glm::mat4 viewProjection = perspectiveProjection * viewMatrix;
-        
         // The view projection matrix will be used in the vertex shader to move the particle.
         particleSystem->GetMaterial()->SetMatrix((char*)"cameraView", viewProjection);
+        sparks->GetMaterial()->SetMatrix((char*)"cameraView", viewProjection);
         // The viewport dimensions are needed in the geometry shader to make a correctly sized quad.
+        // Quads are sized relative to the viewport, so they stay the same size on a smaller target.
         particleSystem->GetMaterial()->SetVec2((char*)"viewport", viewportDimensions);
+        sparks->GetMaterial()->SetVec2((char*)"viewport", viewportDimensions);
+        glm::vec2 particleViewport = glm::floor(viewportDimensions * quality->GetRenderScale());
+        bool scaled = particleViewport != viewportDimensions;
+        if (scaled)
+        {
+            resizeParticleTarget(glm::ivec2(particleViewport));
+            glBindFramebuffer(GL_FRAMEBUFFER, particleFramebuffer);
+            glViewport(0, 0, (GLsizei)particleViewport.x, (GLsizei)particleViewport.y);
+        }
 
 		// Clear the screen.
 		glClear(GL_COLOR_BUFFER_BIT);
 		glClearColor(0.0, 0.0, 0.0, 0.0);
 
         // Tell Particle System to draw.
+        quality->BeginDraw();
         particleSystem->Draw();
+        sparks->Draw();
+        quality->EndDraw();
+
+        // Stretch the smaller target over the window.
+        if (scaled)
+        {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, particleFramebuffer);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glViewport(0, 0, (GLsizei)viewportDimensions.x, (GLsizei)viewportDimensions.y);
+            glBlitFramebuffer(0, 0, (GLint)particleViewport.x, (GLint)particleViewport.y,
+                0, 0, (GLint)viewportDimensions.x, (GLint)viewportDimensions.y, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+
+        // Change quality for the coming frames, from timings of frames the GPU has finished.
+        quality->Update();
 
 
 		// Swap the backbuffer to the front.
@@ -175,7 +514,13 @@ int main(int argc, char **argv)
 	}
 
 
-    delete particleSystem;
+    delete quality;
+    delete effect;
+    delete wind;
+    delete ground;
+    ClearParticleProgramCache();
+    glDeleteFramebuffers(1, &particleFramebuffer);
+    glDeleteTextures(1, &particleColorTexture);
 
 	// Free GLFW memory.
 	glfwTerminate();
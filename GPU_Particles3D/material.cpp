@@ -276,7 +276,7 @@ void Material::Bind()
         glActiveTexture(GL_TEXTURE0 + i);
 
         // Bind the texture
-        glBindTexture(GL_TEXTURE_2D, m_textures[i]->GetGLTexture());
+        glBindTexture(m_textures[i]->GetTarget(), m_textures[i]->GetGLTexture());
 
         // Use the the texture from GL_TEXTURE0 + i at the given texture uniform location.
         glUniform1i(m_textureUniforms[i], i);
@@ -321,7 +321,7 @@ void Material::Unbind()
     for (int i = 0; i < m_textureUniforms.size(); i++)
     {
         glActiveTexture(GL_TEXTURE0 + i);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindTexture(m_textures[i]->GetTarget(), 0);
     }
 
     m_shaderProgram->Unbind();
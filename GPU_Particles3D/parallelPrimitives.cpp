@@ -0,0 +1,428 @@
+/*
+Title: GPU Simulated Particle System
+File Name: parallelPrimitives.cpp
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "parallelPrimitives.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+Material* CreateComputeMaterial(const std::string& filePath)
+{
+    ShaderProgram* program = new ShaderProgram();
+    program->AttachShader(new Shader(filePath, GL_COMPUTE_SHADER));
+    return new Material(program);
+}
+
+GLuint CreateStorageBuffer(GLsizeiptr size, const void* data)
+{
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return buffer;
+}
+
+// Number of work groups needed for count items, when each work group handles groupSize of them.
+static int WorkGroups(int count, int groupSize)
+{
+    return (count + groupSize - 1) / groupSize;
+}
+
+ParallelPrimitives::ParallelPrimitives()
+{
+    m_scanMat = CreateComputeMaterial("../Assets/scan.glsl");
+    m_compactMat = CreateComputeMaterial("../Assets/compact.glsl");
+    m_sortMat = CreateComputeMaterial("../Assets/radixSort.glsl");
+    m_reduceMat = CreateComputeMaterial("../Assets/reduce.glsl");
+}
+
+ParallelPrimitives::~ParallelPrimitives()
+{
+    std::vector<ScratchBuffer*> scratchBuffers = { &m_compactOffsets, &m_sortKeys, &m_sortValues, &m_sortCounts, &m_sortOffsets, &m_reduceValues[0], &m_reduceValues[1] };
+    for (ScratchBuffer& scratch : m_scanSums)
+    {
+        scratchBuffers.push_back(&scratch);
+    }
+    for (ScratchBuffer* scratch : scratchBuffers)
+    {
+        if (scratch->m_buffer != 0)
+        {
+            glDeleteBuffers(1, &scratch->m_buffer);
+        }
+    }
+
+    delete m_scanMat;
+    delete m_compactMat;
+    delete m_sortMat;
+    delete m_reduceMat;
+}
+
+GLuint ParallelPrimitives::Reserve(ScratchBuffer& scratch, GLsizeiptr size)
+{
+    if (scratch.m_size < size)
+    {
+        if (scratch.m_buffer != 0)
+        {
+            glDeleteBuffers(1, &scratch.m_buffer);
+        }
+        scratch.m_buffer = CreateStorageBuffer(size);
+        scratch.m_size = size;
+    }
+    return scratch.m_buffer;
+}
+
+void ParallelPrimitives::ScanLevel(GLuint input, GLuint output, int count, int level)
+{
+    int blocks = WorkGroups(count, BLOCK_SIZE);
+    if (level >= (int)m_scanSums.size())
+    {
+        m_scanSums.resize(level + 1);
+    }
+    GLuint sums = Reserve(m_scanSums[level], blocks * sizeof(GLuint));
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, input);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, output);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, sums);
+    m_scanMat->SetInt((char*)"count", count);
+    m_scanMat->SetInt((char*)"mode", 0);
+    m_scanMat->Bind();
+    glDispatchCompute(blocks, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // A single block is already done. Otherwise scan the block totals in place,
+    // and add them back onto the blocks they came from.
+    if (blocks > 1)
+    {
+        ScanLevel(sums, sums, blocks, level + 1);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, output);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, sums);
+        m_scanMat->SetInt((char*)"count", count);
+        m_scanMat->SetInt((char*)"mode", 1);
+        m_scanMat->Bind();
+        glDispatchCompute(blocks, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+    m_scanMat->Unbind();
+}
+
+void ParallelPrimitives::ExclusiveScan(GLuint input, GLuint output, int count)
+{
+    if (count > 0)
+    {
+        ScanLevel(input, output, count, 0);
+    }
+}
+
+void ParallelPrimitives::Compact(GLuint input, GLuint flags, GLuint output, GLuint countBuffer, int count)
+{
+    if (count <= 0)
+    {
+        // Nothing is kept, but the count should still be right.
+        GLuint zero = 0;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &zero);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        return;
+    }
+
+    GLuint offsets = Reserve(m_compactOffsets, count * sizeof(GLuint));
+    ExclusiveScan(flags, offsets, count);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, input);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, flags);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, offsets);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, output);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, countBuffer);
+    m_compactMat->SetInt((char*)"count", count);
+    m_compactMat->Bind();
+    glDispatchCompute(WorkGroups(count, WORK_GROUP_SIZE), 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    m_compactMat->Unbind();
+}
+
+void ParallelPrimitives::Sort(GLuint keyBuffer, GLuint valueBuffer, int count, int keyBits)
+{
+    if (count <= 1)
+    {
+        return;
+    }
+
+    int blocks = WorkGroups(count, WORK_GROUP_SIZE);
+    GLuint keys[2] = { keyBuffer, Reserve(m_sortKeys, count * sizeof(GLuint)) };
+    GLuint values[2] = { valueBuffer, Reserve(m_sortValues, count * sizeof(GLuint)) };
+    GLuint counts = Reserve(m_sortCounts, blocks * RADIX_SIZE * sizeof(GLuint));
+    GLuint offsets = Reserve(m_sortOffsets, blocks * RADIX_SIZE * sizeof(GLuint));
+
+    // Each pass goes from one pair of buffers to the other, sorting by the next digit up.
+    // Every pass is stable, so the order from the digits below is kept wherever this digit is the same.
+    int passes = (keyBits + RADIX_BITS - 1) / RADIX_BITS;
+    for (int pass = 0; pass < passes; pass++)
+    {
+        int from = pass % 2;
+        int to = 1 - from;
+
+        // Sort each block locally and count its digits.
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keys[from]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, values[from]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, counts);
+        m_sortMat->SetInt((char*)"count", count);
+        m_sortMat->SetInt((char*)"blockCount", blocks);
+        m_sortMat->SetInt((char*)"shift", pass * RADIX_BITS);
+        m_sortMat->SetInt((char*)"mode", 0);
+        m_sortMat->Bind();
+        glDispatchCompute(blocks, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        // Find where every block's run of every digit starts.
+        ExclusiveScan(counts, offsets, blocks * RADIX_SIZE);
+
+        // Move everything into place.
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keys[from]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, values[from]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, keys[to]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, values[to]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, offsets);
+        m_sortMat->SetInt((char*)"mode", 1);
+        m_sortMat->Bind();
+        glDispatchCompute(blocks, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+    m_sortMat->Unbind();
+
+    // After an odd number of passes the result is in the scratch buffers.
+    if (passes % 2 == 1)
+    {
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        for (int i = 0; i < 2; i++)
+        {
+            GLuint source = i == 0 ? keys[1] : values[1];
+            GLuint destination = i == 0 ? keyBuffer : valueBuffer;
+            glBindBuffer(GL_COPY_READ_BUFFER, source);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, destination);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, count * sizeof(GLuint));
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+}
+
+void ParallelPrimitives::Reduce(GLuint input, GLuint output, int count, ReduceOperation operation)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+
+    m_reduceMat->SetInt((char*)"operation", (int)operation);
+
+    // Every pass turns each block into one value, until a single block is left to go straight to the output.
+    int level = 0;
+    while (true)
+    {
+        int blocks = WorkGroups(count, BLOCK_SIZE);
+        GLuint destination = blocks == 1 ? output : Reserve(m_reduceValues[level % 2], blocks * sizeof(float));
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, input);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, destination);
+        m_reduceMat->SetInt((char*)"count", count);
+        m_reduceMat->Bind();
+        glDispatchCompute(blocks, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        if (blocks == 1)
+        {
+            break;
+        }
+        input = destination;
+        count = blocks;
+        level++;
+    }
+    m_reduceMat->Unbind();
+}
+
+// Copies the start of a GPU buffer into a vector.
+template <typename T>
+static std::vector<T> ReadBuffer(GLuint buffer, int count)
+{
+    std::vector<T> data(count);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(T), data.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return data;
+}
+
+// CPU references for each primitive, written as plainly as possible.
+
+static std::vector<GLuint> ExclusiveScanReference(const std::vector<GLuint>& input)
+{
+    std::vector<GLuint> output(input.size());
+    GLuint sum = 0;
+    for (size_t i = 0; i < input.size(); i++)
+    {
+        output[i] = sum;
+        sum += input[i];
+    }
+    return output;
+}
+
+static std::vector<GLuint> CompactReference(const std::vector<GLuint>& input, const std::vector<GLuint>& flags)
+{
+    std::vector<GLuint> output;
+    for (size_t i = 0; i < input.size(); i++)
+    {
+        if (flags[i] != 0)
+        {
+            output.push_back(input[i]);
+        }
+    }
+    return output;
+}
+
+static void SortReference(std::vector<GLuint>& keys, std::vector<GLuint>& values, int keyBits)
+{
+    GLuint mask = keyBits >= 32 ? 0xFFFFFFFF : (1u << keyBits) - 1;
+    std::vector<int> order(keys.size());
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        order[i] = (int)i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return (keys[a] & mask) < (keys[b] & mask); });
+
+    std::vector<GLuint> sortedKeys(keys.size());
+    std::vector<GLuint> sortedValues(values.size());
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        sortedKeys[i] = keys[order[i]];
+        sortedValues[i] = values[order[i]];
+    }
+    keys.swap(sortedKeys);
+    values.swap(sortedValues);
+}
+
+static double ReduceReference(const std::vector<float>& input, ReduceOperation operation)
+{
+    double result = operation == ReduceOperation::Sum ? 0 : input[0];
+    for (float value : input)
+    {
+        switch (operation)
+        {
+        case ReduceOperation::Sum: result += value; break;
+        case ReduceOperation::Min: result = std::min(result, (double)value); break;
+        case ReduceOperation::Max: result = std::max(result, (double)value); break;
+        }
+    }
+    return result;
+}
+
+// A random uint using every bit. rand() may only give 15 bits at a time.
+static GLuint RandomKey()
+{
+    return ((GLuint)rand() << 30) ^ ((GLuint)rand() << 15) ^ (GLuint)rand();
+}
+
+bool ParallelPrimitives::Validate(int count)
+{
+    bool valid = true;
+
+    std::vector<GLuint> numbers(count);
+    std::vector<GLuint> flags(count);
+    std::vector<GLuint> keys(count);
+    std::vector<GLuint> values(count);
+    std::vector<float> floats(count);
+    for (int i = 0; i < count; i++)
+    {
+        numbers[i] = rand() % 16;
+        flags[i] = rand() % 2;
+        keys[i] = RandomKey();
+        values[i] = i;
+        floats[i] = (float)rand() / RAND_MAX * 2 - 1;
+    }
+
+    GLuint numberBuffer = CreateStorageBuffer(count * sizeof(GLuint), numbers.data());
+    GLuint flagBuffer = CreateStorageBuffer(count * sizeof(GLuint), flags.data());
+    GLuint resultBuffer = CreateStorageBuffer(count * sizeof(GLuint));
+    GLuint countBuffer = CreateStorageBuffer(sizeof(GLuint));
+    GLuint floatBuffer = CreateStorageBuffer(count * sizeof(float), floats.data());
+
+    // 1. Scan.
+    ExclusiveScan(numberBuffer, resultBuffer, count);
+    if (ReadBuffer<GLuint>(resultBuffer, count) != ExclusiveScanReference(numbers))
+    {
+        std::cout << "Parallel primitives: exclusive scan doesn't match." << std::endl;
+        valid = false;
+    }
+
+    // 2. Compaction, keeping about half.
+    Compact(numberBuffer, flagBuffer, resultBuffer, countBuffer, count);
+    std::vector<GLuint> kept = CompactReference(numbers, flags);
+    if (ReadBuffer<GLuint>(countBuffer, 1)[0] != kept.size() || ReadBuffer<GLuint>(resultBuffer, (int)kept.size()) != kept)
+    {
+        std::cout << "Parallel primitives: compaction doesn't match." << std::endl;
+        valid = false;
+    }
+
+    // 3. Sorting whole keys, then only the low 8 bits, where there are lots of ties that have to stay in order.
+    // 12 bits takes an odd number of passes, which ends in the scratch buffers and has to be copied back.
+    int keyBitCounts[] = { 32, 12, 8 };
+    for (int keyBits : keyBitCounts)
+    {
+        GLuint keyBuffer = CreateStorageBuffer(count * sizeof(GLuint), keys.data());
+        GLuint valueBuffer = CreateStorageBuffer(count * sizeof(GLuint), values.data());
+        Sort(keyBuffer, valueBuffer, count, keyBits);
+
+        std::vector<GLuint> sortedKeys = keys;
+        std::vector<GLuint> sortedValues = values;
+        SortReference(sortedKeys, sortedValues, keyBits);
+        if (ReadBuffer<GLuint>(keyBuffer, count) != sortedKeys || ReadBuffer<GLuint>(valueBuffer, count) != sortedValues)
+        {
+            std::cout << "Parallel primitives: radix sort by " << keyBits << " bits doesn't match." << std::endl;
+            valid = false;
+        }
+
+        GLuint buffers[] = { keyBuffer, valueBuffer };
+        glDeleteBuffers(2, buffers);
+    }
+
+    // 4. Reduction. Min and max are exact, the sum is added up in a different order, so it is only close.
+    ReduceOperation operations[] = { ReduceOperation::Sum, ReduceOperation::Min, ReduceOperation::Max };
+    for (ReduceOperation operation : operations)
+    {
+        Reduce(floatBuffer, resultBuffer, count, operation);
+        double gpu = ReadBuffer<float>(resultBuffer, 1)[0];
+        double cpu = ReduceReference(floats, operation);
+        double tolerance = operation == ReduceOperation::Sum ? 1e-5 * count : 0;
+        if (std::abs(gpu - cpu) > tolerance)
+        {
+            std::cout << "Parallel primitives: reduction " << (int)operation << " gave " << gpu << ", expected " << cpu << "." << std::endl;
+            valid = false;
+        }
+    }
+
+    GLuint buffers[] = { numberBuffer, flagBuffer, resultBuffer, countBuffer, floatBuffer };
+    glDeleteBuffers(5, buffers);
+
+    if (valid)
+    {
+        std::cout << "Parallel primitives: scan, compaction, sort and reduction of " << count << " elements match the CPU." << std::endl;
+    }
+    return valid;
+}
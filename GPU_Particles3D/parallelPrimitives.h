@@ -0,0 +1,113 @@
+/*
+Title: GPU Simulated Particle System
+File Name: parallelPrimitives.h
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <vector>
+#include "GL/glew.h"
+#include "GLFW/glfw3.h"
+#include <string>
+#include "material.h"
+
+// Makes a buffer that is only used by shaders, optionally filled with data.
+GLuint CreateStorageBuffer(GLsizeiptr size, const void* data = nullptr);
+
+// Makes a material for a compute shader that needs no #defines.
+Material* CreateComputeMaterial(const std::string& filePath);
+
+// How Reduce combines elements.
+enum class ReduceOperation
+{
+    Sum,
+    Min,
+    Max
+};
+
+// Building blocks for GPU algorithms that work on whole storage buffers: exclusive scan, stream compaction,
+// key-value radix sort and reduction (see scan.glsl, compact.glsl, radixSort.glsl and reduce.glsl).
+// Scratch buffers are made the first time they are needed and grow to fit, so the first call at a new size is slower.
+// Every call leaves storage buffer bindings 0 to 5 changed.
+class ParallelPrimitives
+{
+public:
+    // Must match WORK_GROUP_SIZE in the shaders.
+    static const int WORK_GROUP_SIZE = 256;
+
+    // Scan and reduce handle two elements per invocation.
+    static const int BLOCK_SIZE = WORK_GROUP_SIZE * 2;
+
+    // Bits of the key each radix sort pass sorts by. Must match RADIX_BITS in radixSort.glsl
+    static const int RADIX_BITS = 4;
+    static const int RADIX_SIZE = 1 << RADIX_BITS;
+
+    ParallelPrimitives();
+    ~ParallelPrimitives();
+
+    // Writes the sum of every uint before each element of input to output. Input and output can be the same buffer.
+    void ExclusiveScan(GLuint input, GLuint output, int count);
+
+    // Copies the elements of input whose flag is 1 to the start of output, in order. Flags have to be 0 or 1.
+    // The number kept is written as a uint to the start of countBuffer, so it never has to come back to the CPU.
+    void Compact(GLuint input, GLuint flags, GLuint output, GLuint countBuffer, int count);
+
+    // Sorts uint keys in place, moving a uint value along with each key. Keys that are equal keep their order.
+    // Only the lowest keyBits bits of the keys are sorted by, so keys that use fewer bits take fewer passes.
+    // Unlike BitonicSort, count doesn't need padding.
+    void Sort(GLuint keyBuffer, GLuint valueBuffer, int count, int keyBits = 32);
+
+    // Combines count floats from input into one, written to the start of output.
+    void Reduce(GLuint input, GLuint output, int count, ReduceOperation operation);
+
+    // Runs every primitive on count random elements, and compares the results with the same thing done on the CPU.
+    // This reads everything back from the GPU, so it is slow. Prints what it finds and returns true if everything matches.
+    bool Validate(int count);
+
+private:
+    // A buffer that only shaders use, grown when something needs more room than it has.
+    struct ScratchBuffer
+    {
+        GLuint m_buffer = 0;
+        GLsizeiptr m_size = 0;
+    };
+
+    static GLuint Reserve(ScratchBuffer& scratch, GLsizeiptr size);
+
+    // Scans count elements. Block totals go in level's scratch buffer, and are scanned by the next level.
+    void ScanLevel(GLuint input, GLuint output, int count, int level);
+
+    Material* m_scanMat;
+    Material* m_compactMat;
+    Material* m_sortMat;
+    Material* m_reduceMat;
+
+    // Block totals for each level of a scan.
+    std::vector<ScratchBuffer> m_scanSums;
+
+    // Where each kept element goes during compaction.
+    ScratchBuffer m_compactOffsets;
+
+    // The other half of each sort pass, and the digit counts of each block, before and after scanning.
+    ScratchBuffer m_sortKeys;
+    ScratchBuffer m_sortValues;
+    ScratchBuffer m_sortCounts;
+    ScratchBuffer m_sortOffsets;
+
+    // Reduce passes go back and forth between these.
+    ScratchBuffer m_reduceValues[2];
+};
@@ -0,0 +1,305 @@
+/*
+Title: GPU Simulated Particle System
+File Name: particleBatch.cpp
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "particleBatch.h"
+#include "parallelPrimitives.h"
+#include <iostream>
+
+// Matches BatchSystem in compute.glsl
+struct BatchSystem
+{
+    glm::vec3 m_basePosition;
+    float m_burnRate;
+    glm::vec3 m_acceleration;
+    float m_dt;
+    GLuint m_firstParticle;
+    GLuint m_particleCount;
+    GLint m_particleLimit;
+    GLuint m_padding;
+};
+
+// Copies data into a buffer, making it bigger first if it doesn't fit.
+static void UploadTable(GLuint buffer, int& capacity, const void* data, int count, size_t elementSize)
+{
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    if (count > capacity)
+    {
+        capacity = count * 2;
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * elementSize, nullptr, GL_DYNAMIC_DRAW);
+    }
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * elementSize, data);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+ParticleBatch::ParticleBatch(int capacity)
+{
+    m_capacity = capacity;
+    m_particleBuffer = CreateStorageBuffer(m_capacity * sizeof(Particle));
+    glGenBuffers(1, &m_systemBuffer);
+    glGenBuffers(1, &m_groupBuffer);
+}
+
+ParticleBatch::~ParticleBatch()
+{
+    while (!m_entries.empty())
+    {
+        Remove(m_entries.back().m_system);
+    }
+    glDeleteBuffers(1, &m_particleBuffer);
+    glDeleteBuffers(1, &m_systemBuffer);
+    glDeleteBuffers(1, &m_groupBuffer);
+    delete m_simulateMat;
+}
+
+bool ParticleBatch::Add(ParticleSystem* system)
+{
+    if (system->m_batch == this)
+    {
+        return true;
+    }
+    if (system->m_batch != nullptr || !system->CanBatch())
+    {
+        std::cout << "Particle batch: this system uses something that can't be batched." << std::endl;
+        return false;
+    }
+
+    // Everything in the batch runs the same program.
+    system->BuildMaterials();
+    std::string defines = system->GetSimulationDefines(true);
+    if (m_entries.empty())
+    {
+        if (defines != m_defines)
+        {
+            m_defines = defines;
+            delete m_simulateMat;
+            m_simulateMat = new Material(GetParticleSimulationProgram(m_defines + "#define MODULE_BATCH\n"));
+            m_simulateMat->Bind();
+            m_simulateMat->Unbind();
+        }
+    }
+    else if (defines != m_defines)
+    {
+        std::cout << "Particle batch: this system has different modules than the rest of the batch." << std::endl;
+        return false;
+    }
+
+    // Slices are whole work groups, so no work group is shared by two systems.
+    int maxParticles = system->GetMaxParticles();
+    int size = (maxParticles + ParticleSystem::WORK_GROUP_SIZE - 1) / ParticleSystem::WORK_GROUP_SIZE * ParticleSystem::WORK_GROUP_SIZE;
+    int first = Allocate(size);
+
+    // Move the particles over, and let go of the system's own buffer.
+    glBindBuffer(GL_COPY_READ_BUFFER, system->m_vertexBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_particleBuffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, system->m_vertexOffset, first * sizeof(Particle), maxParticles * sizeof(Particle));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &system->m_vertexBuffer);
+    system->m_vertexBuffer = m_particleBuffer;
+    system->m_vertexOffset = first * sizeof(Particle);
+    system->m_batch = this;
+
+    // Keep the slices in order, so gaps are easy to find.
+    Entry entry;
+    entry.m_system = system;
+    entry.m_first = first;
+    entry.m_size = size;
+    int index = 0;
+    while (index < (int)m_entries.size() && m_entries[index].m_first < first)
+    {
+        index++;
+    }
+    m_entries.insert(m_entries.begin() + index, entry);
+    return true;
+}
+
+void ParticleBatch::Remove(ParticleSystem* system)
+{
+    int index = -1;
+    for (int i = 0; i < (int)m_entries.size(); i++)
+    {
+        if (m_entries[i].m_system == system)
+        {
+            index = i;
+        }
+    }
+    if (index < 0)
+    {
+        return;
+    }
+
+    // Give the system a buffer of its own again, with the particles as they are now.
+    int maxParticles = system->GetMaxParticles();
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, maxParticles * sizeof(Particle), nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, m_particleBuffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, system->m_vertexOffset, 0, maxParticles * sizeof(Particle));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    system->m_vertexBuffer = buffer;
+    system->m_vertexOffset = 0;
+    system->m_batch = nullptr;
+
+    m_entries.erase(m_entries.begin() + index);
+}
+
+int ParticleBatch::Allocate(int size)
+{
+    // First gap that is big enough.
+    int end = 0;
+    for (const Entry& entry : m_entries)
+    {
+        if (entry.m_first - end >= size)
+        {
+            return end;
+        }
+        end = entry.m_first + entry.m_size;
+    }
+    if (m_capacity - end >= size)
+    {
+        return end;
+    }
+
+    // Out of room, so make the buffer bigger. Every slice stays where it is, only the buffer changes.
+    int capacity = m_capacity * 2;
+    while (capacity - end < size)
+    {
+        capacity *= 2;
+    }
+    GLuint buffer = CreateStorageBuffer(capacity * sizeof(Particle));
+    glBindBuffer(GL_COPY_READ_BUFFER, m_particleBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, end * sizeof(Particle));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &m_particleBuffer);
+    m_particleBuffer = buffer;
+    m_capacity = capacity;
+    for (Entry& entry : m_entries)
+    {
+        entry.m_system->m_vertexBuffer = m_particleBuffer;
+    }
+    return end;
+}
+
+void ParticleBatch::Update(float dt)
+{
+    std::vector<BatchSystem> systems;
+    std::vector<glm::uvec2> groups;
+    std::vector<ParticleSystem*> updated;
+    std::vector<float> updatedDts;
+    systems.reserve(m_entries.size());
+    updated.reserve(m_entries.size());
+    updatedDts.reserve(m_entries.size());
+
+    for (int i = 0; i < (int)m_entries.size(); i++)
+    {
+        ParticleSystem* system = m_entries[i].m_system;
+
+        // Systems that changed into something the batch can't run go back to updating themselves.
+        bool stillFits = system->CanBatch();
+        if (stillFits && system->m_materialsDirty)
+        {
+            system->BuildMaterials();
+            stillFits = system->GetSimulationDefines(true) == m_defines;
+        }
+        if (!stillFits)
+        {
+            Remove(system);
+            i--;
+            system->Update(dt);
+            continue;
+        }
+
+        // Off screen systems can skip frames, in which case they get no work groups.
+        float systemDt = dt;
+        if (!system->StartUpdate(systemDt))
+        {
+            continue;
+        }
+
+        // The same values Update would set as uniforms.
+        BatchSystem entry;
+        entry.m_basePosition = system->m_position;
+        entry.m_burnRate = 1 / system->m_lifeTime;
+        entry.m_acceleration = system->m_acceleration;
+        entry.m_dt = systemDt;
+        entry.m_firstParticle = m_entries[i].m_first;
+        entry.m_particleCount = system->GetMaxParticles();
+        entry.m_particleLimit = (int)(system->m_particleLimit * system->m_lodFraction);
+        entry.m_padding = 0;
+
+        int workGroups = (system->GetMaxParticles() + ParticleSystem::WORK_GROUP_SIZE - 1) / ParticleSystem::WORK_GROUP_SIZE;
+        for (int group = 0; group < workGroups; group++)
+        {
+            groups.push_back(glm::uvec2(systems.size(), m_entries[i].m_first + group * ParticleSystem::WORK_GROUP_SIZE));
+        }
+        systems.push_back(entry);
+        updated.push_back(system);
+        updatedDts.push_back(systemDt);
+    }
+
+    if (!groups.empty())
+    {
+        UploadTable(m_systemBuffer, m_systemBufferCapacity, systems.data(), (int)systems.size(), sizeof(BatchSystem));
+        UploadTable(m_groupBuffer, m_groupBufferCapacity, groups.data(), (int)groups.size(), sizeof(glm::uvec2));
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_particleBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, m_systemBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, m_groupBuffer);
+
+        // Batched systems have no force fields, but the acceleration lives in the same module.
+        if (updated[0]->GetModules().m_forces)
+        {
+            m_simulateMat->SetInt((char*)"forceFieldCount", 0);
+        }
+
+        // One work group per WORK_GROUP_SIZE particles of every system, all at once.
+        m_simulateMat->Bind();
+        glDispatchCompute((GLuint)groups.size(), 1, 1);
+        m_simulateMat->Unbind();
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, 0);
+
+        // Make sure the compute shader is done writing before the buffer is read as vertices,
+        // or straight from the buffer when quads are pulled in the vertex shader or points are drawn from the visible list.
+        glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    // Bounds and queries are still per system.
+    for (int i = 0; i < (int)updated.size(); i++)
+    {
+        updated[i]->FinishUpdate(updatedDts[i]);
+    }
+}
+
+int ParticleBatch::GetSystemCount()
+{
+    return (int)m_entries.size();
+}
+
+int ParticleBatch::GetCapacity()
+{
+    return m_capacity;
+}
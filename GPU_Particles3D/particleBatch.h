@@ -0,0 +1,85 @@
+/*
+Title: GPU Simulated Particle System
+File Name: particleBatch.h
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <vector>
+#include <string>
+#include "GL/glew.h"
+#include "GLFW/glfw3.h"
+#include "glm/gtc/matrix_transform.hpp"
+#include "material.h"
+#include "particleSystem.h"
+
+// Updates many small particle systems with a single dispatch, instead of one (and a program bind, and a dozen
+// uniforms) per system, so scenes full of small effects cost about the same on the CPU as one big one.
+// Every system's particles are moved into one shared buffer, each slice starting on a work group boundary.
+// Parameters that were uniforms go into a table with one entry per system, and a second table says which
+// system each work group belongs to. Only systems that compile to the same simulation program can share a batch,
+// and only ones with nothing else to bind (see ParticleSystem::CanBatch). Make a batch per kind of effect.
+// Systems are still drawn, culled, queried and bounded one by one, as before.
+class ParticleBatch
+{
+public:
+    // Particles the shared buffer starts out with room for. It doubles whenever it runs out.
+    static const int DEFAULT_CAPACITY = 65536;
+
+    ParticleBatch(int capacity = DEFAULT_CAPACITY);
+    ~ParticleBatch();
+
+    // Moves the system's particles into the batch, after which its own Update does nothing, and the batch updates it.
+    // Returns false, and leaves the system alone, if it can't be batched or builds a different program than the batch.
+    bool Add(ParticleSystem* system);
+    // Moves the system's particles back into a buffer of its own, so it can be updated by itself again.
+    // Systems that stop being batchable, or whose modules change, are removed by Update on their own.
+    void Remove(ParticleSystem* system);
+
+    // Updates every system in the batch, and then their children, bounds and queries.
+    void Update(float dt);
+
+    int GetSystemCount();
+    // Particles the shared buffer has room for, including gaps between systems.
+    int GetCapacity();
+
+private:
+    struct Entry
+    {
+        ParticleSystem* m_system;
+        // Where the system's slice starts and how long it is, in particles. Slices are kept in order.
+        int m_first;
+        int m_size;
+    };
+
+    // Finds a gap with room for size particles, growing the buffer if there isn't one.
+    int Allocate(int size);
+
+    std::vector<Entry> m_entries;
+    int m_capacity;
+    GLuint m_particleBuffer;
+
+    // Defines of the first system added, every other system has to match them.
+    std::string m_defines;
+    Material* m_simulateMat = nullptr;
+
+    // One entry per system and one per work group, rebuilt every Update. Kept around so they aren't reallocated.
+    GLuint m_systemBuffer;
+    GLuint m_groupBuffer;
+    int m_systemBufferCapacity = 0;
+    int m_groupBufferCapacity = 0;
+};
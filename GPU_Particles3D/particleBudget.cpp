@@ -0,0 +1,235 @@
+/*
+Title: GPU Simulated Particle System
+File Name: particleBudget.cpp
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "particleBudget.h"
+#include "parallelPrimitives.h"
+#include <iostream>
+
+// Matches System in particleBudget.glsl
+struct BudgetSystem
+{
+    glm::vec3 m_position;
+    float m_priority;
+    GLuint m_requested;
+    GLuint m_padding[3];
+};
+
+// Memory a system's particle pool takes up.
+static size_t PoolMemory(ParticleSystem* system)
+{
+    return (size_t)system->GetMaxParticles() * sizeof(Particle);
+}
+
+ParticleBudget::ParticleBudget(int maxParticles, size_t maxMemory)
+{
+    m_maxParticles = maxParticles;
+    m_maxMemory = maxMemory;
+
+    ShaderProgram* program = new ShaderProgram();
+    program->AttachShader(new Shader("../Assets/particleBudget.glsl", GL_COMPUTE_SHADER));
+    m_budgetMat = new Material(program);
+
+    m_boundsBuffer = CreateStorageBuffer(MAX_SYSTEMS * sizeof(ParticleBounds));
+    m_systemBuffer = CreateStorageBuffer(MAX_SYSTEMS * sizeof(BudgetSystem));
+
+    // Until the first Update, nobody gets to spawn anything.
+    std::vector<GLuint> zeros(MAX_SYSTEMS, 0);
+    glGenBuffers(1, &m_quotaBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_quotaBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, MAX_SYSTEMS * sizeof(GLuint), zeros.data(), GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    m_quotaReadback = new GPUReadback(MAX_SYSTEMS * sizeof(GLuint));
+}
+
+ParticleBudget::~ParticleBudget()
+{
+    while (!m_entries.empty())
+    {
+        Remove(m_entries.back().m_system);
+    }
+    glDeleteBuffers(1, &m_boundsBuffer);
+    glDeleteBuffers(1, &m_systemBuffer);
+    glDeleteBuffers(1, &m_quotaBuffer);
+    delete m_quotaReadback;
+    delete m_budgetMat;
+}
+
+bool ParticleBudget::Add(ParticleSystem* system, float priority)
+{
+    if (FindSlot(system) >= 0)
+    {
+        SetPriority(system, priority);
+        return true;
+    }
+    if ((int)m_entries.size() >= MAX_SYSTEMS)
+    {
+        std::cout << "Particle budget is full, can't add more than " << MAX_SYSTEMS << " systems." << std::endl;
+        return false;
+    }
+    if (GetMemoryUsage() + PoolMemory(system) > m_maxMemory)
+    {
+        std::cout << "Particle budget: a system with " << system->GetMaxParticles() << " particles would go over the memory cap." << std::endl;
+        return false;
+    }
+
+    Entry entry;
+    entry.m_system = system;
+    entry.m_priority = priority;
+    entry.m_enabledBounds = system->GetBoundsBuffer() == 0;
+    system->EnableBounds();
+    system->SetBudget(m_quotaBuffer, (int)m_entries.size());
+    m_entries.push_back(entry);
+    m_quotas.push_back(-1);
+
+    // Copies already on their way back don't have the new slot in them.
+    m_firstValidCopy = m_quotaReadback->GetCopyCount();
+    return true;
+}
+
+void ParticleBudget::Remove(ParticleSystem* system)
+{
+    int slot = FindSlot(system);
+    if (slot < 0)
+    {
+        return;
+    }
+    system->SetBudget(0, 0);
+    if (m_entries[slot].m_enabledBounds)
+    {
+        system->DisableBounds();
+    }
+    m_entries.erase(m_entries.begin() + slot);
+    m_quotas.erase(m_quotas.begin() + slot);
+
+    // Everything after it moves down a slot. Their quotas were worked out for the old slots, so they
+    // have none until the next Update, rather than picking up a neighbour's.
+    for (int i = slot; i < (int)m_entries.size(); i++)
+    {
+        m_entries[i].m_system->SetBudget(m_quotaBuffer, i);
+        m_quotas[i] = -1;
+    }
+    m_firstValidCopy = m_quotaReadback->GetCopyCount();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_quotaBuffer);
+    glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, slot * sizeof(GLuint), (MAX_SYSTEMS - slot) * sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void ParticleBudget::SetPriority(ParticleSystem* system, float priority)
+{
+    int slot = FindSlot(system);
+    if (slot >= 0)
+    {
+        m_entries[slot].m_priority = priority;
+    }
+}
+
+void ParticleBudget::Update(glm::mat4 viewProjection, glm::vec3 cameraPosition)
+{
+    // Pick up the quotas that have come back since last frame.
+    const void* data;
+    int copyNumber;
+    while ((copyNumber = m_quotaReadback->Read(&data)) >= 0)
+    {
+        if (copyNumber < m_firstValidCopy)
+        {
+            continue;
+        }
+        const GLuint* quotas = (const GLuint*)data;
+        for (int i = 0; i < (int)m_quotas.size(); i++)
+        {
+            m_quotas[i] = (int)quotas[i];
+        }
+    }
+
+    int count = (int)m_entries.size();
+    if (count == 0)
+    {
+        return;
+    }
+
+    // Gather every system's box into one buffer. This is a copy on the GPU, so it doesn't wait for anything.
+    std::vector<BudgetSystem> systems(count);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_boundsBuffer);
+    for (int i = 0; i < count; i++)
+    {
+        ParticleSystem* system = m_entries[i].m_system;
+        glBindBuffer(GL_COPY_READ_BUFFER, system->GetBoundsBuffer());
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, i * sizeof(ParticleBounds), sizeof(ParticleBounds));
+
+        systems[i].m_position = system->m_position;
+        systems[i].m_priority = m_entries[i].m_priority;
+        systems[i].m_requested = system->GetMaxParticles();
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_systemBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(BudgetSystem), systems.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_boundsBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_systemBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_quotaBuffer);
+    m_budgetMat->SetInt((char*)"systemCount", count);
+    m_budgetMat->SetInt((char*)"particleCap", m_maxParticles);
+    m_budgetMat->SetVec3((char*)"cameraPosition", cameraPosition);
+    m_budgetMat->SetMatrix((char*)"viewProjection", viewProjection);
+    m_budgetMat->SetFloat((char*)"offscreenImportance", m_offscreenImportance);
+    m_budgetMat->Bind();
+    glDispatchCompute(1, 1, 1);
+    m_budgetMat->Unbind();
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, 0);
+
+    // The systems read their quotas in their next Update.
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    m_quotaReadback->Copy(m_quotaBuffer, 0, count * sizeof(GLuint));
+}
+
+int ParticleBudget::GetQuota(ParticleSystem* system)
+{
+    int slot = FindSlot(system);
+    return slot >= 0 ? m_quotas[slot] : -1;
+}
+
+size_t ParticleBudget::GetMemoryUsage()
+{
+    size_t total = 0;
+    for (const Entry& entry : m_entries)
+    {
+        total += PoolMemory(entry.m_system);
+    }
+    return total;
+}
+
+int ParticleBudget::FindSlot(ParticleSystem* system)
+{
+    for (int i = 0; i < (int)m_entries.size(); i++)
+    {
+        if (m_entries[i].m_system == system)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,98 @@
+/*
+Title: GPU Simulated Particle System
+File Name: particleBudget.h
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <vector>
+#include "GL/glew.h"
+#include "GLFW/glfw3.h"
+#include "glm/gtc/matrix_transform.hpp"
+#include "material.h"
+#include "gpuReadback.h"
+#include "particleSystem.h"
+
+// Keeps a whole scene of particle systems under one particle cap and one memory cap, without tuning each system.
+// Every frame, each system asks for its whole pool. The GPU ranks the systems by priority times how big they look
+// from the camera, and hands out the cap in that order with a prefix sum, so the most important systems are
+// filled first and distant or off screen ones get what is left. The quotas never leave the GPU: each system
+// reads its own in compute.glsl, and only lets that many of its particles come back to life.
+// When a quota shrinks, particles over it finish their lives instead of vanishing, so the total can go over
+// the cap for up to one lifetime.
+class ParticleBudget
+{
+public:
+    // Most systems one budget can handle, they are all ranked in a single work group.
+    // Must match MAX_SYSTEMS in particleBudget.glsl
+    static const int MAX_SYSTEMS = 256;
+
+    // maxMemory is in bytes, and counts the particle pools of every system on the budget.
+    ParticleBudget(int maxParticles, size_t maxMemory);
+    ~ParticleBudget();
+
+    // Puts a system on the budget. More priority means it is filled before other systems that look the same size.
+    // Returns false, and leaves the system alone, if its pool would go over the memory cap.
+    // The system's bounds are turned on, they are used to tell how big it looks.
+    bool Add(ParticleSystem* system, float priority = 1.f);
+    // Gives the system its whole pool back.
+    void Remove(ParticleSystem* system);
+    void SetPriority(ParticleSystem* system, float priority);
+
+    // Works out next frame's quotas. Call this once per frame, after every system on the budget has updated.
+    void Update(glm::mat4 viewProjection, glm::vec3 cameraPosition);
+
+    // The latest quota for a system to reach the CPU, usually from one or two frames ago. -1 before the first one.
+    int GetQuota(ParticleSystem* system);
+
+    // Pool memory used by the systems on the budget, in bytes.
+    size_t GetMemoryUsage();
+
+    // Most particles alive at once, summed over every system.
+    int m_maxParticles;
+
+    // Most bytes of particle pools. Only checked when a system is added, the pools never change size afterwards.
+    size_t m_maxMemory;
+
+    // Importance of a system that is completely off screen, compared to the same system on screen.
+    float m_offscreenImportance = .1f;
+
+private:
+    struct Entry
+    {
+        ParticleSystem* m_system;
+        float m_priority;
+        // Whether the budget turned bounds on, and should turn them off again.
+        bool m_enabledBounds;
+    };
+
+    // Slot of a system in the buffers, -1 if it isn't on the budget.
+    int FindSlot(ParticleSystem* system);
+
+    std::vector<Entry> m_entries;
+
+    Material* m_budgetMat;
+    GLuint m_boundsBuffer;
+    GLuint m_systemBuffer;
+    GLuint m_quotaBuffer;
+    GPUReadback* m_quotaReadback;
+
+    // Quotas as of the last readback, by slot.
+    std::vector<int> m_quotas;
+    // Copies made before the last Add or Remove don't match the slots anymore, so they are skipped.
+    int m_firstValidCopy = 0;
+};
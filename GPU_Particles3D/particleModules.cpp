@@ -0,0 +1,258 @@
+/*
+Title: GPU Simulated Particle System
+File Name: particleModules.cpp
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "particleModules.h"
+#include <map>
+#include <vector>
+#include <sstream>
+#include <iomanip>
+
+// Compiled programs, by shader file and #defines.
+static std::map<std::string, ShaderProgram*> s_programCache;
+
+// Indices for drawing particles as quads, two triangles over each particle's four vertices.
+// Shared by every system, and grown to fit the biggest one drawn so far.
+static GLuint s_quadIndexBuffer = 0;
+static int s_quadIndexParticles = 0;
+
+// Writes a float so GLSL reads it as a float: always with a decimal point, and without losing precision.
+static std::string FloatLiteral(float f)
+{
+    std::ostringstream stream;
+    stream << std::showpoint << std::setprecision(9) << f;
+    return stream.str();
+}
+
+std::string GlslDefine(const std::string& name, int value)
+{
+    return "#define " + name + " " + std::to_string(value) + "\n";
+}
+
+std::string GlslDefine(const std::string& name, float value)
+{
+    return "#define " + name + " " + FloatLiteral(value) + "\n";
+}
+
+std::string GlslDefine(const std::string& name, glm::vec2 value)
+{
+    return "#define " + name + " vec2(" + FloatLiteral(value.x) + ", " + FloatLiteral(value.y) + ")\n";
+}
+
+std::string GlslDefine(const std::string& name, glm::vec3 value)
+{
+    return "#define " + name + " vec3(" + FloatLiteral(value.x) + ", " + FloatLiteral(value.y) + ", " + FloatLiteral(value.z) + ")\n";
+}
+
+std::string GlslDefine(const std::string& name, glm::vec4 value)
+{
+    return "#define " + name + " vec4(" + FloatLiteral(value.x) + ", " + FloatLiteral(value.y) + ", " + FloatLiteral(value.z) + ", " + FloatLiteral(value.w) + ")\n";
+}
+
+std::string ParticleModules::GetSimulationDefines() const
+{
+    std::string defines;
+    if (m_spawn)
+    {
+        defines += "#define MODULE_SPAWN\n";
+    }
+    if (m_forces)
+    {
+        defines += "#define MODULE_FORCES\n";
+    }
+    if (m_damping)
+    {
+        defines += "#define MODULE_DAMPING\n";
+        defines += GlslDefine("DAMPING_RATE", m_dampingRate);
+    }
+    if (m_rotation)
+    {
+        defines += "#define MODULE_ROTATION\n";
+    }
+    if (m_collision)
+    {
+        // The shader expects a unit normal, scale the whole plane so the distance still matches.
+        glm::vec4 plane = m_collisionPlane / glm::length(glm::vec3(m_collisionPlane));
+        defines += "#define MODULE_COLLISION\n";
+        defines += GlslDefine("COLLISION_PLANE", plane);
+        defines += GlslDefine("RESTITUTION", m_restitution);
+    }
+    if (m_sleep)
+    {
+        defines += "#define MODULE_SLEEP\n";
+        defines += GlslDefine("SLEEP_SPEED", m_sleepSpeed);
+        defines += GlslDefine("SLEEP_TIME", m_sleepTime);
+    }
+    if (m_trails)
+    {
+        defines += "#define MODULE_TRAILS\n";
+        defines += GlslDefine("TRAIL_LENGTH", GetTrailLength());
+        defines += GlslDefine("TRAIL_SPACING", m_trailSpacing);
+    }
+    return defines;
+}
+
+std::string ParticleModules::GetRenderDefines() const
+{
+    std::string defines;
+    if (m_rotation)
+    {
+        defines += "#define MODULE_ROTATION\n";
+    }
+    if (m_color)
+    {
+        defines += "#define MODULE_COLOR\n";
+    }
+    else
+    {
+        defines += GlslDefine("CONSTANT_COLOR", m_constantColor);
+    }
+    if (m_trails)
+    {
+        defines += "#define MODULE_TRAILS\n";
+        defines += GlslDefine("TRAIL_LENGTH", GetTrailLength());
+        defines += GlslDefine("TRAIL_SPACING", m_trailSpacing);
+        // max_vertices has to be a plain number before GLSL 4.40.
+        defines += GlslDefine("TRAIL_VERTICES", GetTrailLength() * 2);
+    }
+    return defines;
+}
+
+std::string ParticleModules::GetCullDefines() const
+{
+    std::string defines;
+    if (m_trails)
+    {
+        defines += "#define MODULE_TRAILS\n";
+        defines += GlslDefine("TRAIL_LENGTH", GetTrailLength());
+    }
+    return defines;
+}
+
+int ParticleModules::GetTrailLength() const
+{
+    // The geometry shader puts out two vertices per point, and can only put out so many.
+    return glm::clamp(m_trailLength, 2, MAX_TRAIL_LENGTH);
+}
+
+// Looks for a program in the cache, nullptr if it hasn't been compiled yet.
+static ShaderProgram* FindCachedProgram(const std::string& key)
+{
+    auto cached = s_programCache.find(key);
+    return cached != s_programCache.end() ? cached->second : nullptr;
+}
+
+// The cache keeps a reference, so programs aren't freed when the last system using them is deleted.
+static void AddCachedProgram(const std::string& key, ShaderProgram* program)
+{
+    program->IncRefCount();
+    s_programCache[key] = program;
+}
+
+ShaderProgram* GetParticleSimulationProgram(const std::string& defines)
+{
+    std::string key = "compute\n" + defines;
+    ShaderProgram* program = FindCachedProgram(key);
+    if (program == nullptr)
+    {
+        program = new ShaderProgram();
+        program->AttachShader(new Shader("../Assets/compute.glsl", GL_COMPUTE_SHADER, defines));
+        AddCachedProgram(key, program);
+    }
+    return program;
+}
+
+ShaderProgram* GetParticleRenderProgram(const std::string& defines)
+{
+    std::string key = "render\n" + defines;
+    ShaderProgram* program = FindCachedProgram(key);
+    if (program == nullptr)
+    {
+        program = new ShaderProgram();
+        program->AttachShader(new Shader("../Assets/vertex.glsl", GL_VERTEX_SHADER, defines));
+        program->AttachShader(new Shader("../Assets/geometry.glsl", GL_GEOMETRY_SHADER, defines));
+        program->AttachShader(new Shader("../Assets/fragment.glsl", GL_FRAGMENT_SHADER, defines));
+        AddCachedProgram(key, program);
+    }
+    return program;
+}
+
+ShaderProgram* GetParticleQuadProgram(const std::string& defines)
+{
+    std::string key = "quads\n" + defines;
+    ShaderProgram* program = FindCachedProgram(key);
+    if (program == nullptr)
+    {
+        program = new ShaderProgram();
+        program->AttachShader(new Shader("../Assets/quadVertex.glsl", GL_VERTEX_SHADER, defines));
+        program->AttachShader(new Shader("../Assets/fragment.glsl", GL_FRAGMENT_SHADER, defines));
+        AddCachedProgram(key, program);
+    }
+    return program;
+}
+
+ShaderProgram* GetParticleCullProgram(const std::string& defines)
+{
+    std::string key = "cull\n" + defines;
+    ShaderProgram* program = FindCachedProgram(key);
+    if (program == nullptr)
+    {
+        program = new ShaderProgram();
+        program->AttachShader(new Shader("../Assets/particleCull.glsl", GL_COMPUTE_SHADER, defines));
+        AddCachedProgram(key, program);
+    }
+    return program;
+}
+
+void BindParticleQuadIndices(int particleCount)
+{
+    if (s_quadIndexBuffer == 0)
+    {
+        glGenBuffers(1, &s_quadIndexBuffer);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_quadIndexBuffer);
+    if (particleCount > s_quadIndexParticles)
+    {
+        // Corners go (0, 0), (1, 0), (0, 1), (1, 1), the same order the geometry shader emits its triangle strip in.
+        std::vector<GLuint> indices;
+        indices.reserve(particleCount * 6);
+        for (int i = 0; i < particleCount; i++)
+        {
+            GLuint corner = i * 4;
+            GLuint quad[] = { corner, corner + 1, corner + 2, corner + 2, corner + 1, corner + 3 };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+        s_quadIndexParticles = particleCount;
+    }
+}
+
+void ClearParticleProgramCache()
+{
+    for (auto& cached : s_programCache)
+    {
+        cached.second->DecRefCount();
+    }
+    s_programCache.clear();
+
+    glDeleteBuffers(1, &s_quadIndexBuffer);
+    s_quadIndexBuffer = 0;
+    s_quadIndexParticles = 0;
+}
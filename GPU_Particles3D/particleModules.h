@@ -0,0 +1,137 @@
+/*
+Title: GPU Simulated Particle System
+File Name: particleModules.h
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+#include <string>
+#include "glm/gtc/matrix_transform.hpp"
+#include "shaderProgram.h"
+
+// The behaviours a particle system can run. Each one is a block of code in the particle shaders that
+// is only compiled in when its module is turned on, so an effect doesn't pay for anything it doesn't use.
+// The constants below are compiled into the shaders too, changing them means building new programs.
+struct ParticleModules
+{
+    // Dead particles are recycled at the system position, or on the emitter mesh.
+    // When off, particles only come to life when a parent system asks for them.
+    bool m_spawn = true;
+
+    // Global acceleration and force fields.
+    bool m_forces = true;
+
+    // Removes this fraction of the velocity every second.
+    bool m_damping = true;
+    float m_dampingRate = 5.f;
+
+    // Particles spin, and their quads turn with them.
+    bool m_rotation = true;
+
+    // Color and size follow the lifetime curves.
+    // When off, every particle is drawn in the constant color at full size.
+    bool m_color = true;
+    glm::vec4 m_constantColor = glm::vec4(1, 1, 1, 1);
+
+    // Only used when the system's texture is a flipbook (a texture array, see Texture).
+    // Frames play once over a particle's life. Blending fades each frame into the next, so short animations don't step.
+    bool m_flipbookBlend = true;
+
+    // Particles bounce off a plane, keeping this fraction of their speed into it.
+    // The plane is (normal, distance), particles stay where dot(normal, position) + distance >= 0.
+    // The restitution is also used for the collision mesh (see ParticleSystem::SetCollisionMesh).
+    bool m_collision = false;
+    glm::vec4 m_collisionPlane = glm::vec4(0, 1, 0, 0);
+    float m_restitution = .5f;
+
+    // Only used when the system has a wind grid (see ParticleSystem::SetWindGrid).
+    // Particles match the velocity of the air at this rate, per second.
+    float m_windCoupling = 2.f;
+    // How strongly particles push the air back, as a fraction of what the air does to them.
+    // 0 turns it off, which saves three atomic adds per particle.
+    float m_windSplat = 0.f;
+
+    // Particles that barely move for a while are left out of the simulation until something disturbs them.
+    // A particle falls asleep once it has moved slower than m_sleepSpeed for m_sleepTime seconds.
+    // Sleeping particles still age, and wake up in force fields, in wind, and when ParticleSystem::WakeParticles is called.
+    bool m_sleep = false;
+    float m_sleepSpeed = .1f;
+    float m_sleepTime = .5f;
+
+    // Particles draw a ribbon through the last m_trailLength places they have been, instead of a quad,
+    // so a few particles can make long continuous streaks. A point is kept every m_trailSpacing of a particle's
+    // life (0 to 1), so a trail covers m_trailLength * m_trailSpacing of the life, the newest point following the particle.
+    // The length is clamped to [2, MAX_TRAIL_LENGTH], each point costs 16 bytes per particle.
+    bool m_trails = false;
+    int m_trailLength = 8;
+    float m_trailSpacing = .02f;
+    static const int MAX_TRAIL_LENGTH = 32;
+
+    // m_trailLength clamped to what the shaders can draw.
+    int GetTrailLength() const;
+
+    // Before drawing, a compute pass lists the particles inside the view, and only those are drawn, with an indirect
+    // draw sized on the GPU. Worth it for big systems that are often partly off screen. Needs ParticleSystem::SetView,
+    // which gives it the view to cull against, and until then everything is drawn.
+    // With trails, a particle is kept while any part of its trail could be in view.
+    bool m_culling = false;
+
+    // System parameters compiled into the shaders as constants, instead of being set every frame.
+    // Only for values that never change: the value the system has when its shaders are built is the one used.
+    bool m_constantPosition = false;
+    bool m_constantLifeTime = false;
+    bool m_constantAcceleration = false;
+    bool m_constantParticleSize = false;
+    bool m_constantEmitterSpeed = false;
+
+    // The #define lines for the simulation (compute) shader.
+    std::string GetSimulationDefines() const;
+
+    // The #define lines for the render shaders. Only a few modules change how particles are drawn.
+    std::string GetRenderDefines() const;
+
+    // The #define lines for the culling pass, which only needs to know about trails.
+    std::string GetCullDefines() const;
+};
+
+// A #define line with a value GLSL reads as the matching type, to fold constants into shaders.
+std::string GlslDefine(const std::string& name, int value);
+std::string GlslDefine(const std::string& name, float value);
+std::string GlslDefine(const std::string& name, glm::vec2 value);
+std::string GlslDefine(const std::string& name, glm::vec3 value);
+std::string GlslDefine(const std::string& name, glm::vec4 value);
+
+// Gets the particle simulation program compiled with the given #defines.
+// Programs are cached, so systems with the same modules share one program, and it is only compiled once.
+ShaderProgram* GetParticleSimulationProgram(const std::string& defines);
+
+// Same as above, for the vertex, geometry and fragment program particles are drawn with.
+ShaderProgram* GetParticleRenderProgram(const std::string& defines);
+
+// Same again, for drawing particles as indexed quads built in the vertex shader, without a geometry shader (see quadVertex.glsl).
+ShaderProgram* GetParticleQuadProgram(const std::string& defines);
+
+// Same again, for the pass that lists the particles in view (see particleCull.glsl).
+ShaderProgram* GetParticleCullProgram(const std::string& defines);
+
+// Binds an index buffer with enough quads for particleCount particles, for the program above.
+// The buffer is shared by every system, and grown to fit the biggest one drawn so far.
+void BindParticleQuadIndices(int particleCount);
+
+// Lets go of every cached program, and the quad indices. Programs still used by a material stay alive until the material is deleted.
+void ClearParticleProgramCache();
@@ -0,0 +1,156 @@
+/*
+Title: GPU Simulated Particle System
+File Name: particleQueries.cpp
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "particleQueries.h"
+#include "particleSystem.h"
+#include "parallelPrimitives.h"
+
+// Matches Result in particleQuery.glsl
+struct QueryResult
+{
+    glm::vec3 m_position;
+    float m_distance;
+    GLuint m_count;
+    GLuint m_particle;
+    GLuint m_padding[2];
+};
+
+// Particle index the shader uses when no particle was found.
+static const GLuint NO_PARTICLE = 0xFFFFFFFF;
+
+ParticleQueries::ParticleQueries(int maxParticles)
+{
+    m_maxParticles = maxParticles;
+    m_groupCount = (maxParticles + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE;
+
+    ShaderProgram* program = new ShaderProgram();
+    program->AttachShader(new Shader("../Assets/particleQuery.glsl", GL_COMPUTE_SHADER));
+    m_queryMat = new Material(program);
+
+    m_queryBuffer = CreateStorageBuffer(MAX_QUERIES_PER_FRAME * sizeof(ParticleQuery));
+    m_partialBuffer = CreateStorageBuffer(MAX_QUERIES_PER_FRAME * m_groupCount * sizeof(QueryResult));
+    m_doneBuffer = CreateStorageBuffer(MAX_QUERIES_PER_FRAME * sizeof(GLuint));
+    m_resultBuffer = CreateStorageBuffer(MAX_QUERIES_PER_FRAME * sizeof(QueryResult));
+    m_readback = new GPUReadback(MAX_QUERIES_PER_FRAME * sizeof(QueryResult));
+}
+
+ParticleQueries::~ParticleQueries()
+{
+    glDeleteBuffers(1, &m_queryBuffer);
+    glDeleteBuffers(1, &m_partialBuffer);
+    glDeleteBuffers(1, &m_doneBuffer);
+    glDeleteBuffers(1, &m_resultBuffer);
+    delete m_readback;
+    delete m_queryMat;
+}
+
+int ParticleQueries::Add(ParticleQuery query)
+{
+    m_waiting.push_back(query);
+    return m_nextQuery++;
+}
+
+void ParticleQueries::Run(GLuint vertexBuffer, GLintptr vertexOffset)
+{
+    m_frame++;
+    if (m_waiting.empty())
+    {
+        return;
+    }
+
+    // Take as many queries as fit, and remember which ones they were for when the results come back.
+    int count = glm::min((int)m_waiting.size(), MAX_QUERIES_PER_FRAME);
+    std::vector<ParticleQuery> queries(m_waiting.begin(), m_waiting.begin() + count);
+    m_waiting.erase(m_waiting.begin(), m_waiting.begin() + count);
+
+    Batch batch;
+    batch.m_frame = m_frame;
+    batch.m_firstQuery = m_firstWaiting;
+    for (const ParticleQuery& query : queries)
+    {
+        batch.m_types.push_back((ParticleQueryType)query.m_type);
+    }
+    m_firstWaiting += count;
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_queryBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(ParticleQuery), queries.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_doneBuffer);
+    glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, count * sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // The particles have to be finished moving before they are looked at.
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, vertexBuffer, vertexOffset, m_maxParticles * sizeof(Particle));
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_queryBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_partialBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_doneBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, m_resultBuffer);
+    m_queryMat->SetInt((char*)"particleCount", m_maxParticles);
+    m_queryMat->Bind();
+    glDispatchCompute(m_groupCount, count, 1);
+    m_queryMat->Unbind();
+    for (int i = 0; i < 5; i++)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, 0);
+    }
+
+    batch.m_copyNumber = m_readback->Copy(m_resultBuffer, 0, count * sizeof(QueryResult));
+    m_batches.push_back(batch);
+}
+
+int ParticleQueries::Read(std::vector<ParticleQueryResult>& results)
+{
+    int dropped = 0;
+    const void* data;
+    int copyNumber;
+    while ((copyNumber = m_readback->Read(&data)) >= 0)
+    {
+        // Copies before this one were dropped by the readback to make room, so their results are gone.
+        while (m_batches.front().m_copyNumber < copyNumber)
+        {
+            dropped += (int)m_batches.front().m_types.size();
+            m_batches.pop_front();
+        }
+
+        const Batch& batch = m_batches.front();
+        const QueryResult* batchResults = (const QueryResult*)data;
+        for (int i = 0; i < (int)batch.m_types.size(); i++)
+        {
+            const QueryResult& gpuResult = batchResults[i];
+            ParticleQueryResult result;
+            result.m_query = batch.m_firstQuery + i;
+            result.m_type = batch.m_types[i];
+            result.m_count = (int)gpuResult.m_count;
+            result.m_particle = gpuResult.m_particle == NO_PARTICLE ? -1 : (int)gpuResult.m_particle;
+            result.m_position = gpuResult.m_position;
+            result.m_distance = gpuResult.m_distance;
+            result.m_age = m_frame - batch.m_frame;
+            results.push_back(result);
+        }
+        m_batches.pop_front();
+    }
+    return dropped;
+}
+
+int ParticleQueries::GetWaitingCount()
+{
+    return (int)m_waiting.size();
+}
@@ -0,0 +1,126 @@
+/*
+Title: GPU Simulated Particle System
+File Name: particleQueries.h
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <vector>
+#include <deque>
+#include "GL/glew.h"
+#include "GLFW/glfw3.h"
+#include "glm/gtc/matrix_transform.hpp"
+#include "material.h"
+#include "gpuReadback.h"
+
+// Kinds of spatial query. Must match the defines in particleQuery.glsl.
+enum class ParticleQueryType
+{
+    // Counts the living particles inside a sphere.
+    CountInSphere = 0,
+    // Finds the living particle closest to a ray.
+    NearestToRay = 1
+};
+
+// A spatial query, laid out the way particleQuery.glsl reads it.
+struct ParticleQuery
+{
+    glm::vec3 m_origin;     // Center of the sphere, or start of the ray.
+    GLint m_type;           // ParticleQueryType
+    glm::vec3 m_direction;  // Unit direction of the ray.
+    float m_size;           // Radius of the sphere, or length of the ray.
+};
+
+// The answer to a ParticleQuery, see ParticleSystem::ReadQueryResults.
+struct ParticleQueryResult
+{
+    // The id the query was given when it was made.
+    int m_query;
+    ParticleQueryType m_type;
+
+    // CountInSphere: how many particles were inside the sphere.
+    int m_count;
+
+    // NearestToRay: index of the particle closest to the ray, or -1 if none were alongside it.
+    // Particles behind the start or past the end of the ray don't count.
+    int m_particle;
+    glm::vec3 m_position;
+    float m_distance;
+
+    // How many Updates ago the query ran. 0 means it saw the particles the way the last Update left them.
+    int m_age;
+};
+
+// Answers spatial queries against particles that live on the GPU, without copying the particles back.
+// Queries are queued up on the CPU, and every waiting query is answered by a single dispatch, with a work
+// group per block of particles per query. The results are copied back through a GPUReadback, so nothing waits.
+class ParticleQueries
+{
+public:
+    // Must match WORK_GROUP_SIZE in particleQuery.glsl
+    static const int WORK_GROUP_SIZE = 256;
+
+    // Most queries answered by one Run, any more wait for the next one.
+    static const int MAX_QUERIES_PER_FRAME = 64;
+
+    ParticleQueries(int maxParticles);
+    ~ParticleQueries();
+
+    // Queues a query for the next Run, and returns its id.
+    int Add(ParticleQuery query);
+
+    // Answers up to MAX_QUERIES_PER_FRAME waiting queries against the particles in vertexBuffer, starting
+    // vertexOffset bytes in, and starts copying the answers back. Call this once per frame, even when nothing is waiting.
+    void Run(GLuint vertexBuffer, GLintptr vertexOffset = 0);
+
+    // Adds every result that has reached the CPU, oldest first.
+    // Returns how many results were lost because the CPU fell too far behind to read them.
+    int Read(std::vector<ParticleQueryResult>& results);
+
+    // Queries that haven't been run yet.
+    int GetWaitingCount();
+
+private:
+    // Queries that were run together, waiting for their results to come back.
+    struct Batch
+    {
+        int m_copyNumber;
+        int m_frame;
+        int m_firstQuery;
+        std::vector<ParticleQueryType> m_types;
+    };
+
+    int m_maxParticles;
+    int m_groupCount;
+
+    Material* m_queryMat;
+    GLuint m_queryBuffer;
+    GLuint m_partialBuffer;
+    GLuint m_doneBuffer;
+    GLuint m_resultBuffer;
+    GPUReadback* m_readback;
+
+    std::deque<ParticleQuery> m_waiting;
+    std::deque<Batch> m_batches;
+
+    // Id of the next query, and of the first one in m_waiting.
+    int m_nextQuery = 0;
+    int m_firstWaiting = 0;
+
+    // Counts calls to Run, to tell how old a result is.
+    int m_frame = 0;
+};
@@ -23,116 +23,1514 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "particleSystem.h"
+#include "particleBatch.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstddef>
 
-ParticleSystem::ParticleSystem(Texture* texture)
+// Matches the spawn request blocks in compute.glsl: a count, the number of requests used so far, two
+// uints of padding, then the requests themselves (a position and velocity each).
+static const int SPAWN_REQUEST_HEADER_SIZE = 4 * sizeof(GLuint);
+static const int SPAWN_REQUEST_SIZE = 2 * sizeof(glm::vec4);
+
+// Matches the event block in compute.glsl: a count and three uints of padding, then the events.
+static const int EVENT_HEADER_SIZE = 4 * sizeof(GLuint);
+
+// Each particle variable the render program might read, by its name in vertex.glsl.
+struct ParticleAttribute
 {
-    // Setup the compute shader material for the particlue simulation
+    const char* m_name;
+    GLint m_size;
+    GLuint m_offset;
+};
+static const ParticleAttribute PARTICLE_ATTRIBUTES[] =
+{
+    { "in_position", 4, offsetof(Particle, m_position) },
+    { "in_velocity", 4, offsetof(Particle, m_velocity) },
+    { "in_rotation", 1, offsetof(Particle, m_rotation) },
+    { "in_angular", 1, offsetof(Particle, m_angularVelocity) },
+    { "in_age", 1, offsetof(Particle, m_age) },
+};
 
-    ShaderProgram* simulationProgram = new ShaderProgram();
-    simulationProgram->AttachShader(new Shader("../Assets/compute.glsl", GL_COMPUTE_SHADER));
-    m_particleSimulateMat = new Material(simulationProgram);
+// Matches AliasEntry in compute.glsl
+struct AliasEntry
+{
+    float m_probability;
+    GLuint m_alias;
+};
 
-    // Setup shaders and shader program.
-    ShaderProgram* program = new ShaderProgram();
-    program->AttachShader(new Shader("../Assets/vertex.glsl", GL_VERTEX_SHADER));
-    program->AttachShader(new Shader("../Assets/geometry.glsl", GL_GEOMETRY_SHADER));
-    program->AttachShader(new Shader("../Assets/fragment.glsl", GL_FRAGMENT_SHADER));
-    m_particleRenderMat = new Material(program);
-    m_particleRenderMat->Bind();
-    m_particleRenderMat->SetTexture((char*)"tex", texture);
+// Builds an alias table for picking from a list of weights (Vose's method).
+// Every column gets an equal share of the total weight. Columns with less than their share
+// are topped up with part of a column that has too much, which becomes their alias.
+static std::vector<AliasEntry> BuildAliasTable(const std::vector<float>& weights)
+{
+    int count = (int)weights.size();
+    float total = 0;
+    for (float weight : weights)
+    {
+        total += weight;
+    }
+
+    std::vector<AliasEntry> table(count);
+    std::vector<float> scaled(count);
+    std::vector<int> small;
+    std::vector<int> large;
+    for (int i = 0; i < count; i++)
+    {
+        // 1 means exactly an equal share.
+        scaled[i] = weights[i] * count / total;
+        if (scaled[i] < 1)
+        {
+            small.push_back(i);
+        }
+        else
+        {
+            large.push_back(i);
+        }
+    }
+
+    while (!small.empty() && !large.empty())
+    {
+        int less = small.back();
+        small.pop_back();
+        int more = large.back();
+
+        // Fill up the small column with the large one.
+        table[less].m_probability = scaled[less];
+        table[less].m_alias = more;
+        scaled[more] -= 1 - scaled[less];
+
+        if (scaled[more] < 1)
+        {
+            large.pop_back();
+            small.push_back(more);
+        }
+    }
+
+    // Whatever is left over is full, up to rounding error. Rounding can leave a column with no weight at all
+    // among them, like a degenerate triangle, which must never be picked, so it always goes to the heaviest one.
+    int heaviest = (int)(std::max_element(weights.begin(), weights.end()) - weights.begin());
+    for (int i : large)
+    {
+        table[i].m_probability = 1;
+        table[i].m_alias = i;
+    }
+    for (int i : small)
+    {
+        table[i].m_probability = weights[i] > 0 ? 1.f : 0.f;
+        table[i].m_alias = weights[i] > 0 ? i : heaviest;
+    }
+    return table;
+}
+
+ForceField ForceField::Attractor(glm::vec3 position, float strength, float radius)
+{
+    ForceField field;
+    field.m_boundsMin = glm::vec4(position - glm::vec3(radius), (float)ForceFieldType::Attractor);
+    field.m_boundsMax = glm::vec4(position + glm::vec3(radius), strength);
+    field.m_center = glm::vec4(position, radius);
+    field.m_axis = glm::vec4(0);
+    return field;
+}
+
+ForceField ForceField::Vortex(glm::vec3 position, glm::vec3 axis, float strength, float radius, float length)
+{
+    axis = glm::normalize(axis);
+    glm::vec3 halfAxis = axis * length / 2.f;
+
+    // Bounding box of a cylinder: the ends of the axis, plus the radius in every direction but along the axis.
+    glm::vec3 extent = glm::abs(halfAxis) + radius * glm::sqrt(glm::max(glm::vec3(1) - axis * axis, glm::vec3(0)));
+
+    ForceField field;
+    field.m_boundsMin = glm::vec4(position - extent, (float)ForceFieldType::Vortex);
+    field.m_boundsMax = glm::vec4(position + extent, strength);
+    field.m_center = glm::vec4(position, radius);
+    field.m_axis = glm::vec4(axis, length / 2.f);
+    return field;
+}
+
+ForceField ForceField::DragBox(glm::vec3 center, glm::vec3 halfSize, float drag)
+{
+    ForceField field;
+    field.m_boundsMin = glm::vec4(center - halfSize, (float)ForceFieldType::Drag);
+    field.m_boundsMax = glm::vec4(center + halfSize, drag);
+    field.m_center = glm::vec4(center, 0);
+    field.m_axis = glm::vec4(0);
+    return field;
+}
+
+ParticleSystem::ParticleSystem(Texture* texture, int maxParticles)
+{
+    m_maxParticles = maxParticles;
+    m_particleLimit = maxParticles;
+    m_texture = texture;
+    m_texture->IncRefCount();
+
+    // The n-body simulation is a separate compute program that replaces the regular one when it is turned on.
+    ShaderProgram* nBodyProgram = new ShaderProgram();
+    nBodyProgram->AttachShader(new Shader("../Assets/nbody.glsl", GL_COMPUTE_SHADER));
+    m_particleNBodyMat = new Material(nBodyProgram);
+
+    // Default look: starts off a dim purple, then heats up to yellow and shrinks away as it dies.
+    ColorGradient color;
+    color.AddKey(0, glm::vec4(.2f, .1f, .6f, 1));
+    color.AddKey(.5f, glm::vec4(.4f, .2f, .3f, 1));
+    color.AddKey(.8f, glm::vec4(1, .5f, .12f, 1));
+    color.AddKey(1, glm::vec4(1, 1, 0, 1));
+    Curve size;
+    size.AddKey(0, 1);
+    size.AddKey(1, 0);
+    SetLifetimeCurves(color, size);
+
+    // The simulation and render materials are built the first time they are needed,
+    // by default with every module but collision turned on.
 
     // Create particle data.
-    for (int i = 0; i < MAX_PARTICLES; i++)
+    m_particles.resize(m_maxParticles);
+    for (int i = 0; i < m_maxParticles; i++)
     {
         // Get a reference to that particle, not a copy.
         Particle& p = m_particles[i];
-        p.m_age = (float)i / MAX_PARTICLES;
+        p.m_age = (float)i / m_maxParticles;
         p.m_position = glm::vec4(0, 0, 0, 0);
         p.m_velocity = glm::vec4(0, 0, 0, 0);
         p.m_angularVelocity = 0;
         p.m_rotation = 0;
-        p.m_color = glm::vec4(1, 0, 1, 1);
+        p.m_restTime = 0;
     }
 
     // Make a buffer for our particle data.
     glGenBuffers(1, &m_vertexBuffer);
     glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, MAX_PARTICLES * sizeof(Particle), m_particles, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, m_maxParticles * sizeof(Particle), m_particles.data(), GL_STATIC_DRAW);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Make room for a few force fields, this grows if more are added.
+    m_forceFieldCapacity = 16;
+    glGenBuffers(1, &m_forceFieldBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_forceFieldBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, m_forceFieldCapacity * sizeof(ForceField), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 }
 
 ParticleSystem::~ParticleSystem()
 {
+    // The batch's buffer isn't ours to delete, take the particles back out of it first.
+    if (m_batch != nullptr)
+    {
+        m_batch->Remove(this);
+    }
     glDeleteBuffers(1, &m_vertexBuffer);
+    glDeleteBuffers(1, &m_forceFieldBuffer);
+    if (m_spawnRequestBuffer != 0)
+    {
+        glDeleteBuffers(1, &m_spawnRequestBuffer);
+    }
+    glDeleteBuffers(1, &m_emitterTriangleBuffer);
+    glDeleteBuffers(1, &m_emitterAliasBuffer);
+    glDeleteBuffers(1, &m_awakeListBuffer);
+    glDeleteBuffers(1, &m_trailBuffer);
+    glDeleteVertexArrays(1, &m_vertexArray);
+    glDeleteBuffers(1, &m_visibleListBuffer);
+    DisableEvents();
+    DisableBounds();
+    delete m_queries;
     delete m_particleSimulateMat;
+    delete m_particleSleepMat;
+    delete m_particleNBodyMat;
     delete m_particleRenderMat;
+    delete m_particleCullMat;
+    delete m_barnesHut;
+    m_texture->DecRefCount();
+    m_lifetimeTexture->DecRefCount();
 }
 
 Material * ParticleSystem::GetMaterial()
 {
+    BuildMaterials();
     return m_particleRenderMat;
 }
 
+int ParticleSystem::GetMaxParticles()
+{
+    return m_maxParticles;
+}
+
+void ParticleSystem::SetRenderPath(ParticleRenderPath renderPath)
+{
+    if (renderPath != m_renderPath)
+    {
+        m_renderPath = renderPath;
+        m_materialsDirty = true;
+    }
+}
+
+ParticleRenderPath ParticleSystem::GetRenderPath()
+{
+    return m_renderPath;
+}
+
+void ParticleSystem::ScatterParticles(float radius, float orbitSpeed)
+{
+    for (int i = 0; i < m_maxParticles; i++)
+    {
+        Particle& p = m_particles[i];
+
+        // Pick a random point in the disc, more dense towards the middle.
+        float angle = (float)rand() / RAND_MAX * 6.2832f;
+        float distance = (float)rand() / RAND_MAX * radius;
+        float height = ((float)rand() / RAND_MAX - .5f) * radius * .1f;
+        glm::vec3 offset = glm::vec3(cos(angle) * distance, height, sin(angle) * distance);
+
+        // Everything orbits in the same direction, so the disc spins instead of collapsing straight in.
+        glm::vec3 tangent = glm::vec3(-sin(angle), 0, cos(angle));
+
+        p.m_position = glm::vec4(m_position + offset, 1);
+        p.m_velocity = glm::vec4(tangent * orbitSpeed * (distance / radius), 0);
+        p.m_rotation = 0;
+        p.m_angularVelocity = (float)(i % 11);
+        p.m_age = .5f;
+        p.m_restTime = 0;
+    }
+
+    // Replace the whole buffer with the new particles.
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, m_vertexOffset, m_maxParticles * sizeof(Particle), m_particles.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    ClearTrails();
+}
+
+void ParticleSystem::ClearTrails()
+{
+    if (m_trailBuffer == 0)
+    {
+        return;
+    }
+    glm::vec4 noPoint = glm::vec4(0, 0, 0, -1);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_trailBuffer);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_RGBA32F, GL_RGBA, GL_FLOAT, &noPoint);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+bool ParticleSystem::ValidateGravityTree()
+{
+    if (m_barnesHut == nullptr)
+    {
+        m_barnesHut = new BarnesHut(m_maxParticles);
+    }
+    return m_barnesHut->ValidateTree(m_vertexBuffer, m_particleMass);
+}
+
+int ParticleSystem::AddForceField(ForceField field)
+{
+    m_forceFields.push_back(field);
+    m_forceFieldsDirty = true;
+    return (int)m_forceFields.size() - 1;
+}
+
+void ParticleSystem::SetForceField(int index, ForceField field)
+{
+    m_forceFields[index] = field;
+    m_forceFieldsDirty = true;
+}
+
+void ParticleSystem::RemoveForceField(int index)
+{
+    m_forceFields.erase(m_forceFields.begin() + index);
+    m_forceFieldsDirty = true;
+}
+
+void ParticleSystem::ClearForceFields()
+{
+    m_forceFields.clear();
+    m_forceFieldsDirty = true;
+}
+
+int ParticleSystem::GetForceFieldCount()
+{
+    return (int)m_forceFields.size();
+}
+
+void ParticleSystem::SetSubEmitter(SubEmitterEvent event, ParticleSystem* child, int spawnCount, float inheritVelocity, float minImpactSpeed)
+{
+    SubEmitter& subEmitter = event == SubEmitterEvent::Collision ? m_collisionSubEmitter : m_deathSubEmitter;
+    subEmitter.m_child = child;
+    subEmitter.m_spawnCount = spawnCount;
+    subEmitter.m_inheritVelocity = inheritVelocity;
+    subEmitter.m_minImpactSpeed = minImpactSpeed;
+
+    // Writing spawn requests is a module of its own.
+    m_materialsDirty = true;
+
+    if (child == nullptr)
+    {
+        return;
+    }
+
+    child->EnableSpawnRequests();
+}
+
+GLuint ParticleSystem::EnableSpawnRequests()
+{
+    if (m_spawnRequestBuffer != 0)
+    {
+        return m_spawnRequestBuffer;
+    }
+
+    // A request buffer with room for one request per particle, starting out empty.
+    glGenBuffers(1, &m_spawnRequestBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_spawnRequestBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, SPAWN_REQUEST_HEADER_SIZE + m_maxParticles * SPAWN_REQUEST_SIZE, nullptr, GL_DYNAMIC_COPY);
+    glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, SPAWN_REQUEST_HEADER_SIZE, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // Only spawn when asked to.
+    ParticleModules modules = m_modules;
+    modules.m_spawn = false;
+    SetModules(modules);
+    KillAllParticles();
+    return m_spawnRequestBuffer;
+}
+
+void ParticleSystem::KillAllParticles()
+{
+    for (int i = 0; i < m_maxParticles; i++)
+    {
+        m_particles[i].m_age = -1;
+    }
+
+    // Dead particles aren't drawn or simulated, so it doesn't matter that the rest of the CPU copy is out of date.
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, m_vertexOffset, m_maxParticles * sizeof(Particle), m_particles.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ParticleSystem::SetLifetimeCurves(const ColorGradient& color, const Curve& size)
+{
+    Texture* lifetimeTexture = BakeLifetimeTexture(color, size);
+    lifetimeTexture->IncRefCount();
+    if (m_lifetimeTexture != nullptr)
+    {
+        m_lifetimeTexture->DecRefCount();
+    }
+    m_lifetimeTexture = lifetimeTexture;
+
+    // Culling needs to know how big quads can get. Without the color module, size is always 1.
+    m_maxLifetimeSize = 1.f;
+    for (int i = 0; i < LIFETIME_TEXTURE_RESOLUTION; i++)
+    {
+        m_maxLifetimeSize = glm::max(m_maxLifetimeSize, size.Evaluate(i / (float)(LIFETIME_TEXTURE_RESOLUTION - 1)));
+    }
+
+    // If the materials are about to be rebuilt anyway, they will pick up the new texture then.
+    if (!m_materialsDirty && m_modules.m_color)
+    {
+        m_particleRenderMat->SetTexture((char*)"lifetime", m_lifetimeTexture);
+    }
+}
+
+void ParticleSystem::SetEmitterMesh(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices)
+{
+    ClearEmitterMesh();
+
+    // Flatten the mesh out into a list of corners, and weigh every triangle by its area.
+    int triangleCount = (int)indices.size() / 3;
+    std::vector<glm::vec4> corners(triangleCount * 3);
+    std::vector<float> areas(triangleCount);
+    float totalArea = 0;
+    for (int i = 0; i < triangleCount; i++)
+    {
+        glm::vec3 a = vertices[indices[i * 3]];
+        glm::vec3 b = vertices[indices[i * 3 + 1]];
+        glm::vec3 c = vertices[indices[i * 3 + 2]];
+        corners[i * 3] = glm::vec4(a, 1);
+        corners[i * 3 + 1] = glm::vec4(b, 1);
+        corners[i * 3 + 2] = glm::vec4(c, 1);
+        areas[i] = glm::length(glm::cross(b - a, c - a)) / 2.f;
+        totalArea += areas[i];
+    }
+
+    // Nothing to emit from.
+    if (totalArea <= 0)
+    {
+        return;
+    }
+
+    std::vector<AliasEntry> aliases = BuildAliasTable(areas);
+
+    glGenBuffers(1, &m_emitterTriangleBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_emitterTriangleBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, corners.size() * sizeof(glm::vec4), corners.data(), GL_STATIC_DRAW);
+
+    glGenBuffers(1, &m_emitterAliasBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_emitterAliasBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, aliases.size() * sizeof(AliasEntry), aliases.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // New particles can appear anywhere on the mesh, culling has to include all of it.
+    m_emitterBoundsMin = glm::vec3(FLT_MAX);
+    m_emitterBoundsMax = glm::vec3(-FLT_MAX);
+    for (const glm::vec4& corner : corners)
+    {
+        m_emitterBoundsMin = glm::min(m_emitterBoundsMin, glm::vec3(corner));
+        m_emitterBoundsMax = glm::max(m_emitterBoundsMax, glm::vec3(corner));
+    }
+
+    m_emitterTriangleCount = triangleCount;
+    m_materialsDirty = true;
+}
+
+void ParticleSystem::ClearEmitterMesh()
+{
+    if (m_emitterTriangleCount == 0)
+    {
+        return;
+    }
+
+    glDeleteBuffers(1, &m_emitterTriangleBuffer);
+    glDeleteBuffers(1, &m_emitterAliasBuffer);
+    m_emitterTriangleBuffer = 0;
+    m_emitterAliasBuffer = 0;
+    m_emitterTriangleCount = 0;
+    m_emitterBoundsMin = glm::vec3(0);
+    m_emitterBoundsMax = glm::vec3(0);
+    m_materialsDirty = true;
+}
+
+void ParticleSystem::SetModules(const ParticleModules& modules)
+{
+    m_modules = modules;
+    m_materialsDirty = true;
+}
+
+const ParticleModules& ParticleSystem::GetModules()
+{
+    return m_modules;
+}
+
+void ParticleSystem::SetWindGrid(WindGrid* windGrid)
+{
+    m_windGrid = windGrid;
+    m_materialsDirty = true;
+}
+
+void ParticleSystem::SetCollisionMesh(CollisionMesh* collisionMesh)
+{
+    m_collisionMesh = collisionMesh;
+    m_materialsDirty = true;
+    if (collisionMesh != nullptr)
+    {
+        m_lastCollisionMeshUpdate = collisionMesh->GetUpdateCount();
+    }
+}
+
+void ParticleSystem::WakeParticles(glm::vec3 boundsMin, glm::vec3 boundsMax)
+{
+    // Grow the box to hold both, unless it is still inside out.
+    if (m_wakeMin.x > m_wakeMax.x)
+    {
+        m_wakeMin = boundsMin;
+        m_wakeMax = boundsMax;
+    }
+    else
+    {
+        m_wakeMin = glm::min(m_wakeMin, boundsMin);
+        m_wakeMax = glm::max(m_wakeMax, boundsMax);
+    }
+}
+
+void ParticleSystem::WakeAllParticles()
+{
+    WakeParticles(glm::vec3(-FLT_MAX), glm::vec3(FLT_MAX));
+}
+
+void ParticleSystem::EnableEvents(int maxEventsPerFrame, float minImpactSpeed)
+{
+    DisableEvents();
+    m_maxEventsPerFrame = maxEventsPerFrame;
+    m_eventImpactSpeed = minImpactSpeed;
+
+    GLsizeiptr size = EVENT_HEADER_SIZE + maxEventsPerFrame * sizeof(ParticleEvent);
+    glGenBuffers(1, &m_eventBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_eventBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, size, nullptr, GL_DYNAMIC_COPY);
+    glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, EVENT_HEADER_SIZE, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    m_eventReadback = new GPUReadback(size);
+    m_lastDroppedEventCopies = 0;
+
+    // Recording events is a module of its own.
+    m_materialsDirty = true;
+}
+
+void ParticleSystem::DisableEvents()
+{
+    if (m_eventBuffer == 0)
+    {
+        return;
+    }
+    glDeleteBuffers(1, &m_eventBuffer);
+    m_eventBuffer = 0;
+    delete m_eventReadback;
+    m_eventReadback = nullptr;
+    m_materialsDirty = true;
+}
+
+int ParticleSystem::ReadEvents(std::vector<ParticleEvent>& events)
+{
+    if (m_eventReadback == nullptr)
+    {
+        return 0;
+    }
+
+    // Whole frames the CPU was too slow to read count too, as one cap's worth of events each.
+    int dropped = (m_eventReadback->GetDroppedCount() - m_lastDroppedEventCopies) * m_maxEventsPerFrame;
+    m_lastDroppedEventCopies = m_eventReadback->GetDroppedCount();
+
+    const void* data;
+    while (m_eventReadback->Read(&data) >= 0)
+    {
+        GLuint count = *(const GLuint*)data;
+        GLuint kept = count < (GLuint)m_maxEventsPerFrame ? count : (GLuint)m_maxEventsPerFrame;
+        const ParticleEvent* first = (const ParticleEvent*)((const char*)data + EVENT_HEADER_SIZE);
+        events.insert(events.end(), first, first + kept);
+        dropped += count - kept;
+    }
+    return dropped;
+}
+
+void ParticleSystem::EnableBounds()
+{
+    if (m_boundsBuffer != 0)
+    {
+        return;
+    }
+    ShaderProgram* program = new ShaderProgram();
+    program->AttachShader(new Shader("../Assets/particleBounds.glsl", GL_COMPUTE_SHADER));
+    m_boundsMat = new Material(program);
+
+    int workGroups = (m_maxParticles + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE;
+    glGenBuffers(1, &m_boundsPartialBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_boundsPartialBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, workGroups * sizeof(ParticleBounds), nullptr, GL_DYNAMIC_COPY);
+
+    // Start out empty, in case something reads the box before the first Update.
+    ParticleBounds empty;
+    empty.m_boundsMin = glm::vec3(FLT_MAX);
+    empty.m_boundsMax = glm::vec3(-FLT_MAX);
+    empty.m_count = 0;
+    empty.m_maxSpeed = 0;
+    glGenBuffers(1, &m_boundsBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_boundsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(ParticleBounds), &empty, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    m_boundsReadback = new GPUReadback(sizeof(ParticleBounds));
+    m_boundsTimes.assign(GPUReadback::DEFAULT_RING_SIZE, 0.f);
+    m_hasBounds = false;
+}
+
+void ParticleSystem::DisableBounds()
+{
+    if (m_boundsBuffer == 0)
+    {
+        return;
+    }
+    glDeleteBuffers(1, &m_boundsPartialBuffer);
+    glDeleteBuffers(1, &m_boundsBuffer);
+    m_boundsPartialBuffer = 0;
+    m_boundsBuffer = 0;
+    delete m_boundsReadback;
+    m_boundsReadback = nullptr;
+    delete m_boundsMat;
+    m_boundsMat = nullptr;
+    m_hasBounds = false;
+}
+
+bool ParticleSystem::GetBounds(glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+    ReadBounds();
+    if (!m_hasBounds || m_lastBounds.m_count == 0)
+    {
+        return false;
+    }
+    boundsMin = m_lastBounds.m_boundsMin;
+    boundsMax = m_lastBounds.m_boundsMax;
+    return true;
+}
+
+void ParticleSystem::ReadBounds()
+{
+    if (m_boundsReadback == nullptr)
+    {
+        return;
+    }
+
+    // Skip ahead to the newest box that has come back.
+    const void* data;
+    int copyNumber;
+    while ((copyNumber = m_boundsReadback->Read(&data)) >= 0)
+    {
+        m_lastBounds = *(const ParticleBounds*)data;
+        m_lastBoundsTime = m_boundsTimes[copyNumber % m_boundsTimes.size()];
+        m_hasBounds = true;
+    }
+}
+
+GLuint ParticleSystem::GetBoundsBuffer()
+{
+    return m_boundsBuffer;
+}
+
+void ParticleSystem::UpdateBounds()
+{
+    int workGroups = (m_maxParticles + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE;
+
+    // The particles have to be finished moving before they are looked at.
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    BindParticles(0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_boundsPartialBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_boundsBuffer);
+    m_boundsMat->SetInt((char*)"particleCount", m_maxParticles);
+    m_boundsMat->SetInt((char*)"partialCount", workGroups);
+
+    // A box per work group, then one work group to combine them.
+    m_boundsMat->SetInt((char*)"stage", 0);
+    m_boundsMat->Bind();
+    glDispatchCompute(workGroups, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    m_boundsMat->SetInt((char*)"stage", 1);
+    m_boundsMat->Bind();
+    glDispatchCompute(1, 1, 1);
+    m_boundsMat->Unbind();
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, 0);
+
+    // Whatever culls with the box on the GPU needs to see it too.
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_UNIFORM_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+    int copyNumber = m_boundsReadback->Copy(m_boundsBuffer, 0, sizeof(ParticleBounds));
+    m_boundsTimes[copyNumber % m_boundsTimes.size()] = m_simulatedTime;
+}
+
+void ParticleSystem::SetView(const glm::mat4& viewProjection, glm::vec2 viewport)
+{
+    m_viewProjection = viewProjection;
+    m_viewport = viewport;
+
+    // The LOD limit is always in the program from now on, so it can change every frame without rebuilding anything.
+    // Culling particles one by one starts now too, since there is something to cull them against.
+    if (!m_viewSet)
+    {
+        m_viewSet = true;
+        m_materialsDirty = true;
+        EnableBounds();
+    }
+    ReadBounds();
+
+    // Until the first box comes back, the system could be anywhere.
+    if (!m_hasBounds)
+    {
+        m_visible = true;
+        m_projectedSize = FLT_MAX;
+        m_lodFraction = 1.f;
+        return;
+    }
+
+    // The box is a few frames old, and the next Update moves particles again before they are drawn,
+    // catching up on any time skipped off screen. Grow it by the furthest the fastest particle could go
+    // in that time, and take in the emitter, where new particles appear. Paused systems don't catch up.
+    float time = m_simulatedTime - m_lastBoundsTime + m_lastDt;
+    if (m_offscreenUpdateInterval > 0)
+    {
+        time += m_skippedTime;
+    }
+    float margin = m_lastBounds.m_maxSpeed * time + .5f * glm::length(m_acceleration) * time * time + m_cullMargin;
+    glm::vec3 boundsMin = glm::min(m_lastBounds.m_boundsMin, m_position + m_emitterBoundsMin) - glm::vec3(margin);
+    glm::vec3 boundsMax = glm::max(m_lastBounds.m_boundsMax, m_position + m_emitterBoundsMax) + glm::vec3(margin);
+
+    // Off screen if every corner is past the same side of the view. Quads are added in clip space
+    // (see geometry.glsl), and reach out up to half their diagonal from the particle.
+    glm::vec2 quadReach = m_particleSize / viewport * m_maxLifetimeSize * .7072f;
+    bool outside[6] = { true, true, true, true, true, true };
+    for (int corner = 0; corner < 8; corner++)
+    {
+        glm::vec3 p = glm::vec3(corner & 1 ? boundsMax.x : boundsMin.x, corner & 2 ? boundsMax.y : boundsMin.y, corner & 4 ? boundsMax.z : boundsMin.z);
+        glm::vec4 clip = viewProjection * glm::vec4(p, 1);
+        outside[0] = outside[0] && clip.x + quadReach.x < -clip.w;
+        outside[1] = outside[1] && clip.x - quadReach.x > clip.w;
+        outside[2] = outside[2] && clip.y + quadReach.y < -clip.w;
+        outside[3] = outside[3] && clip.y - quadReach.y > clip.w;
+        outside[4] = outside[4] && clip.z < -clip.w;
+        outside[5] = outside[5] && clip.z > clip.w;
+    }
+    m_visible = !(outside[0] || outside[1] || outside[2] || outside[3] || outside[4] || outside[5]);
+
+    // Pixels across the sphere around the box. The length of the second row of the matrix
+    // is how much it scales y by, which for a perspective projection is cot(fov / 2).
+    glm::vec3 center = (boundsMin + boundsMax) * .5f;
+    float radius = glm::length(boundsMax - boundsMin) * .5f;
+    float distance = (viewProjection * glm::vec4(center, 1)).w;
+    float focalLength = glm::length(glm::vec3(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1]));
+    m_projectedSize = distance > radius ? radius * focalLength / distance * viewport.y : FLT_MAX;
+
+    // Keep particles in proportion to the area on screen.
+    m_lodFraction = 1.f;
+    if (m_lodPixelSize > 0 && m_projectedSize < m_lodPixelSize)
+    {
+        float fraction = m_projectedSize / m_lodPixelSize;
+        m_lodFraction = glm::max(fraction * fraction, m_minLodFraction);
+    }
+}
+
+bool ParticleSystem::IsVisible()
+{
+    return m_visible;
+}
+
+float ParticleSystem::GetProjectedSize()
+{
+    return m_projectedSize;
+}
+
+float ParticleSystem::GetLodFraction()
+{
+    return m_lodFraction;
+}
+
+void ParticleSystem::SetParticleLimit(int limit)
+{
+    limit = glm::clamp(limit, 0, m_maxParticles);
+
+    // The limit is only in the program while it is below the pool size.
+    if ((limit < m_maxParticles) != (m_particleLimit < m_maxParticles))
+    {
+        m_materialsDirty = true;
+    }
+    m_particleLimit = limit;
+}
+
+int ParticleSystem::GetParticleLimit()
+{
+    return m_particleLimit;
+}
+
+void ParticleSystem::SetBudget(GLuint quotaBuffer, int slot)
+{
+    // The budget is a module, but moving to another slot only changes a uniform.
+    if ((quotaBuffer != 0) != (m_budgetBuffer != 0))
+    {
+        m_materialsDirty = true;
+    }
+    m_budgetBuffer = quotaBuffer;
+    m_budgetSlot = slot;
+}
+
+int ParticleSystem::QueryCountInSphere(glm::vec3 center, float radius)
+{
+    if (m_queries == nullptr)
+    {
+        m_queries = new ParticleQueries(m_maxParticles);
+    }
+    ParticleQuery query;
+    query.m_origin = center;
+    query.m_type = (GLint)ParticleQueryType::CountInSphere;
+    query.m_direction = glm::vec3(0);
+    query.m_size = radius;
+    return m_queries->Add(query);
+}
+
+int ParticleSystem::QueryNearestToRay(glm::vec3 origin, glm::vec3 direction, float maxDistance)
+{
+    if (m_queries == nullptr)
+    {
+        m_queries = new ParticleQueries(m_maxParticles);
+    }
+    ParticleQuery query;
+    query.m_origin = origin;
+    query.m_type = (GLint)ParticleQueryType::NearestToRay;
+    query.m_direction = glm::normalize(direction);
+    query.m_size = maxDistance;
+    return m_queries->Add(query);
+}
+
+int ParticleSystem::ReadQueryResults(std::vector<ParticleQueryResult>& results)
+{
+    if (m_queries == nullptr)
+    {
+        return 0;
+    }
+    return m_queries->Read(results);
+}
+
+bool ParticleSystem::CanBatch()
+{
+    return m_gravityMode == GravityMode::None
+        && !m_modules.m_sleep
+        && !m_modules.m_trails
+        && m_forceFields.empty()
+        && m_deathSubEmitter.m_child == nullptr
+        && m_collisionSubEmitter.m_child == nullptr
+        && m_spawnRequestBuffer == 0
+        && m_emitterTriangleCount == 0
+        && m_windGrid == nullptr
+        && m_collisionMesh == nullptr
+        && m_eventBuffer == 0
+        && m_budgetBuffer == 0;
+}
+
+void ParticleSystem::BindParticles(GLuint index)
+{
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, index, m_vertexBuffer, m_vertexOffset, m_maxParticles * sizeof(Particle));
+}
+
+std::string ParticleSystem::GetSimulationDefines(bool forBatch)
+{
+    std::string simulationDefines = m_modules.GetSimulationDefines();
+    if (m_modules.m_spawn && m_emitterTriangleCount > 0)
+    {
+        simulationDefines += "#define MODULE_MESH_EMITTER\n";
+    }
+    if (m_deathSubEmitter.m_child != nullptr)
+    {
+        simulationDefines += "#define MODULE_DEATH_EVENTS\n";
+    }
+    // Nothing can bounce without the collision plane or a collision mesh.
+    if (m_collisionSubEmitter.m_child != nullptr && (m_modules.m_collision || m_collisionMesh != nullptr))
+    {
+        simulationDefines += "#define MODULE_COLLISION_EVENTS\n";
+    }
+    if (m_spawnRequestBuffer != 0)
+    {
+        simulationDefines += "#define MODULE_SPAWN_REQUESTS\n";
+    }
+    if (m_windGrid != nullptr)
+    {
+        simulationDefines += "#define MODULE_WIND\n";
+        simulationDefines += GlslDefine("WIND_COUPLING", m_modules.m_windCoupling);
+        if (m_modules.m_windSplat > 0)
+        {
+            simulationDefines += "#define MODULE_WIND_SPLAT\n";
+            simulationDefines += GlslDefine("WIND_SPLAT", m_modules.m_windSplat);
+        }
+    }
+    if (m_eventBuffer != 0)
+    {
+        simulationDefines += "#define MODULE_EVENTS\n";
+        simulationDefines += GlslDefine("EVENT_IMPACT_SPEED", m_eventImpactSpeed);
+    }
+    if (m_budgetBuffer != 0)
+    {
+        simulationDefines += "#define MODULE_BUDGET\n";
+    }
+    if ((m_particleLimit < m_maxParticles || m_viewSet) && !forBatch)
+    {
+        simulationDefines += "#define MODULE_PARTICLE_LIMIT\n";
+    }
+    if (m_collisionMesh != nullptr)
+    {
+        simulationDefines += "#define MODULE_MESH_COLLISION\n";
+        // The plane collision module already defines it otherwise.
+        if (!m_modules.m_collision)
+        {
+            simulationDefines += GlslDefine("RESTITUTION", m_modules.m_restitution);
+        }
+    }
+
+    // Parameters that never change are compiled in with the values they have right now.
+    if (m_modules.m_constantPosition)
+    {
+        simulationDefines += GlslDefine("BASE_POSITION", m_position);
+    }
+    if (m_modules.m_constantLifeTime)
+    {
+        simulationDefines += GlslDefine("BURN_RATE", 1 / m_lifeTime);
+    }
+    if (m_modules.m_constantAcceleration)
+    {
+        simulationDefines += GlslDefine("ACCELERATION", m_acceleration);
+    }
+    if (m_modules.m_constantEmitterSpeed)
+    {
+        simulationDefines += GlslDefine("EMITTER_SPEED", m_emitterSpeed);
+    }
+    return simulationDefines;
+}
+
+void ParticleSystem::BuildMaterials()
+{
+    if (!m_materialsDirty)
+    {
+        return;
+    }
+    m_materialsDirty = false;
+
+    std::string simulationDefines = GetSimulationDefines(false);
+    std::string renderDefines = m_modules.GetRenderDefines();
+    if (m_modules.m_constantParticleSize)
+    {
+        renderDefines += GlslDefine("PARTICLE_SIZE", m_particleSize);
+    }
+    if (m_texture->GetTarget() == GL_TEXTURE_2D_ARRAY)
+    {
+        renderDefines += "#define MODULE_FLIPBOOK\n";
+        renderDefines += GlslDefine("FLIPBOOK_FRAMES", m_texture->GetLayerCount());
+        if (m_modules.m_flipbookBlend)
+        {
+            renderDefines += "#define FLIPBOOK_BLEND\n";
+        }
+    }
+
+    delete m_particleSimulateMat;
+    m_particleSimulateMat = new Material(GetParticleSimulationProgram(simulationDefines));
+
+    // Binding links the program, do it now instead of in the middle of the first Update.
+    m_particleSimulateMat->Bind();
+    m_particleSimulateMat->Unbind();
+
+    // The sleep pass comes from the same file and modules, so it sees the same force fields and wind.
+    delete m_particleSleepMat;
+    m_particleSleepMat = nullptr;
+    if (m_modules.m_sleep)
+    {
+        if (m_awakeListBuffer == 0)
+        {
+            glGenBuffers(1, &m_awakeListBuffer);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_awakeListBuffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, (4 + m_maxParticles) * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        }
+        m_particleSleepMat = new Material(GetParticleSimulationProgram(simulationDefines + "#define SLEEP_PASS\n"));
+        m_particleSleepMat->Bind();
+        m_particleSleepMat->Unbind();
+    }
+
+    // Particles that went to sleep under the old modules might not stay asleep under the new ones.
+    WakeAllParticles();
+
+    // The trail buffer is bound by both programs, make sure it fits the trails they were built for.
+    if (m_modules.m_trails && m_modules.GetTrailLength() != m_trailBufferLength)
+    {
+        glDeleteBuffers(1, &m_trailBuffer);
+        m_trailBufferLength = m_modules.GetTrailLength();
+        glGenBuffers(1, &m_trailBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_trailBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)m_maxParticles * m_trailBufferLength * sizeof(glm::vec4), nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        ClearTrails();
+    }
+
+    // Trails are ribbons made in the geometry shader, so they keep it even when quads are asked for.
+    m_drawQuads = m_renderPath == ParticleRenderPath::VertexPulling && !m_modules.m_trails;
+
+    delete m_particleCullMat;
+    m_particleCullMat = nullptr;
+    m_cullParticles = m_modules.m_culling && m_viewSet;
+    if (m_cullParticles)
+    {
+        renderDefines += "#define MODULE_CULLING\n";
+        if (m_visibleListBuffer == 0)
+        {
+            glGenBuffers(1, &m_visibleListBuffer);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_visibleListBuffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, (4 + m_maxParticles) * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        }
+        m_particleCullMat = new Material(GetParticleCullProgram(m_modules.GetCullDefines()));
+        m_particleCullMat->Bind();
+        m_particleCullMat->Unbind();
+    }
+
+    ShaderProgram* renderProgram = m_drawQuads ? GetParticleQuadProgram(renderDefines) : GetParticleRenderProgram(renderDefines);
+    delete m_particleRenderMat;
+    m_particleRenderMat = new Material(renderProgram);
+    m_particleRenderMat->SetTexture((char*)"tex", m_texture);
+    if (m_modules.m_color)
+    {
+        m_particleRenderMat->SetTexture((char*)"lifetime", m_lifetimeTexture);
+    }
+
+    // Link the program now too, the vertex array needs to know which attributes it reads.
+    m_particleRenderMat->Bind();
+    m_particleRenderMat->Unbind();
+    BuildVertexArray(renderProgram->GetGLShaderProgram());
+}
+
+void ParticleSystem::BuildVertexArray(GLuint program)
+{
+    // Starting over is simpler than undoing the last program's attributes, and only happens when the modules change.
+    glDeleteVertexArrays(1, &m_vertexArray);
+    glGenVertexArrays(1, &m_vertexArray);
+    glBindVertexArray(m_vertexArray);
+
+    // Every attribute comes from vertex buffer binding 0, one Particle per vertex. Draw points the binding at the particles.
+    // Attributes the program doesn't read are left off, so they are never fetched. Quads read no attributes at all.
+    for (const ParticleAttribute& attribute : PARTICLE_ATTRIBUTES)
+    {
+        GLint location = glGetAttribLocation(program, attribute.m_name);
+        if (location >= 0)
+        {
+            glVertexAttribFormat(location, attribute.m_size, GL_FLOAT, GL_FALSE, attribute.m_offset);
+            glVertexAttribBinding(location, 0);
+            glEnableVertexAttribArray(location);
+        }
+    }
+
+    glBindVertexArray(0);
+}
+
+bool ParticleSystem::StartUpdate(float& dt)
+{
+    // Off screen systems only update every so often, catching up on all the time they skipped.
+    // Children are still updated every frame, because their particles can fly into view on their own.
+    // Systems that spawn on request never skip: their box only covers what is already alive, so they look off screen
+    // while their parent or emitters are on screen, and requests left unread would pile up and spawn late.
+    if (!m_visible && m_offscreenUpdateInterval != 0 && m_spawnRequestBuffer == 0)
+    {
+        m_skippedTime += dt;
+        if (m_offscreenUpdateInterval < 0 || m_skippedTime < m_offscreenUpdateInterval)
+        {
+            UpdateSubEmitters(dt);
+            return false;
+        }
+        dt = m_skippedTime;
+    }
+    m_skippedTime = 0;
+    m_simulatedTime += dt;
+    m_lastDt = dt;
+    return true;
+}
+
 void ParticleSystem::Update(float dt)
 {
+    // Batched systems are all updated at once by their batch.
+    if (m_batch != nullptr || !StartUpdate(dt))
+    {
+        return;
+    }
+
     // We are binding the vertex buffer from our square.
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_vertexBuffer);
-
-    // Same as with drawing, but we bind a compute shader program instead.
-    // Set a bunch of values in the compute shader to use.
-    m_particleSimulateMat->SetFloat((char*)"dt", dt);
-    m_particleSimulateMat->SetFloat((char*)"burnRate", 1 / (float)m_lifeTime);
-    m_particleSimulateMat->SetVec3((char*)"basePosition", m_position);
-    m_particleSimulateMat->SetVec3((char*)"acceleration", m_acceleration);
-    
-	// bind, execute the compute program, and unbind
-	m_particleSimulateMat->Bind();
-    glDispatchCompute(MAX_PARTICLES, 1, 1);
-    m_particleSimulateMat->Unbind();
-	
+    BindParticles(0);
+
+    if (m_gravityMode != GravityMode::None)
+    {
+        // Each work group handles WORK_GROUP_SIZE particles, round up so none are left out.
+        int workGroups = (m_maxParticles + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE;
+
+        // First apply gravity to every particle's velocity.
+        if (m_gravityMode == GravityMode::AllPairs)
+        {
+            m_particleNBodyMat->SetFloat((char*)"dt", dt);
+            m_particleNBodyMat->SetFloat((char*)"particleMass", m_particleMass);
+            m_particleNBodyMat->SetFloat((char*)"softening", m_softening);
+            m_particleNBodyMat->SetVec3((char*)"acceleration", m_acceleration);
+            m_particleNBodyMat->SetInt((char*)"particleCount", m_maxParticles);
+            m_particleNBodyMat->SetInt((char*)"stage", 0);
+            m_particleNBodyMat->Bind();
+            glDispatchCompute(workGroups, 1, 1);
+        }
+        else
+        {
+            if (m_barnesHut == nullptr)
+            {
+                m_barnesHut = new BarnesHut(m_maxParticles);
+            }
+            m_barnesHut->Update(m_vertexBuffer, dt, m_particleMass, m_softening, m_openingAngle, m_acceleration);
+            BindParticles(0);
+        }
+
+        // Every velocity has to be written before any position moves.
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        // Then move the particles.
+        m_particleNBodyMat->SetFloat((char*)"dt", dt);
+        m_particleNBodyMat->SetInt((char*)"particleCount", m_maxParticles);
+        m_particleNBodyMat->SetInt((char*)"stage", 1);
+        m_particleNBodyMat->Bind();
+        glDispatchCompute(workGroups, 1, 1);
+        m_particleNBodyMat->Unbind();
+    }
+    else
+    {
+        BuildMaterials();
+
+        // Copy the force fields to the GPU if they changed, making the buffer bigger if they don't fit.
+        if (m_modules.m_forces && m_forceFieldsDirty)
+        {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_forceFieldBuffer);
+            if ((int)m_forceFields.size() > m_forceFieldCapacity)
+            {
+                m_forceFieldCapacity = (int)m_forceFields.size() * 2;
+                glBufferData(GL_SHADER_STORAGE_BUFFER, m_forceFieldCapacity * sizeof(ForceField), nullptr, GL_DYNAMIC_DRAW);
+            }
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_forceFields.size() * sizeof(ForceField), m_forceFields.data());
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+            m_forceFieldsDirty = false;
+        }
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_forceFieldBuffer);
+
+        // Same as with drawing, but we bind a compute shader program instead.
+        // Set a bunch of values in the compute shader to use.
+        // Modules that are turned off aren't in the program, so their values are only set when they are on.
+        // Neither are parameters that were compiled in as constants.
+        m_particleSimulateMat->SetFloat((char*)"dt", dt);
+        if (!m_modules.m_sleep)
+        {
+            m_particleSimulateMat->SetInt((char*)"particleCount", m_maxParticles);
+        }
+        if (!m_modules.m_constantLifeTime)
+        {
+            m_particleSimulateMat->SetFloat((char*)"burnRate", 1 / (float)m_lifeTime);
+        }
+        if (m_modules.m_spawn && !m_modules.m_constantPosition)
+        {
+            m_particleSimulateMat->SetVec3((char*)"basePosition", m_position);
+        }
+        if (m_modules.m_forces)
+        {
+            if (!m_modules.m_constantAcceleration)
+            {
+                m_particleSimulateMat->SetVec3((char*)"acceleration", m_acceleration);
+            }
+            m_particleSimulateMat->SetInt((char*)"forceFieldCount", (int)m_forceFields.size());
+        }
+
+        // Dying particles write into the child's request buffer.
+        ParticleSystem* child = m_deathSubEmitter.m_child;
+        if (child != nullptr)
+        {
+            m_particleSimulateMat->SetInt((char*)"deathSpawnCount", (int)(m_deathSubEmitter.m_spawnCount * m_spawnScale + .5f));
+            m_particleSimulateMat->SetFloat((char*)"inheritVelocity", m_deathSubEmitter.m_inheritVelocity);
+        }
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, child != nullptr ? child->m_spawnRequestBuffer : 0);
+
+        // So do particles that bounce, into their own child's.
+        child = m_collisionSubEmitter.m_child;
+        if (child != nullptr && (m_modules.m_collision || m_collisionMesh != nullptr))
+        {
+            m_particleSimulateMat->SetInt((char*)"collisionSpawnCount", (int)(m_collisionSubEmitter.m_spawnCount * m_spawnScale + .5f));
+            m_particleSimulateMat->SetFloat((char*)"collisionInheritVelocity", m_collisionSubEmitter.m_inheritVelocity);
+            m_particleSimulateMat->SetFloat((char*)"collisionImpactSpeed", m_collisionSubEmitter.m_minImpactSpeed);
+        }
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 15, child != nullptr ? child->m_spawnRequestBuffer : 0);
+
+        // And this system reads from its own.
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_spawnRequestBuffer);
+
+        if (m_modules.m_spawn && m_emitterTriangleCount > 0)
+        {
+            m_particleSimulateMat->SetInt((char*)"emitterTriangleCount", m_emitterTriangleCount);
+            if (!m_modules.m_constantEmitterSpeed)
+            {
+                m_particleSimulateMat->SetFloat((char*)"emitterSpeed", m_emitterSpeed);
+            }
+        }
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, m_emitterTriangleBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, m_emitterAliasBuffer);
+
+        // The wind grid is sampled as a texture. The simulation material has no textures of its own, so unit 0 is free.
+        if (m_windGrid != nullptr)
+        {
+            m_particleSimulateMat->SetVec3((char*)"windBoundsMin", m_windGrid->GetBoundsMin());
+            m_particleSimulateMat->SetVec3((char*)"windBoundsSize", m_windGrid->GetBoundsMax() - m_windGrid->GetBoundsMin());
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_3D, m_windGrid->GetVelocityTexture());
+            if (m_modules.m_windSplat > 0)
+            {
+                m_particleSimulateMat->SetInt((char*)"windResolution", m_windGrid->GetResolution());
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, m_windGrid->GetSplatBuffer());
+            }
+        }
+
+        if (m_collisionMesh != nullptr)
+        {
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, m_collisionMesh->GetNodeBuffer());
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, m_collisionMesh->GetTriangleBuffer());
+        }
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, m_eventBuffer);
+        if (m_budgetBuffer != 0)
+        {
+            m_particleSimulateMat->SetInt((char*)"budgetSlot", m_budgetSlot);
+        }
+        if (m_particleLimit < m_maxParticles || m_viewSet)
+        {
+            m_particleSimulateMat->SetInt((char*)"particleLimit", (int)(m_particleLimit * m_lodFraction));
+        }
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, m_budgetBuffer);
+        if (m_modules.m_trails)
+        {
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 14, m_trailBuffer);
+        }
+
+        if (m_modules.m_sleep)
+        {
+            UpdateSleep(dt);
+        }
+
+        // bind, execute the compute program, and unbind
+        // Each work group handles WORK_GROUP_SIZE particles, round up so none are left out.
+        // With the sleep module, the sleep pass has already worked out how many work groups the awake particles need.
+        m_particleSimulateMat->Bind();
+        if (m_modules.m_sleep)
+        {
+            glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, m_awakeListBuffer);
+            glDispatchComputeIndirect(0);
+            glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+        }
+        else
+        {
+            glDispatchCompute((m_maxParticles + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE, 1, 1);
+        }
+        m_particleSimulateMat->Unbind();
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 14, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 15, 0);
+        if (m_windGrid != nullptr)
+        {
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_3D, 0);
+        }
+
+        // Send this frame's events on their way to the CPU, and start counting again for the next frame.
+        // Copying the whole buffer is wasteful when there are only a few events, but finding out
+        // how many there are would mean waiting for the GPU, which is what this is trying to avoid.
+        if (m_eventBuffer != 0)
+        {
+            m_eventReadback->Copy(m_eventBuffer, 0, EVENT_HEADER_SIZE + m_maxEventsPerFrame * sizeof(ParticleEvent));
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_eventBuffer);
+            glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, EVENT_HEADER_SIZE, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        }
+
+        // Requests from the parent have all been handed out now, so empty the buffer for next frame.
+        if (m_spawnRequestBuffer != 0)
+        {
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_spawnRequestBuffer);
+            glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, SPAWN_REQUEST_HEADER_SIZE, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        }
+    }
+
 	// unbind vertex buffer
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+
+    // Make sure the compute shader is done writing before the buffer is read as vertices,
+    // or straight from the buffer when quads are pulled in the vertex shader or points are drawn from the visible list.
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+    FinishUpdate(dt);
+}
+
+void ParticleSystem::FinishUpdate(float dt)
+{
+    if (m_boundsBuffer != 0)
+    {
+        UpdateBounds();
+    }
+
+    // Answer this frame's queries now that the particles have moved.
+    if (m_queries != nullptr)
+    {
+        m_queries->Run(m_vertexBuffer, m_vertexOffset);
+    }
+
+    // Children spawn from the requests this system just wrote.
+    if (m_deathSubEmitter.m_child != nullptr || m_collisionSubEmitter.m_child != nullptr)
+    {
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        UpdateSubEmitters(dt);
+    }
+}
+
+void ParticleSystem::UpdateSubEmitters(float dt)
+{
+    if (m_deathSubEmitter.m_child != nullptr)
+    {
+        m_deathSubEmitter.m_child->Update(dt);
+    }
+
+    // One child can take both events, it still only gets one update.
+    if (m_collisionSubEmitter.m_child != nullptr && m_collisionSubEmitter.m_child != m_deathSubEmitter.m_child)
+    {
+        m_collisionSubEmitter.m_child->Update(dt);
+    }
+}
+
+void ParticleSystem::UpdateSleep(float dt)
+{
+    // Particles resting under the old acceleration could now be pushed off whatever they rest on.
+    if (m_acceleration != m_lastAcceleration)
+    {
+        WakeAllParticles();
+        m_lastAcceleration = m_acceleration;
+    }
+
+    // Wake anything that was resting on the collision mesh, wherever it was and wherever it went.
+    // Particles rest a little above the surface, so the box is made slightly bigger.
+    if (m_collisionMesh != nullptr && m_collisionMesh->GetUpdateCount() != m_lastCollisionMeshUpdate)
+    {
+        WakeParticles(m_collisionMesh->GetChangedBoundsMin() - glm::vec3(.01f), m_collisionMesh->GetChangedBoundsMax() + glm::vec3(.01f));
+        m_lastCollisionMeshUpdate = m_collisionMesh->GetUpdateCount();
+    }
+
+    // Start with an empty list, and one work group high and deep for the indirect dispatch.
+    GLuint emptyList[4] = { 0, 1, 1, 0 };
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_awakeListBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(emptyList), emptyList);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, m_awakeListBuffer);
+
+    // Only the values the sleep pass uses, which are a few of the update's.
+    m_particleSleepMat->SetFloat((char*)"dt", dt);
+    m_particleSleepMat->SetInt((char*)"particleCount", m_maxParticles);
+    if (!m_modules.m_constantLifeTime)
+    {
+        m_particleSleepMat->SetFloat((char*)"burnRate", 1 / (float)m_lifeTime);
+    }
+    if (m_modules.m_forces)
+    {
+        m_particleSleepMat->SetInt((char*)"forceFieldCount", (int)m_forceFields.size());
+    }
+    if (m_windGrid != nullptr)
+    {
+        m_particleSleepMat->SetVec3((char*)"windBoundsMin", m_windGrid->GetBoundsMin());
+        m_particleSleepMat->SetVec3((char*)"windBoundsSize", m_windGrid->GetBoundsMax() - m_windGrid->GetBoundsMin());
+    }
+    m_particleSleepMat->SetVec3((char*)"wakeMin", m_wakeMin);
+    m_particleSleepMat->SetVec3((char*)"wakeMax", m_wakeMax);
+
+    m_particleSleepMat->Bind();
+    glDispatchCompute((m_maxParticles + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE, 1, 1);
+    m_particleSleepMat->Unbind();
+
+    // The update reads the list, and its dispatch size comes from the same buffer.
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+    // Everything that needed waking is awake now.
+    m_wakeMin = glm::vec3(1);
+    m_wakeMax = glm::vec3(-1);
+}
+
+void ParticleSystem::CullParticles()
+{
+    // Start with an empty list. Points count visible particles as vertices, quads count them as instances of a 4 vertex strip.
+    GLuint emptyList[4] = { 0, 1, 0, 0 };
+    if (m_drawQuads)
+    {
+        emptyList[0] = 4;
+        emptyList[1] = 0;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_visibleListBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(emptyList), emptyList);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    BindParticles(0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 15, m_visibleListBuffer);
+    if (m_modules.m_trails)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 14, m_trailBuffer);
+    }
+
+    // Quads reach out as far as they do in SetView, which culls the whole system the same way.
+    m_particleCullMat->SetInt((char*)"particleCount", m_maxParticles);
+    m_particleCullMat->SetMatrix((char*)"viewProjection", m_viewProjection);
+    m_particleCullMat->SetVec2((char*)"quadReach", m_particleSize / m_viewport * m_maxLifetimeSize * .7072f);
+    m_particleCullMat->SetInt((char*)"countIndex", m_drawQuads ? 1 : 0);
+
+    m_particleCullMat->Bind();
+    glDispatchCompute((m_maxParticles + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE, 1, 1);
+    m_particleCullMat->Unbind();
+
+    // The draw reads the list, and takes its arguments from the same buffer.
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
 }
 
 void ParticleSystem::Draw()
 {
+    // Nothing to see.
+    if (!m_visible)
+    {
+        return;
+    }
+
     // Enable blending when rendering particles
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE);
 
-    // Bind the vertex buffer. and set up attributes
-    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)(0));
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)(sizeof(float) * 4));
-    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)(sizeof(float) * 8));
-    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)(sizeof(float) * 12));
-    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)(sizeof(float) * 13));
-    glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)(sizeof(float) * 14));
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    BuildMaterials();
 
-    // use the vertex attributes we just declared
-    for (int i = 0; i < 6; i++)
+    // Culled particles are found through the visible list, which also holds the arguments for the draw.
+    if (m_cullParticles)
     {
-        glEnableVertexAttribArray(i);
+        CullParticles();
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_visibleListBuffer);
     }
 
+    // The vertex array already knows which attributes to read, it only needs to know where the particles are.
+    // They move when the system joins or leaves a batch. In a batch, they start part way into the buffer.
+    glBindVertexArray(m_vertexArray);
+    glBindVertexBuffer(0, m_vertexBuffer, m_vertexOffset, sizeof(Particle));
 
-    // The particle size is used in the geometry shader to create quads.
-    m_particleRenderMat->SetVec2((char*)"particleSize", m_particleSize);
+    // The particle size is used to create quads, in the geometry shader or the vertex shader.
+    if (!m_modules.m_constantParticleSize)
+    {
+        m_particleRenderMat->SetVec2((char*)"particleSize", m_particleSize);
+    }
 
-    // Bind material and draw
-    m_particleRenderMat->Bind();
+    // Trails are read straight from their buffer in the geometry shader.
+    if (m_modules.m_trails)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 14, m_trailBuffer);
+    }
 
-    // The geometry shader is expecting points, so we call draw with points, once for each particle.
-    glDrawArrays(GL_POINTS, 0, MAX_PARTICLES);
+    // Quads, and points drawn from the visible list, read their particles straight from the buffer.
+    if (m_drawQuads || m_cullParticles)
+    {
+        BindParticles(0);
+    }
 
+    // Bind material and draw
+    m_particleRenderMat->Bind();
 
+    if (m_cullParticles)
+    {
+        // As many points or quads as the cull pass found.
+        glDrawArraysIndirect(m_drawQuads ? GL_TRIANGLE_STRIP : GL_POINTS, nullptr);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+    else if (m_drawQuads)
+    {
+        // Two triangles for each particle, over four vertices that each find their particle from gl_VertexID.
+        // The index buffer binding is part of the vertex array, so it goes when the vertex array is unbound.
+        BindParticleQuadIndices(m_maxParticles);
+        glDrawElements(GL_TRIANGLES, m_maxParticles * 6, GL_UNSIGNED_INT, nullptr);
+    }
+    else
+    {
+        // The geometry shader is expecting points, so we call draw with points, once for each particle.
+        glDrawArrays(GL_POINTS, 0, m_maxParticles);
+    }
 
     // reset everything:
     m_particleRenderMat->Unbind();
-    for (int i = 0; i < 6; i++)
-    {
-        glDisableVertexAttribArray(i);
-    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 14, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 15, 0);
+    glBindVertexArray(0);
     glDisable(GL_BLEND);
 }
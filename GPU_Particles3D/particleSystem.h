@@ -24,35 +24,283 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 #include <vector>
+#include <cfloat>
 #include "GL/glew.h"
 #include "GLFW/glfw3.h"
 #include "glm/gtc/matrix_transform.hpp"
 #include "material.h"
+#include "barnesHut.h"
+#include "lifetimeCurve.h"
+#include "particleModules.h"
+#include "windGrid.h"
+#include "collisionMesh.h"
+#include "gpuReadback.h"
+#include "particleQueries.h"
+
+class ParticleBatch;
 
 struct Particle
 {
     glm::vec4 m_position;
     glm::vec4 m_velocity;
-    glm::vec4 m_color;
     float m_rotation;
     float m_angularVelocity;
     float m_age;
-    // This variable is required, can't input data that isn't a multiple of 4
+    // Seconds the particle has barely moved for, used by the sleep module.
+    // This variable is also required for padding, can't input data that isn't a multiple of 4
     // IF you comment this out, undefined weird stuff will happen.
-    float buffer;
+    float m_restTime;
+};
+
+// Kinds of localized forces. Must match the defines in compute.glsl.
+enum class ForceFieldType
+{
+    // Pulls particles towards a point.
+    Attractor = 0,
+    // Spins particles around a line segment.
+    Vortex = 1,
+    // Slows down particles inside a box.
+    Drag = 2
+};
+
+// A localized force, laid out the way compute.glsl reads it.
+// The bounding box is used to skip fields that are nowhere near a group of particles.
+// Use the static functions to make one.
+struct ForceField
+{
+    glm::vec4 m_boundsMin;  // w: type
+    glm::vec4 m_boundsMax;  // w: strength
+    glm::vec4 m_center;     // w: radius
+    glm::vec4 m_axis;       // w: half length of a vortex
+
+    // Pulls with the given strength at the center, fading out to nothing at the radius.
+    static ForceField Attractor(glm::vec3 position, float strength, float radius);
+
+    // Spins around the axis through position, fading out to nothing at the radius.
+    // The vortex extends length / 2 in each direction along the axis.
+    static ForceField Vortex(glm::vec3 position, glm::vec3 axis, float strength, float radius, float length);
+
+    // Removes drag * dt of the velocity of anything inside the box every frame.
+    static ForceField DragBox(glm::vec3 center, glm::vec3 halfSize, float drag);
+};
+
+// Kinds of ParticleEvent. Must match the defines in compute.glsl.
+enum class ParticleEventType
+{
+    // A particle reached the end of its life.
+    Death = 0,
+    // A particle hit the collision plane or mesh at least as fast as the minimum impact speed.
+    Collision = 1
 };
 
+// Something that happened to a particle, recorded on the GPU and read back a few frames later.
+// Laid out the way compute.glsl writes it. See ParticleSystem::EnableEvents.
+struct ParticleEvent
+{
+    glm::vec3 m_position;
+    GLuint m_type;          // ParticleEventType
+    glm::vec3 m_velocity;   // For collisions, the velocity going into the collision.
+    GLuint m_particle;      // Index of the particle in its system.
+};
+
+// The box around a system's living particles, laid out the way particleBounds.glsl writes it.
+// The box is around particle centers, so grow it by the particle size before testing it against the view.
+// When no particles are alive it is inside out, with min at FLT_MAX and max at -FLT_MAX.
+struct ParticleBounds
+{
+    glm::vec3 m_boundsMin;
+    GLuint m_count;         // Living particles in the box.
+    glm::vec3 m_boundsMax;
+    float m_maxSpeed;       // Speed of the fastest living particle.
+};
+
+// When a particle tells its sub-emitter to spawn new particles.
+enum class SubEmitterEvent
+{
+    // When the particle reaches the end of its life.
+    Death,
+    // When the particle bounces off the collision plane or the collision mesh.
+    Collision
+};
+
+// How particles pull on each other.
+enum class GravityMode
+{
+    // Particles are emitted and recycled, and don't interact.
+    None,
+    // Every particle attracts every other particle. Exact, but O(n^2).
+    AllPairs,
+    // Far away groups of particles are treated as a single mass. O(n log n), for very large systems.
+    BarnesHut
+};
+
+// How particles are turned into quads on screen.
+enum class ParticleRenderPath
+{
+    // One point per particle, which the geometry shader expands into a quad.
+    GeometryShader,
+    // Four vertices per particle, drawn as an indexed quad. The vertex shader reads its particle from the particle
+    // buffer and places its own corner. Avoids the geometry shader, which is slow on a lot of hardware.
+    VertexPulling
+};
 
 class ParticleSystem
 {
 public:
-    ParticleSystem(Texture* texture);
+    // The particle system will work with a predefined pool of particles, this makes things way faster than having a dynamic list.
+    // You may be able to increase this number depending on your hardware.
+    // I was able to run it smoothly with 65536 particles on an NVIDIA GTX 680
+    static const int DEFAULT_MAX_PARTICLES = 16348;
+
+    // Number of particles each compute work group handles in shaders that use shared memory.
+    static const int WORK_GROUP_SIZE = 256;
+
+    // The texture can be a flipbook, in which case particles play through its frames over their life.
+    ParticleSystem(Texture* texture, int maxParticles = DEFAULT_MAX_PARTICLES);
     ~ParticleSystem();
 
     Material* GetMaterial();
+    int GetMaxParticles();
     void Update(float dt);
     void Draw();
 
+    // Picks how particles are drawn, which can be changed at any time. The render material is rebuilt,
+    // so set its uniforms again afterwards. Trails always use the geometry shader, whatever the path.
+    void SetRenderPath(ParticleRenderPath renderPath);
+    ParticleRenderPath GetRenderPath();
+
+    // Spreads the particles out into a spinning disc around the system position.
+    // Useful as a starting point for n-body gravity, which would blow up if every particle started in the same place.
+    void ScatterParticles(float radius, float orbitSpeed);
+
+    // Checks the Barnes-Hut tree built on the GPU against one built on the CPU. Very slow, for testing only.
+    bool ValidateGravityTree();
+
+    // Force fields affect emitted particles (not n-body gravity). Hundreds of them are fine, because each
+    // group of particles only looks at the ones that overlap it.
+    // Returns the index of the new field.
+    int AddForceField(ForceField field);
+    // Replaces the field at index, use this to move fields around.
+    void SetForceField(int index, ForceField field);
+    // Removes the field at index, every field after it moves down by one.
+    void RemoveForceField(int index);
+    void ClearForceFields();
+    int GetForceFieldCount();
+
+    // Makes child spawn spawnCount particles wherever one of this system's particles triggers the event.
+    // The requests never leave the GPU: this system appends them to a buffer owned by the child, and the child
+    // picks them up in the same frame, because children are updated at the end of their parent's Update.
+    // Don't call Update on a child yourself. Pass nullptr to remove the sub-emitter.
+    // The child's spawn module is turned off, so it only spawns particles when asked to.
+    // Collisions slower than minImpactSpeed don't spawn anything, so particles resting on a surface don't keep spawning.
+    void SetSubEmitter(SubEmitterEvent event, ParticleSystem* child, int spawnCount, float inheritVelocity = .5f, float minImpactSpeed = 1.f);
+
+    // Gives the system a buffer of spawn requests, which it empties at the end of every Update, and returns it.
+    // From then on the system only spawns particles when asked to, by a parent system or by GPUEmitters.
+    // Its spawn module is turned off, and every particle is killed.
+    GLuint EnableSpawnRequests();
+
+    // Kills every particle. If the spawn module is on, they come back over the next lifetime.
+    void KillAllParticles();
+
+    // Sets how color and size change over a particle's life. They are baked into a small texture, which
+    // the render program reads once per particle, so changing the look of an effect needs no shader changes.
+    void SetLifetimeCurves(const ColorGradient& color, const Curve& size);
+
+    // Emits particles from the surface of a triangle mesh instead of a single point.
+    // Vertices are relative to the system position, and every 3 indices make a triangle.
+    // Triangles are picked with an alias table built here, so emitting costs the same no matter how big the mesh is.
+    void SetEmitterMesh(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices);
+    // Goes back to emitting from the system position.
+    void ClearEmitterMesh();
+
+    // Picks which behaviours the system runs, and builds shaders with only those behaviours in them.
+    // Not something to call every frame, but systems with the same modules share programs, so it is cheap after the first time.
+    // Shaders are built the next time the system is used, so set up parameters that are compiled in before then.
+    void SetModules(const ParticleModules& modules);
+    const ParticleModules& GetModules();
+
+    // Carries particles along with the air in a wind grid, see m_windCoupling and m_windSplat in ParticleModules.
+    // The grid isn't owned or updated by the system, update it before the system. Pass nullptr to stop.
+    void SetWindGrid(WindGrid* windGrid);
+
+    // Bounces particles off a triangle mesh, with m_restitution from ParticleModules.
+    // Particles check the path they moved along each frame, so fast particles can't skip through thin walls.
+    // The mesh isn't owned by the system, and can be animated with UpdateVertices. Pass nullptr to stop.
+    void SetCollisionMesh(CollisionMesh* collisionMesh);
+
+    // Wakes up sleeping particles inside the box on the next Update (see m_sleep in ParticleModules).
+    // Force fields and wind wake particles by themselves, and so do changing the acceleration or the modules,
+    // and moving the collision mesh. Call this when anything else disturbs resting particles.
+    void WakeParticles(glm::vec3 boundsMin, glm::vec3 boundsMax);
+    void WakeAllParticles();
+
+    // Starts recording deaths, and collisions at least minImpactSpeed fast, for gameplay and audio to react to.
+    // Events are copied back to the CPU a few frames after they happen, without the GPU or CPU ever waiting
+    // on each other. Anything past maxEventsPerFrame in one frame is dropped.
+    void EnableEvents(int maxEventsPerFrame, float minImpactSpeed = 1.f);
+    void DisableEvents();
+
+    // Adds every event that has reached the CPU since the last call, oldest first.
+    // Returns how many were dropped in those frames. Events over the cap are counted exactly.
+    // When the CPU falls so far behind that a whole frame's copy is thrown away, its events are never seen,
+    // so each lost frame counts as maxEventsPerFrame: an upper bound, not the real number.
+    int ReadEvents(std::vector<ParticleEvent>& events);
+
+    // Starts finding the box around the living particles at the end of every Update, so whole systems can be culled.
+    void EnableBounds();
+    void DisableBounds();
+
+    // The latest box to reach the CPU, usually from one or two Updates ago. This never waits for the GPU.
+    // Returns false if no box has come back yet, or if no particles were alive.
+    bool GetBounds(glm::vec3& boundsMin, glm::vec3& boundsMax);
+
+    // The buffer the box is written to, holding a single ParticleBounds, for shaders to cull with directly.
+    // On the GPU there is no lag: once Update returns, work that reads the buffer sees this frame's box.
+    // 0 while bounds are off.
+    GLuint GetBoundsBuffer();
+
+    // Culls the system against the camera, and keeps fewer particles alive when it is small on screen.
+    // Call this every frame before Update, with the matrix and viewport the system is drawn with.
+    // The latest box from GetBounds is grown by how far particles could have moved since it was found, and by
+    // the size of their quads, so a system is only culled when none of it can be on screen.
+    // Off screen, a system isn't drawn, and only updates every m_offscreenUpdateInterval seconds.
+    // Below m_lodPixelSize across on screen, it keeps fewer particles alive, in proportion to its area.
+    void SetView(const glm::mat4& viewProjection, glm::vec2 viewport);
+    bool IsVisible();
+    // How many pixels across the system is on screen, as of the last SetView.
+    float GetProjectedSize();
+    // Part of the particle limit kept alive because of the projected size.
+    float GetLodFraction();
+
+    // Only lets particles below limit come back to life, for scaling quality down without reallocating the pool.
+    // Particles over the limit finish their lives first, so lowering it fades them out instead of popping.
+    void SetParticleLimit(int limit);
+    int GetParticleLimit();
+
+    // Only lets as many particles come back to life as the quota in quotaBuffer[slot], which ParticleBudget
+    // works out on the GPU every frame. Pass 0 to let the system use its whole pool again.
+    void SetBudget(GLuint quotaBuffer, int slot);
+
+    // Spatial queries for gameplay, answered on the GPU so the particles never have to be copied back.
+    // Each returns an id, which comes back with the result. Dead particles are never counted or found.
+    // The latency contract:
+    // - A query runs at the end of the next Update, against the particles as that Update leaves them.
+    //   Up to ParticleQueries::MAX_QUERIES_PER_FRAME run per Update, any more wait for the next one.
+    // - Its result reaches ReadQueryResults once the GPU has finished that frame, usually one or two Updates later.
+    //   m_age in the result says how many Updates ago it ran. Nothing ever waits for the GPU to get it sooner.
+    // - If more than GPUReadback::DEFAULT_RING_SIZE Updates' worth of results go unread, the oldest are dropped.
+    int QueryCountInSphere(glm::vec3 center, float radius);
+    int QueryNearestToRay(glm::vec3 origin, glm::vec3 direction, float maxDistance);
+
+    // Adds every query result that has reached the CPU since the last call, oldest first.
+    // Returns how many results were dropped because they weren't read in time.
+    int ReadQueryResults(std::vector<ParticleQueryResult>& results);
+
+    // Whether the system can be updated by a ParticleBatch, which needs a system with nothing of its own to bind:
+    // no gravity, sleep, force fields, sub-emitters, emitter mesh, wind, collision mesh, events or budget.
+    bool CanBatch();
+
     // Position of the system.
     glm::vec3 m_position;
 
@@ -65,17 +313,205 @@ public:
     // size of particles
     glm::vec2 m_particleSize = glm::vec2(100, 100);
 
+    // Speed particles leave the emitter mesh at, along the triangle normal.
+    float m_emitterSpeed = 1.f;
+
+    // When this isn't None, every particle attracts every other particle, instead of being emitted and recycled.
+    GravityMode m_gravityMode = GravityMode::None;
+
+    // Mass of each particle (with the gravitational constant already multiplied in).
+    float m_particleMass = .001f;
+
+    // Keeps gravity from going to infinity when particles get very close.
+    float m_softening = .05f;
+
+    // Seconds between updates while the system is off screen, each one catching up on all the time that was skipped.
+    // 0 updates every frame anyway, and a negative number pauses the system until it is back on screen.
+    // Systems that spawn on request (sub-emitter children, GPUEmitters effects) always update every frame.
+    float m_offscreenUpdateInterval = .25f;
+
+    // Systems smaller than this on screen, in pixels across, keep fewer particles alive. 0 turns this off.
+    float m_lodPixelSize = 64.f;
+    // Smallest part of its particles a tiny system keeps.
+    float m_minLodFraction = .1f;
+
+    // Extra distance added around the box when culling, for anything that pushes particles harder
+    // than the global acceleration, like force fields and wind.
+    float m_cullMargin = .5f;
+
+    // Scales how many particles sub-emitters are asked to spawn, for scaling quality down.
+    float m_spawnScale = 1.f;
+
+    // Barnes-Hut treats a group of particles as one mass once (group size / distance) is below this.
+    float m_openingAngle = .5f;
+
 private:
-    // The particle system will work with a predefined pool of particles, this makes things way faster than having a dynamic list.
-    // You may be able to increase this number depending on your hardware.
-    // I was able to run it smoothly with 65536 particles on an NVIDIA GTX 680
-    static const int MAX_PARTICLES = 16348;
-    Particle m_particles[MAX_PARTICLES];
+    int m_maxParticles;
+    std::vector<Particle> m_particles;
     float m_internalTimer = 0;
 
-    Material* m_particleRenderMat;
-    Material* m_particleSimulateMat;
+    Material* m_particleRenderMat = nullptr;
+    Material* m_particleSimulateMat = nullptr;
+    Material* m_particleNBodyMat;
+
+    // The render material is rebuilt when the modules change, so it needs to keep its textures around.
+    Texture* m_texture;
+    Texture* m_lifetimeTexture = nullptr;
+
+    ParticleModules m_modules;
+    bool m_materialsDirty = true;
+
+    ParticleRenderPath m_renderPath = ParticleRenderPath::GeometryShader;
+    // Whether the render material draws quads by vertex pulling. Only false for that path when trails are on.
+    bool m_drawQuads = false;
+
+    // Vertex array for drawing, with only the attributes the render program reads. Made along with the render material.
+    GLuint m_vertexArray = 0;
+    void BuildVertexArray(GLuint program);
+
+    // Only created once the culling module is used with a view. Lists the particles inside the view every Draw,
+    // after a header that is the indirect draw for them (see particleCull.glsl).
+    Material* m_particleCullMat = nullptr;
+    GLuint m_visibleListBuffer = 0;
+    // Whether the render material draws from the visible list. Turns on at the first SetView.
+    bool m_cullParticles = false;
+    void CullParticles();
+
+    // The view from the latest SetView, which particles are culled against.
+    glm::mat4 m_viewProjection = glm::mat4(1);
+    glm::vec2 m_viewport = glm::vec2(1);
+
+    // Makes new simulation and render materials for the current modules, if anything changed since last time.
+    // Some modules are turned on automatically: sub-emitter events, spawn requests, and the emitter mesh.
+    void BuildMaterials();
+
+    // The defines the simulation program is built with. A batch always has a particle limit,
+    // so for a batch the limit module is left out, and systems with and without one can share a program.
+    std::string GetSimulationDefines(bool forBatch);
+
+    // The parts of Update around the simulation itself, shared with ParticleBatch.
+    // StartUpdate keeps track of time, and returns false if the system skips this frame because it is off screen,
+    // otherwise dt is changed to the time to simulate. FinishUpdate runs everything that looks at the moved particles.
+    bool StartUpdate(float& dt);
+    void FinishUpdate(float dt);
+
+    // Binds this system's particles to a shader storage binding point.
+    void BindParticles(GLuint index);
+
+    // While the system is in a batch, its particles live in the batch's buffer, starting m_vertexOffset bytes in,
+    // and m_vertexBuffer is the batch's buffer. The batch moves them back into a buffer of their own when it lets go.
+    friend class ParticleBatch;
+    ParticleBatch* m_batch = nullptr;
+    GLintptr m_vertexOffset = 0;
+
+    // Runs the sleep pass, which ages sleeping particles, wakes the ones that were disturbed,
+    // and lists the rest for the update. Expects the update's buffers and textures to be bound already.
+    void UpdateSleep(float dt);
+
+    // Only created once Barnes-Hut gravity is used.
+    BarnesHut* m_barnesHut = nullptr;
+
+    // The child system for each SubEmitterEvent.
+    struct SubEmitter
+    {
+        ParticleSystem* m_child = nullptr;
+        int m_spawnCount = 0;
+        float m_inheritVelocity = 0;
+        float m_minImpactSpeed = 0;
+    };
+    SubEmitter m_deathSubEmitter;
+    SubEmitter m_collisionSubEmitter;
+
+    // Updates the sub-emitters' children, once each, after this system has written their requests.
+    void UpdateSubEmitters(float dt);
+
+    WindGrid* m_windGrid = nullptr;
+    CollisionMesh* m_collisionMesh = nullptr;
+
+    // Only created once the sleep module is used. Lists the awake particles each frame, after a header
+    // that is the indirect dispatch for the update, so sleeping particles cost no update work groups.
+    Material* m_particleSleepMat = nullptr;
+    GLuint m_awakeListBuffer = 0;
+
+    // Only created once the trail module is used, with room for m_trailBufferLength points per particle.
+    GLuint m_trailBuffer = 0;
+    int m_trailBufferLength = 0;
+    // Forgets every trail, so particles don't streak from where they were before.
+    void ClearTrails();
+
+    // Sleeping particles in this box wake up on the next Update. Starts out inside out, which wakes nothing.
+    glm::vec3 m_wakeMin = glm::vec3(1);
+    glm::vec3 m_wakeMax = glm::vec3(-1);
+
+    // Only created while events are enabled. The buffer starts with a count, followed by the events.
+    GLuint m_eventBuffer = 0;
+    GPUReadback* m_eventReadback = nullptr;
+    int m_maxEventsPerFrame = 0;
+    float m_eventImpactSpeed = 0;
+    int m_lastDroppedEventCopies = 0;
+
+    // Only created while bounds are enabled. Each work group writes a box to the partial buffer,
+    // then they are combined into the box in the bounds buffer.
+    Material* m_boundsMat = nullptr;
+    GLuint m_boundsPartialBuffer = 0;
+    GLuint m_boundsBuffer = 0;
+    GPUReadback* m_boundsReadback = nullptr;
+    ParticleBounds m_lastBounds;
+    bool m_hasBounds = false;
+
+    // Reduces the particles to the box in m_boundsBuffer, and starts copying it back.
+    void UpdateBounds();
+    // Picks up the newest box that has come back, without waiting.
+    void ReadBounds();
+
+    // Time simulated so far, and when each box in the readback ring was found, by copy number.
+    float m_simulatedTime = 0;
+    float m_lastDt = 0;
+    std::vector<float> m_boundsTimes;
+    float m_lastBoundsTime = 0;
+
+    // Set once SetView is called, the system is culled and LODed from then on.
+    bool m_viewSet = false;
+    bool m_visible = true;
+    float m_projectedSize = FLT_MAX;
+    float m_lodFraction = 1.f;
+    // Time missed while off screen, waiting to be caught up.
+    float m_skippedTime = 0;
+
+    // Largest value of the size curve, quads can be this many times particle size.
+    float m_maxLifetimeSize = 1.f;
+    // Box around the emitter mesh, relative to the system position. Both 0 without a mesh.
+    glm::vec3 m_emitterBoundsMin = glm::vec3(0);
+    glm::vec3 m_emitterBoundsMax = glm::vec3(0);
+
+    // Equal to m_maxParticles unless quality has been scaled down.
+    int m_particleLimit;
+
+    // Quotas from a ParticleBudget, 0 when the system isn't on one.
+    GLuint m_budgetBuffer = 0;
+    int m_budgetSlot = 0;
+
+    // Only created once the first query is made.
+    ParticleQueries* m_queries = nullptr;
+
+    // What the last Update saw, to tell when resting particles need waking.
+    glm::vec3 m_lastAcceleration = glm::vec3(0);
+    int m_lastCollisionMeshUpdate = 0;
+
+    // Spawn requests from a parent system, only created once this system is used as a child.
+    GLuint m_spawnRequestBuffer = 0;
+
+    // Emitter mesh corners and alias table, only created once a mesh is set.
+    int m_emitterTriangleCount = 0;
+    GLuint m_emitterTriangleBuffer = 0;
+    GLuint m_emitterAliasBuffer = 0;
 
     GLuint m_vertexBuffer;
 
+    // Force fields are kept on the CPU, and copied to the GPU when they change.
+    std::vector<ForceField> m_forceFields;
+    bool m_forceFieldsDirty = false;
+    GLuint m_forceFieldBuffer;
+    int m_forceFieldCapacity;
+
 };
\ No newline at end of file
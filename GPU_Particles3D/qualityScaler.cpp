@@ -0,0 +1,166 @@
+/*
+Title: GPU Simulated Particle System
+File Name: qualityScaler.cpp
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "qualityScaler.h"
+#include <algorithm>
+
+const QualityLevel QualityScaler::LEVELS[QualityScaler::LEVEL_COUNT] =
+{
+    { 1.f, 1.f, 1.f },
+    { .75f, .75f, 1.f },
+    { .5f, .5f, .75f },
+    { .35f, .35f, .75f },
+    { .25f, .25f, .5f }
+};
+
+QualityScaler::QualityScaler(float targetMilliseconds)
+{
+    m_targetMilliseconds = targetMilliseconds;
+    m_updateTimer = new GPUTimer(GPUTimer::DEFAULT_RING_SIZE);
+    m_drawTimer = new GPUTimer(GPUTimer::DEFAULT_RING_SIZE);
+}
+
+QualityScaler::~QualityScaler()
+{
+    while (!m_systems.empty())
+    {
+        Remove(m_systems.back());
+    }
+    delete m_updateTimer;
+    delete m_drawTimer;
+}
+
+void QualityScaler::Add(ParticleSystem* system)
+{
+    if (std::find(m_systems.begin(), m_systems.end(), system) == m_systems.end())
+    {
+        m_systems.push_back(system);
+        Apply();
+    }
+}
+
+void QualityScaler::Remove(ParticleSystem* system)
+{
+    auto it = std::find(m_systems.begin(), m_systems.end(), system);
+    if (it != m_systems.end())
+    {
+        system->SetParticleLimit(system->GetMaxParticles());
+        system->m_spawnScale = 1.f;
+        m_systems.erase(it);
+    }
+}
+
+void QualityScaler::BeginUpdate()
+{
+    m_updateTimer->Begin();
+}
+
+void QualityScaler::EndUpdate()
+{
+    m_updateTimer->End();
+}
+
+void QualityScaler::BeginDraw()
+{
+    m_drawTimer->Begin();
+}
+
+void QualityScaler::EndDraw()
+{
+    m_drawTimer->End();
+}
+
+void QualityScaler::Update()
+{
+    // The update of a frame always finishes before its draw, so each draw timing completes a frame.
+    float milliseconds;
+    while (m_updateTimer->ReadMilliseconds(milliseconds))
+    {
+        m_lastUpdateMilliseconds = milliseconds;
+    }
+    while (m_drawTimer->ReadMilliseconds(milliseconds))
+    {
+        float frame = m_lastUpdateMilliseconds + milliseconds;
+        m_milliseconds = m_milliseconds == 0 ? frame : m_milliseconds + (frame - m_milliseconds) * m_smoothing;
+
+        // Over the target: count towards dropping a level.
+        m_framesOver = m_milliseconds > m_targetMilliseconds * (1 + m_hysteresis) ? m_framesOver + 1 : 0;
+
+        // Time is mostly spent per particle, so guess what the next level up would cost.
+        // Only count towards raising quality if that still fits under the target with room to spare.
+        if (m_level > 0)
+        {
+            float raised = m_milliseconds * LEVELS[m_level - 1].m_particleFraction / LEVELS[m_level].m_particleFraction;
+            m_framesUnder = raised < m_targetMilliseconds * (1 - m_hysteresis) ? m_framesUnder + 1 : 0;
+        }
+
+        if (m_framesOver >= m_framesToLower && m_level < LEVEL_COUNT - 1)
+        {
+            SetLevel(m_level + 1);
+        }
+        else if (m_framesUnder >= m_framesToRaise && m_level > 0)
+        {
+            SetLevel(m_level - 1);
+        }
+    }
+}
+
+int QualityScaler::GetLevel()
+{
+    return m_level;
+}
+
+const QualityLevel& QualityScaler::GetQuality()
+{
+    return LEVELS[m_level];
+}
+
+float QualityScaler::GetRenderScale()
+{
+    return LEVELS[m_level].m_renderScale;
+}
+
+void QualityScaler::SetLevel(int level)
+{
+    level = glm::clamp(level, 0, LEVEL_COUNT - 1);
+
+    // Timings already on their way back were taken at the old level. Scale the smoothed time to match the
+    // new one, and start counting again, so they don't push the level straight past where it needs to be.
+    m_milliseconds *= LEVELS[level].m_particleFraction / LEVELS[m_level].m_particleFraction;
+    m_framesOver = 0;
+    m_framesUnder = 0;
+    m_level = level;
+    Apply();
+}
+
+float QualityScaler::GetMilliseconds()
+{
+    return m_milliseconds;
+}
+
+void QualityScaler::Apply()
+{
+    const QualityLevel& quality = LEVELS[m_level];
+    for (ParticleSystem* system : m_systems)
+    {
+        system->SetParticleLimit((int)(system->GetMaxParticles() * quality.m_particleFraction));
+        system->m_spawnScale = quality.m_spawnScale;
+    }
+}
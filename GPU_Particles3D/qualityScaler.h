@@ -0,0 +1,105 @@
+/*
+Title: GPU Simulated Particle System
+File Name: qualityScaler.h
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <vector>
+#include "GL/glew.h"
+#include "GLFW/glfw3.h"
+#include "gpuTimer.h"
+#include "particleSystem.h"
+
+// One step on the quality ladder.
+struct QualityLevel
+{
+    // Part of each system's pool that is allowed to be alive.
+    float m_particleFraction;
+    // Multiplies how many particles sub-emitters spawn.
+    float m_spawnScale;
+    // Part of the window resolution particles should be drawn at. The scaler can't change this by itself,
+    // whoever sets up the render target reads it from GetRenderScale.
+    float m_renderScale;
+};
+
+// Holds the GPU time spent on particles near a target by stepping quality down when it goes over, and back up
+// when there is room. Timings are read from GPUTimer rings a few frames late, so measuring never stalls.
+// Quality drops quickly and comes back slowly, and only comes back when the higher level is expected to fit
+// under the target with room to spare, so it settles instead of flipping between two levels.
+class QualityScaler
+{
+public:
+    static const int LEVEL_COUNT = 5;
+
+    // From full quality at 0, down to the lowest quality.
+    static const QualityLevel LEVELS[LEVEL_COUNT];
+
+    QualityScaler(float targetMilliseconds = 16.6f);
+    ~QualityScaler();
+
+    // Systems added here are scaled along with the quality level. Remove gives a system back its full pool.
+    void Add(ParticleSystem* system);
+    void Remove(ParticleSystem* system);
+
+    // Wrap these around the particle Updates and Draws each frame. They can't be nested inside other GPUTimers.
+    void BeginUpdate();
+    void EndUpdate();
+    void BeginDraw();
+    void EndDraw();
+
+    // Reads timings that have finished, and changes the quality level if they call for it. Call once per frame.
+    void Update();
+
+    // 0 is full quality, LEVEL_COUNT - 1 is the lowest.
+    int GetLevel();
+    const QualityLevel& GetQuality();
+    float GetRenderScale();
+    // Forces a level, for testing or a settings menu. The scaler keeps adjusting from there.
+    void SetLevel(int level);
+
+    // The smoothed update and draw time, in milliseconds. 0 until the first timing comes back.
+    float GetMilliseconds();
+
+    // GPU time per frame the particles should stay under.
+    float m_targetMilliseconds;
+
+    // How far past the target the time has to go before quality drops, and how far under
+    // the target the next level up has to be expected to stay before quality rises, as a fraction of the target.
+    float m_hysteresis = .1f;
+
+    // Frames in a row the time has to be over or under before quality changes.
+    int m_framesToLower = 10;
+    int m_framesToRaise = 60;
+
+    // How much each new timing moves the smoothed time.
+    float m_smoothing = .1f;
+
+private:
+    // Sets the particle limit and spawn scale of every system for the current level.
+    void Apply();
+
+    GPUTimer* m_updateTimer;
+    GPUTimer* m_drawTimer;
+    std::vector<ParticleSystem*> m_systems;
+
+    int m_level = 0;
+    float m_milliseconds = 0;
+    float m_lastUpdateMilliseconds = 0;
+    int m_framesOver = 0;
+    int m_framesUnder = 0;
+};
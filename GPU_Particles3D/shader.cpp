@@ -31,6 +31,11 @@ Shader::Shader(std::string filePath, GLenum shaderType)
     InitFromFile(filePath, shaderType);
 }
 
+Shader::Shader(std::string filePath, GLenum shaderType, std::string defines)
+{
+    InitFromFile(filePath, shaderType, defines);
+}
+
 Shader::~Shader()
 {
 	// Only delete the shader index if it was initialized successfully.
@@ -50,7 +55,7 @@ GLenum Shader::GetGLShaderType()
     return m_type;
 }
 
-bool Shader::InitFromFile(std::string filePath, GLenum shaderType)
+bool Shader::InitFromFile(std::string filePath, GLenum shaderType, std::string defines)
 {
 
 	std::ifstream file(filePath);
@@ -81,6 +86,24 @@ bool Shader::InitFromFile(std::string filePath, GLenum shaderType)
 	// Close the file.
 	file.close();
 
+	// #version has to be the first thing in a shader, so extra code goes on the line after it.
+	size_t version = shaderCode.find("#version");
+	if (!defines.empty() && version != std::string::npos)
+	{
+		size_t lineEnd = shaderCode.find('\n', version) + 1;
+
+		// #line keeps compile errors pointing at the right line of the file.
+		int line = 1;
+		for (size_t i = 0; i < lineEnd; i++)
+		{
+			if (shaderCode[i] == '\n')
+			{
+				line++;
+			}
+		}
+		shaderCode.insert(lineEnd, defines + "\n#line " + std::to_string(line) + "\n");
+	}
+
 	// Init using the string.
 	return InitFromString(shaderCode, shaderType);
 }
@@ -39,12 +39,16 @@ private:
 
 public:
 	Shader(std::string filePath, GLenum shaderType);
+
+	// Loads the file with extra lines of code (usually #defines) inserted right after the #version line.
+	// Lets one shader file be compiled into specialized versions.
+	Shader(std::string filePath, GLenum shaderType, std::string defines);
 	~Shader();
 
     GLuint GetGLShader();
     GLenum GetGLShaderType();
 
-	bool InitFromFile(std::string, GLenum shaderType);
+	bool InitFromFile(std::string, GLenum shaderType, std::string defines = "");
 	bool InitFromString(std::string shaderCode, GLenum shaderType);
 
     void IncRefCount();
@@ -57,6 +57,109 @@ Texture::Texture(char* filePath)
     FreeImage_Unload(bitmap32);
 }
 
+Texture::Texture(int width, int height, const float* pixels)
+{
+    glGenTextures(1, &m_texture);
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+
+    // Half floats are plenty for colors and sizes, and let values go above 1.
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, pixels);
+
+    // Blend between neighbouring values, and never wrap around from the end of life back to the start.
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Nearest filtering like the plain particle texture, and frames never bleed into each other.
+static void SetFlipbookParameters()
+{
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+Texture::Texture(const std::vector<std::string>& filePaths)
+{
+    m_target = GL_TEXTURE_2D_ARRAY;
+    m_layerCount = (int)filePaths.size();
+
+    glGenTextures(1, &m_texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_texture);
+
+    int width = 0;
+    int height = 0;
+    for (int layer = 0; layer < m_layerCount; layer++)
+    {
+        char* filePath = (char*)filePaths[layer].c_str();
+        FIBITMAP* bitmap = FreeImage_Load(FreeImage_GetFileType(filePath), filePath);
+        FIBITMAP* bitmap32 = FreeImage_ConvertTo32Bits(bitmap);
+
+        // The first frame decides how big every frame is.
+        if (layer == 0)
+        {
+            width = FreeImage_GetWidth(bitmap32);
+            height = FreeImage_GetHeight(bitmap32);
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, m_layerCount, 0, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+        }
+
+        if ((int)FreeImage_GetWidth(bitmap32) == width && (int)FreeImage_GetHeight(bitmap32) == height)
+        {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, GL_BGRA, GL_UNSIGNED_BYTE, FreeImage_GetBits(bitmap32));
+        }
+        else
+        {
+            std::cout << filePath << ": flipbook frames have to be the same size as the first one." << std::endl;
+        }
+
+        FreeImage_Unload(bitmap);
+        FreeImage_Unload(bitmap32);
+    }
+
+    SetFlipbookParameters();
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+Texture::Texture(char* filePath, int columns, int rows)
+{
+    m_target = GL_TEXTURE_2D_ARRAY;
+    m_layerCount = columns * rows;
+
+    FIBITMAP* bitmap = FreeImage_Load(FreeImage_GetFileType(filePath), filePath);
+    FIBITMAP* bitmap32 = FreeImage_ConvertTo32Bits(bitmap);
+    int width = FreeImage_GetWidth(bitmap32) / columns;
+    int height = FreeImage_GetHeight(bitmap32) / rows;
+
+    glGenTextures(1, &m_texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, m_layerCount, 0, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+
+    // Copy each frame straight out of the sheet, by telling GL how long the sheet's rows are and how much to skip.
+    // FreeImage keeps images bottom row first, so the top row of frames is at the end.
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, FreeImage_GetPitch(bitmap32) / 4);
+    for (int layer = 0; layer < m_layerCount; layer++)
+    {
+        int column = layer % columns;
+        int row = layer / columns;
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, column * width);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, (rows - 1 - row) * height);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, GL_BGRA, GL_UNSIGNED_BYTE, FreeImage_GetBits(bitmap32));
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+
+    SetFlipbookParameters();
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    FreeImage_Unload(bitmap);
+    FreeImage_Unload(bitmap32);
+}
+
 Texture::~Texture()
 {
     glDeleteTextures(1, &m_texture);
@@ -80,3 +183,13 @@ GLuint Texture::GetGLTexture()
 {
     return m_texture;
 }
+
+GLenum Texture::GetTarget()
+{
+    return m_target;
+}
+
+int Texture::GetLayerCount()
+{
+    return m_layerCount;
+}
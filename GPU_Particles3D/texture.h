@@ -26,6 +26,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "GLFW/glfw3.h"
 #include "FreeImage.h"
 #include <iostream>
+#include <string>
+#include <vector>
 
 class Texture
 {
@@ -33,11 +35,29 @@ private:
     GLuint m_texture;
     unsigned int m_refCount = 0;
 
+    // GL_TEXTURE_2D, or GL_TEXTURE_2D_ARRAY for flipbooks.
+    GLenum m_target = GL_TEXTURE_2D;
+    int m_layerCount = 1;
+
 public:
     Texture(char* filePath);
+
+    // Makes a texture out of RGBA float pixels, row by row. Filtered linearly, for lookup tables.
+    Texture(int width, int height, const float* pixels);
+
+    // Flipbooks: animation frames as the layers of a GL_TEXTURE_2D_ARRAY, so a whole animation is one texture.
+    // From a sequence of images, one frame each, which all have to be the same size as the first.
+    Texture(const std::vector<std::string>& filePaths);
+    // From a sheet of columns x rows equally sized frames, read left to right, top to bottom.
+    Texture(char* filePath, int columns, int rows);
+
     ~Texture();
     void IncRefCount();
     void DecRefCount();
     GLuint GetGLTexture();
+    // What the texture has to be bound to.
+    GLenum GetTarget();
+    // Frames in a flipbook, 1 for a plain texture.
+    int GetLayerCount();
 
 };
\ No newline at end of file
@@ -0,0 +1,201 @@
+/*
+Title: GPU Simulated Particle System
+File Name: windGrid.cpp
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "windGrid.h"
+#include <algorithm>
+
+// Stages of windGrid.glsl
+static const int STAGE_FORCES = 0;
+static const int STAGE_ADVECT = 1;
+static const int STAGE_DIVERGENCE = 2;
+static const int STAGE_PRESSURE = 3;
+static const int STAGE_PROJECT = 4;
+
+// Makes a 3D texture for one of the grid's values, starting out at 0.
+static GLuint CreateGridTexture(int resolution, GLenum format)
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_3D, texture);
+    glTexStorage3D(GL_TEXTURE_3D, 1, format, resolution, resolution, resolution);
+
+    // Linear filtering is what gives particles and advection trilinear interpolation for free.
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+    // Start out still. glClearTexImage would be simpler, but needs GL 4.4.
+    std::vector<float> zeros(resolution * resolution * resolution * 4, 0.f);
+    glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, resolution, resolution, resolution, GL_RGBA, GL_FLOAT, zeros.data());
+    glBindTexture(GL_TEXTURE_3D, 0);
+    return texture;
+}
+
+WindGrid::WindGrid(glm::vec3 boundsMin, glm::vec3 boundsMax, int resolution)
+{
+    m_boundsMin = boundsMin;
+    m_boundsMax = boundsMax;
+    m_resolution = resolution;
+
+    ShaderProgram* program = new ShaderProgram();
+    program->AttachShader(new Shader("../Assets/windGrid.glsl", GL_COMPUTE_SHADER));
+    m_windMat = new Material(program);
+
+    for (int i = 0; i < 2; i++)
+    {
+        m_velocityTextures[i] = CreateGridTexture(resolution, GL_RGBA32F);
+        m_pressureTextures[i] = CreateGridTexture(resolution, GL_R32F);
+    }
+    m_divergenceTexture = CreateGridTexture(resolution, GL_R32F);
+
+    // Three ints for every cell, starting out empty.
+    int cellCount = resolution * resolution * resolution;
+    glGenBuffers(1, &m_splatBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_splatBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, cellCount * 3 * sizeof(GLint), nullptr, GL_DYNAMIC_COPY);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32I, GL_RED_INTEGER, GL_INT, nullptr);
+
+    // Room for a few impulses, this grows if more are added.
+    m_impulseCapacity = 8;
+    glGenBuffers(1, &m_impulseBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_impulseBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, m_impulseCapacity * 2 * sizeof(glm::vec4), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+WindGrid::~WindGrid()
+{
+    glDeleteTextures(2, m_velocityTextures);
+    glDeleteTextures(2, m_pressureTextures);
+    glDeleteTextures(1, &m_divergenceTexture);
+    glDeleteBuffers(1, &m_splatBuffer);
+    glDeleteBuffers(1, &m_impulseBuffer);
+    delete m_windMat;
+}
+
+void WindGrid::AddImpulse(glm::vec3 position, glm::vec3 velocity, float radius)
+{
+    m_impulses.push_back(glm::vec4(position, radius));
+    m_impulses.push_back(glm::vec4(velocity, 0));
+}
+
+GLuint WindGrid::GetVelocityTexture()
+{
+    return m_velocityTextures[0];
+}
+
+GLuint WindGrid::GetSplatBuffer()
+{
+    return m_splatBuffer;
+}
+
+glm::vec3 WindGrid::GetBoundsMin()
+{
+    return m_boundsMin;
+}
+
+glm::vec3 WindGrid::GetBoundsMax()
+{
+    return m_boundsMax;
+}
+
+int WindGrid::GetResolution()
+{
+    return m_resolution;
+}
+
+void WindGrid::Dispatch(int stage)
+{
+    int workGroups = (m_resolution + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE;
+    m_windMat->SetInt((char*)"stage", stage);
+    m_windMat->Bind();
+    glDispatchCompute(workGroups, workGroups, workGroups);
+    m_windMat->Unbind();
+}
+
+void WindGrid::Update(float dt)
+{
+    // Copy this frame's impulses to the GPU, making the buffer bigger if they don't fit.
+    int impulseCount = (int)m_impulses.size() / 2;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_impulseBuffer);
+    if (impulseCount > m_impulseCapacity)
+    {
+        m_impulseCapacity = impulseCount * 2;
+        glBufferData(GL_SHADER_STORAGE_BUFFER, m_impulseCapacity * 2 * sizeof(glm::vec4), nullptr, GL_DYNAMIC_DRAW);
+    }
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_impulses.size() * sizeof(glm::vec4), m_impulses.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    m_impulses.clear();
+
+    m_windMat->SetFloat((char*)"dt", dt);
+    m_windMat->SetInt((char*)"resolution", m_resolution);
+    m_windMat->SetVec3((char*)"cellSize", (m_boundsMax - m_boundsMin) / (float)m_resolution);
+    m_windMat->SetVec3((char*)"boundsMin", m_boundsMin);
+    m_windMat->SetFloat((char*)"dissipation", m_dissipation);
+    m_windMat->SetInt((char*)"impulseCount", impulseCount);
+
+    // Particles wrote their momentum to the splat buffer last frame.
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // 0. Forces, in place.
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_splatBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_impulseBuffer);
+    glBindImageTexture(1, m_velocityTextures[0], 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA32F);
+    Dispatch(STAGE_FORCES);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    // 1. Advect from the current velocity into the other texture, which then becomes current.
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_3D, m_velocityTextures[0]);
+    glBindImageTexture(1, m_velocityTextures[1], 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    Dispatch(STAGE_ADVECT);
+    glBindTexture(GL_TEXTURE_3D, 0);
+    std::swap(m_velocityTextures[0], m_velocityTextures[1]);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    // 2. Divergence
+    glBindImageTexture(0, m_velocityTextures[0], 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA32F);
+    glBindImageTexture(4, m_divergenceTexture, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32F);
+    Dispatch(STAGE_DIVERGENCE);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    // 3. Pressure. Starts from last frame's pressure, which is usually close already.
+    for (int i = 0; i < m_pressureIterations; i++)
+    {
+        glBindImageTexture(2, m_pressureTextures[0], 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32F);
+        glBindImageTexture(3, m_pressureTextures[1], 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R32F);
+        Dispatch(STAGE_PRESSURE);
+        std::swap(m_pressureTextures[0], m_pressureTextures[1]);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+
+    // 4. Project, in place.
+    glBindImageTexture(1, m_velocityTextures[0], 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA32F);
+    glBindImageTexture(2, m_pressureTextures[0], 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32F);
+    Dispatch(STAGE_PROJECT);
+
+    // Particles sample the velocity as a texture.
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
@@ -0,0 +1,86 @@
+/*
+Title: GPU Simulated Particle System
+File Name: windGrid.h
+Copyright ? 2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+#include <vector>
+#include "GL/glew.h"
+#include "GLFW/glfw3.h"
+#include "glm/gtc/matrix_transform.hpp"
+#include "material.h"
+
+// A coarse grid of moving air, simulated with stable fluids in compute shaders (see windGrid.glsl).
+// Particle systems with a wind grid are carried along by it, and can push the air back.
+// Large scale swirling motion then costs one fixed size grid update, no matter how many particles there are.
+class WindGrid
+{
+public:
+    // Must match WORK_GROUP_SIZE in windGrid.glsl. Work groups are this many cells along each axis.
+    static const int WORK_GROUP_SIZE = 4;
+
+    // The grid covers the box between boundsMin and boundsMax with resolution cells along each side.
+    WindGrid(glm::vec3 boundsMin, glm::vec3 boundsMax, int resolution = 64);
+    ~WindGrid();
+
+    // Pushes the air around position during the next Update, fading out to nothing at the radius.
+    void AddImpulse(glm::vec3 position, glm::vec3 velocity, float radius);
+
+    // Adds impulses and momentum from particles, moves the air along, and keeps it from compressing.
+    // Update the grid before the particle systems that use it.
+    void Update(float dt);
+
+    // Velocity of the air at every cell center, an RGBA32F 3D texture (w is unused).
+    GLuint GetVelocityTexture();
+
+    // Particles add momentum to this buffer as fixed point ints, 3 per cell. The next Update adds it to the air.
+    GLuint GetSplatBuffer();
+
+    glm::vec3 GetBoundsMin();
+    glm::vec3 GetBoundsMax();
+    int GetResolution();
+
+    // Fraction of the velocity the air loses every second.
+    float m_dissipation = .5f;
+
+    // More iterations remove more of the compression, 20 is plenty for wind.
+    int m_pressureIterations = 20;
+
+private:
+    void Dispatch(int stage);
+
+    glm::vec3 m_boundsMin;
+    glm::vec3 m_boundsMax;
+    int m_resolution;
+
+    Material* m_windMat;
+
+    // Velocity and pressure are ping-ponged between two textures, the first one is current.
+    GLuint m_velocityTextures[2];
+    GLuint m_pressureTextures[2];
+    GLuint m_divergenceTexture;
+
+    GLuint m_splatBuffer;
+
+    // Impulses are collected on the CPU, and copied to the GPU every Update.
+    // Each one is a position (w: radius) and a velocity.
+    std::vector<glm::vec4> m_impulses;
+    GLuint m_impulseBuffer;
+    int m_impulseCapacity;
+};
@@ -0,0 +1,93 @@
+/*
+Title: GPU Simulated Particle System
+File Name: barnesHutBounds.glsl
+Copyright  2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Compute shaders are part of openGL core since version 4.3
+#version 430
+
+// Must match BarnesHut::WORK_GROUP_SIZE
+#define WORK_GROUP_SIZE 256
+
+uniform int particleCount;
+
+// A basic definition of what our vertex data looks like.
+struct VertexData
+{
+    vec4 position;
+    vec4 velocity;
+    float rotation;
+    float angularVelocity;
+    float age;
+};
+
+layout(binding = 0) buffer block
+{
+	VertexData data[];
+} particles;
+
+// Min xyz followed by max xyz, stored as sortable uints so they can be combined with atomics.
+layout(binding = 1) buffer boundsBlock
+{
+	uint bounds[6];
+};
+
+shared vec3 sharedMin[WORK_GROUP_SIZE];
+shared vec3 sharedMax[WORK_GROUP_SIZE];
+
+// Maps a float to a uint that sorts in the same order, so atomicMin and atomicMax work on it.
+uint FloatToSortable(float f)
+{
+	uint u = floatBitsToUint(f);
+	return (u & 0x80000000u) != 0 ? ~u : u | 0x80000000u;
+}
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+void main()
+{
+	uint i = gl_GlobalInvocationID.x;
+	uint local = gl_LocalInvocationID.x;
+
+	// Invocations past the end use the first particle, which doesn't change the result.
+	vec3 position = particles.data[i < uint(particleCount) ? i : 0].position.xyz;
+	sharedMin[local] = position;
+	sharedMax[local] = position;
+	barrier();
+
+	// Reduce the work group down to one box, halving the number of active invocations each step.
+	for (uint stride = WORK_GROUP_SIZE / 2; stride > 0; stride /= 2)
+	{
+		if (local < stride)
+		{
+			sharedMin[local] = min(sharedMin[local], sharedMin[local + stride]);
+			sharedMax[local] = max(sharedMax[local], sharedMax[local + stride]);
+		}
+		barrier();
+	}
+
+	// One invocation per work group merges the result into the global box.
+	if (local == 0)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			atomicMin(bounds[axis], FloatToSortable(sharedMin[0][axis]));
+			atomicMax(bounds[axis + 3], FloatToSortable(sharedMax[0][axis]));
+		}
+	}
+}
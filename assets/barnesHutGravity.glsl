@@ -0,0 +1,124 @@
+/*
+Title: GPU Simulated Particle System
+File Name: barnesHutGravity.glsl
+Copyright  2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Compute shaders are part of openGL core since version 4.3
+#version 430
+
+// Must match BarnesHut::WORK_GROUP_SIZE
+#define WORK_GROUP_SIZE 256
+
+// Deep enough for any tree built from 30 bit morton codes and a few million particles.
+#define STACK_SIZE 64
+
+uniform int particleCount;
+uniform vec3 acceleration;
+uniform float dt;
+uniform float softening;
+
+// A node is treated as a single mass once (node size / distance) is less than this.
+// 0 visits every leaf, larger values are faster but less accurate.
+uniform float openingAngle;
+
+// A basic definition of what our vertex data looks like.
+struct VertexData
+{
+    vec4 position;
+    vec4 velocity;
+    float rotation;
+    float angularVelocity;
+    float age;
+};
+
+struct Node
+{
+	vec4 centerOfMass;
+	vec4 boundsMin;
+	vec4 boundsMax;
+};
+
+layout(binding = 0) buffer block
+{
+	VertexData data[];
+} particles;
+
+layout(binding = 1) buffer valueBlock
+{
+	uint values[];
+};
+
+layout(binding = 2) buffer childBlock
+{
+	ivec2 children[];
+};
+
+layout(binding = 3) buffer nodeBlock
+{
+	Node nodes[];
+};
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+void main()
+{
+	// Invocations handle particles in sorted order, so neighbouring invocations
+	// are close together in space and walk mostly the same part of the tree.
+	uint sorted = gl_GlobalInvocationID.x;
+	if (sorted >= uint(particleCount))
+	{
+		return;
+	}
+	uint i = values[sorted];
+
+	vec3 position = particles.data[i].position.xyz;
+	vec3 gravity = vec3(0);
+	float softeningSquared = softening * softening;
+	float openingAngleSquared = openingAngle * openingAngle;
+
+	int stack[STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		int node = stack[--stackSize];
+		vec4 centerOfMass = nodes[node].centerOfMass;
+		vec3 r = centerOfMass.xyz - position;
+		float distanceSquared = dot(r, r);
+
+		vec3 extent = nodes[node].boundsMax.xyz - nodes[node].boundsMin.xyz;
+		float size = max(extent.x, max(extent.y, extent.z));
+
+		// Leaves are always used directly. Internal nodes are used as a single mass if they are small or far enough away.
+		// The particle itself is one of the leaves, but r is zero, so it adds nothing.
+		bool isLeaf = node >= particleCount - 1;
+		if (isLeaf || size * size < openingAngleSquared * distanceSquared || stackSize > STACK_SIZE - 2)
+		{
+			float invDistance = inversesqrt(distanceSquared + softeningSquared);
+			gravity += r * (centerOfMass.w * invDistance * invDistance * invDistance);
+		}
+		else
+		{
+			stack[stackSize++] = children[node].x;
+			stack[stackSize++] = children[node].y;
+		}
+	}
+
+	particles.data[i].velocity += vec4(gravity + acceleration, 0) * dt;
+}
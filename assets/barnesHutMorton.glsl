@@ -0,0 +1,107 @@
+/*
+Title: GPU Simulated Particle System
+File Name: barnesHutMorton.glsl
+Copyright  2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Compute shaders are part of openGL core since version 4.3
+#version 430
+
+// Must match BarnesHut::WORK_GROUP_SIZE
+#define WORK_GROUP_SIZE 256
+
+uniform int particleCount;
+
+// A basic definition of what our vertex data looks like.
+struct VertexData
+{
+    vec4 position;
+    vec4 velocity;
+    float rotation;
+    float angularVelocity;
+    float age;
+};
+
+layout(binding = 0) buffer block
+{
+	VertexData data[];
+} particles;
+
+// Written by barnesHutBounds.glsl
+layout(binding = 1) buffer boundsBlock
+{
+	uint bounds[6];
+};
+
+// Morton code of each particle, and the index of the particle it belongs to.
+// Both arrays are padded to a power of two for the sort.
+layout(binding = 2) buffer keyBlock
+{
+	uint keys[];
+};
+
+layout(binding = 3) buffer valueBlock
+{
+	uint values[];
+};
+
+float SortableToFloat(uint u)
+{
+	return uintBitsToFloat((u & 0x80000000u) != 0 ? u & 0x7FFFFFFFu : ~u);
+}
+
+// Spreads the lower 10 bits of v out so there are two zeros between each bit.
+uint ExpandBits(uint v)
+{
+	v = (v * 0x00010001u) & 0xFF0000FFu;
+	v = (v * 0x00000101u) & 0x0F00F00Fu;
+	v = (v * 0x00000011u) & 0xC30C30C3u;
+	v = (v * 0x00000005u) & 0x49249249u;
+	return v;
+}
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+void main()
+{
+	uint i = gl_GlobalInvocationID.x;
+	if (i >= keys.length())
+	{
+		return;
+	}
+
+	// Padding sorts to the end, after every real particle.
+	if (i >= uint(particleCount))
+	{
+		keys[i] = 0xFFFFFFFFu;
+		values[i] = i;
+		return;
+	}
+
+	vec3 boundsMin = vec3(SortableToFloat(bounds[0]), SortableToFloat(bounds[1]), SortableToFloat(bounds[2]));
+	vec3 boundsMax = vec3(SortableToFloat(bounds[3]), SortableToFloat(bounds[4]), SortableToFloat(bounds[5]));
+	vec3 extent = max(boundsMax - boundsMin, vec3(1e-6));
+
+	// Quantize the position to a 1024^3 grid inside the bounds.
+	vec3 normalized = (particles.data[i].position.xyz - boundsMin) / extent;
+	uvec3 cell = uvec3(clamp(normalized * 1024.0, vec3(0), vec3(1023)));
+
+	// Interleaving the bits of x, y and z puts particles that are close in space close together in the sorted order.
+	// Every 3 bits of the code picks one octant of an octree.
+	keys[i] = ExpandBits(cell.x) * 4 + ExpandBits(cell.y) * 2 + ExpandBits(cell.z);
+	values[i] = i;
+}
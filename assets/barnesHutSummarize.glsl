@@ -0,0 +1,122 @@
+/*
+Title: GPU Simulated Particle System
+File Name: barnesHutSummarize.glsl
+Copyright  2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Compute shaders are part of openGL core since version 4.3
+#version 430
+
+// Must match BarnesHut::WORK_GROUP_SIZE
+#define WORK_GROUP_SIZE 256
+
+uniform int particleCount;
+uniform float particleMass;
+
+// A basic definition of what our vertex data looks like.
+struct VertexData
+{
+    vec4 position;
+    vec4 velocity;
+    float rotation;
+    float angularVelocity;
+    float age;
+};
+
+// Center of mass (in xyz, total mass in w), and bounding box of everything under a node.
+struct Node
+{
+	vec4 centerOfMass;
+	vec4 boundsMin;
+	vec4 boundsMax;
+};
+
+layout(binding = 0) buffer block
+{
+	VertexData data[];
+} particles;
+
+// Particle index of each leaf, in sorted order.
+layout(binding = 1) buffer valueBlock
+{
+	uint values[];
+};
+
+layout(binding = 2) buffer childBlock
+{
+	ivec2 children[];
+};
+
+layout(binding = 3) buffer parentBlock
+{
+	int parents[];
+};
+
+// Other invocations read nodes while they are being written, so they can't be cached.
+layout(binding = 4) coherent buffer nodeBlock
+{
+	Node nodes[];
+};
+
+// Counts how many children of each internal node are finished. Cleared to 0 before this runs.
+layout(binding = 5) buffer flagBlock
+{
+	uint flags[];
+};
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+void main()
+{
+	int leaf = int(gl_GlobalInvocationID.x);
+	if (leaf >= particleCount)
+	{
+		return;
+	}
+
+	// Fill in the leaf with its particle.
+	int node = particleCount - 1 + leaf;
+	vec3 position = particles.data[values[leaf]].position.xyz;
+	nodes[node].centerOfMass = vec4(position, particleMass);
+	nodes[node].boundsMin = vec4(position, 0);
+	nodes[node].boundsMax = vec4(position, 0);
+
+	// Walk up the tree. The first child to arrive at a node stops, and the second one
+	// fills it in, because only then are both children guaranteed to be finished.
+	node = parents[node];
+	while (node >= 0)
+	{
+		// Make sure everything written so far is visible before telling the other child.
+		memoryBarrierBuffer();
+		if (atomicAdd(flags[node], 1) == 0)
+		{
+			return;
+		}
+
+		Node left = nodes[children[node].x];
+		Node right = nodes[children[node].y];
+
+		float mass = left.centerOfMass.w + right.centerOfMass.w;
+		vec3 center = (left.centerOfMass.xyz * left.centerOfMass.w + right.centerOfMass.xyz * right.centerOfMass.w) / mass;
+
+		nodes[node].centerOfMass = vec4(center, mass);
+		nodes[node].boundsMin = min(left.boundsMin, right.boundsMin);
+		nodes[node].boundsMax = max(left.boundsMax, right.boundsMax);
+
+		node = parents[node];
+	}
+}
@@ -0,0 +1,137 @@
+/*
+Title: GPU Simulated Particle System
+File Name: bitonicSort.glsl
+Copyright  2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Compute shaders are part of openGL core since version 4.3
+#version 430
+
+// Each invocation compares one pair, so a work group covers twice this many elements.
+// Must match BitonicSort::WORK_GROUP_SIZE
+#define WORK_GROUP_SIZE 256
+#define BLOCK_SIZE (WORK_GROUP_SIZE * 2)
+
+// Size of the sequences currently being merged, and the distance between compared elements.
+uniform int k;
+uniform int j;
+
+// 0: one compare and swap step across the whole buffer, for steps where j is too large to fit in shared memory.
+// 1: every step from j down to 1, done in shared memory.
+// 2: the whole sort up to k = BLOCK_SIZE, done in shared memory. This is always the first pass.
+uniform int mode;
+
+// Keys are sorted, and values are moved along with them.
+// The length has to be a power of two, and at least BLOCK_SIZE.
+layout(binding = 0) buffer keyBlock
+{
+	uint keys[];
+};
+
+layout(binding = 1) buffer valueBlock
+{
+	uint values[];
+};
+
+shared uint sharedKeys[BLOCK_SIZE];
+shared uint sharedValues[BLOCK_SIZE];
+
+// Ties are broken by value, so the result is the same every time, no matter the order things started in.
+bool OutOfOrder(uint keyA, uint valueA, uint keyB, uint valueB)
+{
+	return keyA > keyB || (keyA == keyB && valueA > valueB);
+}
+
+// Compares and swaps one pair in shared memory.
+void LocalStep(uint pair, uint blockStart, uint sequence, uint distance)
+{
+	uint a = 2 * distance * (pair / distance) + (pair % distance);
+	uint b = a + distance;
+
+	// Sequences alternate between ascending and descending so they can be merged by the next step.
+	bool ascending = ((blockStart + a) & sequence) == 0;
+
+	if (OutOfOrder(sharedKeys[a], sharedValues[a], sharedKeys[b], sharedValues[b]) == ascending)
+	{
+		uint key = sharedKeys[a];
+		uint value = sharedValues[a];
+		sharedKeys[a] = sharedKeys[b];
+		sharedValues[a] = sharedValues[b];
+		sharedKeys[b] = key;
+		sharedValues[b] = value;
+	}
+}
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+void main()
+{
+	uint pair = gl_GlobalInvocationID.x;
+
+	if (mode == 0)
+	{
+		uint distance = uint(j);
+		uint a = 2 * distance * (pair / distance) + (pair % distance);
+		uint b = a + distance;
+		bool ascending = (a & uint(k)) == 0;
+
+		if (OutOfOrder(keys[a], values[a], keys[b], values[b]) == ascending)
+		{
+			uint key = keys[a];
+			uint value = values[a];
+			keys[a] = keys[b];
+			values[a] = values[b];
+			keys[b] = key;
+			values[b] = value;
+		}
+		return;
+	}
+
+	// Load this work group's block into shared memory.
+	uint local = gl_LocalInvocationID.x;
+	uint blockStart = gl_WorkGroupID.x * BLOCK_SIZE;
+	sharedKeys[local] = keys[blockStart + local];
+	sharedValues[local] = values[blockStart + local];
+	sharedKeys[local + WORK_GROUP_SIZE] = keys[blockStart + local + WORK_GROUP_SIZE];
+	sharedValues[local + WORK_GROUP_SIZE] = values[blockStart + local + WORK_GROUP_SIZE];
+	barrier();
+
+	if (mode == 1)
+	{
+		for (uint distance = uint(j); distance > 0; distance /= 2)
+		{
+			LocalStep(local, blockStart, uint(k), distance);
+			barrier();
+		}
+	}
+	else
+	{
+		for (uint sequence = 2; sequence <= BLOCK_SIZE; sequence *= 2)
+		{
+			for (uint distance = sequence / 2; distance > 0; distance /= 2)
+			{
+				LocalStep(local, blockStart, sequence, distance);
+				barrier();
+			}
+		}
+	}
+
+	keys[blockStart + local] = sharedKeys[local];
+	values[blockStart + local] = sharedValues[local];
+	keys[blockStart + local + WORK_GROUP_SIZE] = sharedKeys[local + WORK_GROUP_SIZE];
+	values[blockStart + local + WORK_GROUP_SIZE] = sharedValues[local + WORK_GROUP_SIZE];
+}
@@ -0,0 +1,97 @@
+/*
+Title: GPU Simulated Particle System
+File Name: bvhLinks.glsl
+Copyright  2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Compute shaders are part of openGL core since version 4.3
+#version 430
+
+// Must match CollisionMesh::WORK_GROUP_SIZE
+#define WORK_GROUP_SIZE 256
+
+// Fills in the links that let particles walk the BVH without a stack.
+// Walking the tree in order, every node has two ways out: into its first child if the particle hits its box,
+// and past the whole subtree if it misses. These only depend on the shape of the tree, so they are found once, after it is built.
+uniform int leafCount;
+
+// Must match CollisionNode in collisionMesh.h and compute.glsl
+struct Node
+{
+	vec3 boundsMin;
+	int first;          // Internal nodes: left child. Leaves: ~triangle index.
+	vec3 boundsMax;
+	int miss;           // Next node once this subtree is done, -1 at the end.
+};
+
+// Written by radixTree.glsl
+layout(binding = 0) buffer childBlock
+{
+	ivec2 children[];
+};
+
+layout(binding = 1) buffer parentBlock
+{
+	int parents[];
+};
+
+// Triangle index of each leaf, in sorted order.
+layout(binding = 2) buffer valueBlock
+{
+	uint values[];
+};
+
+layout(binding = 3) buffer nodeBlock
+{
+	Node nodes[];
+};
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+void main()
+{
+	int node = int(gl_GlobalInvocationID.x);
+	if (node >= 2 * leafCount - 1)
+	{
+		return;
+	}
+
+	if (node < leafCount - 1)
+	{
+		nodes[node].first = children[node].x;
+	}
+	else
+	{
+		nodes[node].first = ~int(values[node - (leafCount - 1)]);
+	}
+
+	// After this subtree comes the right sibling of the closest ancestor that is a left child.
+	// If there isn't one, this subtree is at the right edge of the tree, and nothing comes after it.
+	int miss = -1;
+	int current = node;
+	while (parents[current] >= 0)
+	{
+		int parent = parents[current];
+		if (children[parent].x == current)
+		{
+			miss = children[parent].y;
+			break;
+		}
+		current = parent;
+	}
+	nodes[node].miss = miss;
+}
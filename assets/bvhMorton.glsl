@@ -0,0 +1,86 @@
+/*
+Title: GPU Simulated Particle System
+File Name: bvhMorton.glsl
+Copyright  2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Compute shaders are part of openGL core since version 4.3
+#version 430
+
+// Must match CollisionMesh::WORK_GROUP_SIZE
+#define WORK_GROUP_SIZE 256
+
+uniform int triangleCount;
+
+// Bounding box of the triangle centers.
+uniform vec3 boundsMin;
+uniform vec3 boundsSize;
+
+// Three corners for every triangle.
+layout(binding = 0) buffer triangleBlock
+{
+	vec4 vertices[];
+};
+
+// Morton code of each triangle's center, and the index of the triangle it belongs to.
+// Both arrays are padded to a power of two for the sort.
+layout(binding = 1) buffer keyBlock
+{
+	uint keys[];
+};
+
+layout(binding = 2) buffer valueBlock
+{
+	uint values[];
+};
+
+// Spreads the lower 10 bits of v out so there are two zeros between each bit.
+uint ExpandBits(uint v)
+{
+	v = (v * 0x00010001u) & 0xFF0000FFu;
+	v = (v * 0x00000101u) & 0x0F00F00Fu;
+	v = (v * 0x00000011u) & 0xC30C30C3u;
+	v = (v * 0x00000005u) & 0x49249249u;
+	return v;
+}
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+void main()
+{
+	uint i = gl_GlobalInvocationID.x;
+	if (i >= keys.length())
+	{
+		return;
+	}
+
+	// Padding sorts to the end, after every real triangle.
+	if (i >= uint(triangleCount))
+	{
+		keys[i] = 0xFFFFFFFFu;
+		values[i] = i;
+		return;
+	}
+
+	// Quantize the center to a 1024^3 grid inside the bounds, then interleave the bits,
+	// so triangles that are close in space end up close together in the sorted order.
+	vec3 center = (vertices[i * 3].xyz + vertices[i * 3 + 1].xyz + vertices[i * 3 + 2].xyz) / 3;
+	vec3 normalized = (center - boundsMin) / max(boundsSize, vec3(1e-6));
+	uvec3 cell = uvec3(clamp(normalized * 1024.0, vec3(0), vec3(1023)));
+	keys[i] = ExpandBits(cell.x) * 4 + ExpandBits(cell.y) * 2 + ExpandBits(cell.z);
+	values[i] = i;
+}
@@ -0,0 +1,111 @@
+/*
+Title: GPU Simulated Particle System
+File Name: bvhRefit.glsl
+Copyright  2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Compute shaders are part of openGL core since version 4.3
+#version 430
+
+// Must match CollisionMesh::WORK_GROUP_SIZE
+#define WORK_GROUP_SIZE 256
+
+// Fits every box in the BVH around the triangles under it, from the leaves up.
+// This runs after the tree is built, and again every time the mesh moves, without changing the shape of the tree.
+uniform int leafCount;
+
+// Must match CollisionNode in collisionMesh.h and compute.glsl
+struct Node
+{
+	vec3 boundsMin;
+	int first;
+	vec3 boundsMax;
+	int miss;
+};
+
+// Three corners for every triangle.
+layout(binding = 0) buffer triangleBlock
+{
+	vec4 vertices[];
+};
+
+layout(binding = 1) buffer valueBlock
+{
+	uint values[];
+};
+
+layout(binding = 2) buffer childBlock
+{
+	ivec2 children[];
+};
+
+layout(binding = 3) buffer parentBlock
+{
+	int parents[];
+};
+
+// Other invocations read nodes while they are being written, so they can't be cached.
+layout(binding = 4) coherent buffer nodeBlock
+{
+	Node nodes[];
+};
+
+// Counts how many children of each internal node are finished. Cleared to 0 before this runs.
+layout(binding = 5) buffer flagBlock
+{
+	uint flags[];
+};
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+void main()
+{
+	int leaf = int(gl_GlobalInvocationID.x);
+	if (leaf >= leafCount)
+	{
+		return;
+	}
+
+	// Fit the leaf around its triangle.
+	int node = leafCount - 1 + leaf;
+	uint triangle = values[leaf];
+	vec3 a = vertices[triangle * 3].xyz;
+	vec3 b = vertices[triangle * 3 + 1].xyz;
+	vec3 c = vertices[triangle * 3 + 2].xyz;
+	nodes[node].boundsMin = min(a, min(b, c));
+	nodes[node].boundsMax = max(a, max(b, c));
+
+	// Walk up the tree. The first child to arrive at a node stops, and the second one
+	// fills it in, because only then are both children guaranteed to be finished.
+	node = parents[node];
+	while (node >= 0)
+	{
+		// Make sure everything written so far is visible before telling the other child.
+		memoryBarrierBuffer();
+		if (atomicAdd(flags[node], 1) == 0)
+		{
+			return;
+		}
+
+		int left = children[node].x;
+		int right = children[node].y;
+		nodes[node].boundsMin = min(nodes[left].boundsMin, nodes[right].boundsMin);
+		nodes[node].boundsMax = max(nodes[left].boundsMax, nodes[right].boundsMax);
+
+		node = parents[node];
+	}
+}
@@ -0,0 +1,79 @@
+/*
+Title: GPU Simulated Particle System
+File Name: compact.glsl
+Copyright  2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Compute shaders are part of openGL core since version 4.3
+#version 430
+
+// Must match ParallelPrimitives::WORK_GROUP_SIZE
+#define WORK_GROUP_SIZE 256
+
+// Number of elements being compacted.
+uniform int count;
+
+layout(binding = 0) buffer inputBlock
+{
+	uint inputs[];
+};
+
+// 1 for elements that are kept, 0 for ones that are dropped.
+layout(binding = 1) buffer flagBlock
+{
+	uint flags[];
+};
+
+// Exclusive scan of the flags, which is where each kept element goes.
+layout(binding = 2) buffer offsetBlock
+{
+	uint offsets[];
+};
+
+layout(binding = 3) buffer outputBlock
+{
+	uint outputs[];
+};
+
+// Number of elements kept.
+layout(binding = 4) buffer countBlock
+{
+	uint keptCount;
+};
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+void main()
+{
+	uint i = gl_GlobalInvocationID.x;
+	if (i >= uint(count))
+	{
+		return;
+	}
+
+	if (flags[i] != 0)
+	{
+		outputs[offsets[i]] = inputs[i];
+	}
+
+	// Everything before the last element, plus the last element if it is kept.
+	if (i == uint(count) - 1)
+	{
+		keptCount = offsets[i] + flags[i];
+	}
+}
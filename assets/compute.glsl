@@ -25,12 +25,143 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 // Compute shaders are part of openGL core since version 4.3
 #version 430
 
+// This file holds every particle behaviour. The particle system compiles it with a MODULE_ #define for each
+// behaviour it uses (see particleModules.h), so anything it doesn't use isn't in the program at all.
+// Constants like DAMPING_RATE are also compiled in, instead of being uniforms.
+// Parameters that don't change while an effect runs can be compiled in the same way: when BURN_RATE
+// is defined, burnRate becomes a constant instead of a uniform, and so on.
+
+
+// Must match ParticleSystem::WORK_GROUP_SIZE
+#define WORK_GROUP_SIZE 256
+
+// The most force fields one work group can keep after culling.
+#define MAX_GROUP_FORCE_FIELDS 256
+
+// Force field types, must match ForceFieldType.
+#define FORCE_ATTRACTOR 0
+#define FORCE_VORTEX 1
+#define FORCE_DRAG 2
+
+// Particle event types, must match ParticleEventType.
+#define EVENT_DEATH 0
+#define EVENT_COLLISION 1
+
+// Particles splat momentum into the wind grid as fixed point integers, because there are no float atomics.
+// Must match WIND_SPLAT_SCALE in windGrid.glsl.
+#define WIND_SPLAT_SCALE 65536.0
+
+// How far particles are kept off the surface of the collision mesh, so the next frame starts on the right side of it.
+#define MESH_COLLISION_OFFSET 0.001
+
+
+#ifdef MODULE_BATCH
+// Many systems that compile to the same program are updated together, see ParticleBatch.
+// Their particles are packed into one buffer, each system starting on a work group boundary,
+// so every work group belongs to a single system. What would be uniforms comes from that system's entry in a table.
+// Must match BatchSystem in particleBatch.cpp
+struct BatchSystem
+{
+	vec3 basePosition;
+	float burnRate;
+	vec3 acceleration;
+	float dt;
+	uint firstParticle;
+	uint particleCount;
+	int particleLimit;
+	uint padding;
+};
+
+layout(binding = 12) buffer batchSystemBlock
+{
+	BatchSystem batchSystems[];
+};
+
+// For each work group, which system it belongs to, and the first particle it handles.
+layout(binding = 13) buffer batchGroupBlock
+{
+	uvec2 batchGroups[];
+};
+
+// This work group's system, looked up at the start of main.
+BatchSystem batchSystem;
+#endif
 
 // Inputs from the particle system.
+#ifdef MODULE_BATCH
+#define dt batchSystem.dt
+#else
+uniform float dt;
+uniform int particleCount;
+#endif
+
+#ifdef BURN_RATE
+#define burnRate BURN_RATE
+#elif defined(MODULE_BATCH)
+#define burnRate batchSystem.burnRate
+#else
+uniform float burnRate;
+#endif
+
+#ifdef MODULE_SPAWN
+#ifdef BASE_POSITION
+#define basePosition BASE_POSITION
+#elif defined(MODULE_BATCH)
+#define basePosition batchSystem.basePosition
+#else
 uniform vec3 basePosition;
+#endif
+#endif
+
+#ifdef MODULE_MESH_EMITTER
+// Number of triangles in the emitter mesh.
+uniform int emitterTriangleCount;
+
+// Speed particles leave the surface of the emitter mesh at.
+#ifdef EMITTER_SPEED
+#define emitterSpeed EMITTER_SPEED
+#else
+uniform float emitterSpeed;
+#endif
+#endif
+
+#ifdef MODULE_FORCES
+#ifdef ACCELERATION
+#define acceleration ACCELERATION
+#elif defined(MODULE_BATCH)
+#define acceleration batchSystem.acceleration
+#else
 uniform vec3 acceleration;
-uniform float burnRate;
-uniform float dt;
+#endif
+uniform int forceFieldCount;
+#endif
+
+#ifdef MODULE_DEATH_EVENTS
+// Number of particles to request from the child system every time a particle dies.
+uniform int deathSpawnCount;
+
+// How much of the dying particle's velocity its children start with.
+uniform float inheritVelocity;
+#endif
+
+#ifdef MODULE_COLLISION_EVENTS
+// Same as above, for particles that bounce off the collision plane or mesh at least collisionImpactSpeed fast.
+uniform int collisionSpawnCount;
+uniform float collisionInheritVelocity;
+uniform float collisionImpactSpeed;
+#endif
+
+#ifdef MODULE_WIND
+// Velocity of the air at every cell of the wind grid, see windGrid.h.
+// Sampling it with linear filtering blends the 8 cells around a particle.
+uniform sampler3D windVelocity;
+uniform vec3 windBoundsMin;
+uniform vec3 windBoundsSize;
+#endif
+
+#ifdef MODULE_WIND_SPLAT
+uniform int windResolution;
+#endif
 
 
 // A basic definition of what our vertex data looks like.
@@ -38,10 +169,57 @@ struct VertexData
 {
     vec4 position;
     vec4 velocity;
-    vec4 color;
     float rotation;
     float angularVelocity;
     float age;
+    float restTime;     // Seconds the particle has barely moved for, see MODULE_SLEEP.
+};
+
+
+// A localized force, see ForceField in particleSystem.h.
+struct ForceField
+{
+	vec4 boundsMin;     // w: type
+	vec4 boundsMax;     // w: strength
+	vec4 center;        // w: radius
+	vec4 axis;          // w: half length of a vortex
+};
+
+
+// A request for one new particle, passed from a parent system to its child.
+struct SpawnRequest
+{
+	vec4 position;
+	vec4 velocity;
+};
+
+
+// One column of the alias table used to pick emitter triangles.
+// A column is picked uniformly, then either the column's own triangle, or its alias, is used.
+struct AliasEntry
+{
+	float probability;
+	uint alias;
+};
+
+
+// A node of the collision mesh's bounding volume hierarchy, see CollisionNode in collisionMesh.h.
+struct CollisionNode
+{
+	vec3 boundsMin;
+	int first;          // Internal nodes: left child, the next node if the box is hit. Leaves: ~triangle index.
+	vec3 boundsMax;
+	int miss;           // Next node once this subtree is done with, -1 when there is nothing left.
+};
+
+
+// Something that happened to a particle, for the CPU. See ParticleEvent in particleSystem.h.
+struct ParticleEvent
+{
+	vec3 position;
+	uint type;
+	vec3 velocity;
+	uint particle;
 };
 
 
@@ -51,57 +229,726 @@ layout(binding = 0) buffer block
 	VertexData data[];
 } outBuffer;
 
+#ifdef MODULE_FORCES
+layout(binding = 1) buffer forceFieldBlock
+{
+	ForceField forceFields[];
+};
+#endif
+
+#ifdef MODULE_DEATH_EVENTS
+// Requests this system appends for its child system when particles die.
+// count can go past the end of the array, requests that don't fit are dropped.
+layout(binding = 2) buffer deathSpawnBlock
+{
+	uint count;
+	uint consumed;
+	uint padding[2];
+	SpawnRequest requests[];
+} deathSpawns;
+#endif
+
+#ifdef MODULE_COLLISION_EVENTS
+// Requests for the collision child, laid out the same way.
+layout(binding = 15) buffer collisionSpawnBlock
+{
+	uint count;
+	uint consumed;
+	uint padding[2];
+	SpawnRequest requests[];
+} collisionSpawns;
+
+// Asks the collision child for particles where particle i just bounced, impactSpeed being how fast it went into the surface.
+// Called before the bounce, so the children inherit the velocity going in.
+void RequestCollisionSpawns(uint i, float impactSpeed)
+{
+	if (collisionSpawnCount <= 0 || impactSpeed < collisionImpactSpeed)
+	{
+		return;
+	}
+	uint first = atomicAdd(collisionSpawns.count, collisionSpawnCount);
+	for (uint k = 0; k < uint(collisionSpawnCount) && first + k < collisionSpawns.requests.length(); k++)
+	{
+		collisionSpawns.requests[first + k].position = outBuffer.data[i].position;
+		collisionSpawns.requests[first + k].velocity = outBuffer.data[i].velocity * collisionInheritVelocity;
+	}
+}
+#endif
+
+#ifdef MODULE_MESH_EMITTER
+// Emitter mesh triangles, relative to basePosition. Three corners per triangle.
+layout(binding = 4) buffer emitterTriangleBlock
+{
+	vec4 emitterVertices[];
+};
+
+// One entry per triangle, weighted by triangle area.
+layout(binding = 5) buffer emitterAliasBlock
+{
+	AliasEntry emitterAliases[];
+};
+#endif
+
+#ifdef MODULE_WIND_SPLAT
+// Momentum particles give back to the air, 3 ints per wind grid cell.
+layout(binding = 6) buffer windSplatBlock
+{
+	int windSplat[];
+};
+#endif
+
+#ifdef MODULE_MESH_COLLISION
+layout(binding = 7) buffer collisionNodeBlock
+{
+	CollisionNode collisionNodes[];
+};
+
+// Three corners for every triangle of the collision mesh.
+layout(binding = 8) buffer collisionTriangleBlock
+{
+	vec4 collisionVertices[];
+};
+#endif
+
+#ifdef MODULE_SLEEP
+// The particles that are awake, listed by the sleep pass. The first three values are the arguments for
+// glDispatchComputeIndirect, so the update only runs as many work groups as there are awake particles.
+layout(binding = 9) buffer awakeListBlock
+{
+	uint groupsX;
+	uint groupsY;
+	uint groupsZ;
+	uint count;
+	uint particles[];
+} awakeList;
+#endif
+
+#ifdef MODULE_EVENTS
+// Events this frame, copied back to the CPU a few frames later.
+// count can go past the end of the array, events that don't fit are dropped.
+layout(binding = 10) buffer eventBlock
+{
+	uint count;
+	uint padding[3];
+	ParticleEvent records[];
+} events;
+#endif
+
+#ifdef MODULE_BUDGET
+// How many particles each system in a ParticleBudget may have, worked out on the GPU every frame.
+// Only particles below this system's quota come back to life, the rest stay dead until the quota grows.
+uniform int budgetSlot;
+layout(binding = 11) buffer budgetBlock
+{
+	uint quotas[];
+} budget;
+#endif
 
-// This will just run once for each particle.
-layout(local_size_x = 1, local_size_y = 1, local_size_z = 1) in;
+// Only particles below this come back to life, see ParticleSystem::SetParticleLimit.
+// Batched systems always have one, counted from their first particle.
+#ifdef MODULE_BATCH
+#define particleLimit batchSystem.particleLimit
+#elif defined(MODULE_PARTICLE_LIMIT)
+uniform int particleLimit;
+#endif
 
+#ifdef MODULE_TRAILS
+// The last few places each particle has been, TRAIL_LENGTH points per particle used as a ring.
+// A particle's point k is where it was when it was k spacings into its life, wrapped around the ring.
+// w is how far into its life it was then, -1 for a point it hasn't made yet.
+layout(binding = 14) buffer trailBlock
+{
+	vec4 trailPoints[];
+};
+
+// Forgets the trail of a particle that is starting a new life.
+void ResetTrail(uint i)
+{
+	for (uint k = 0; k < TRAIL_LENGTH; k++)
+	{
+		trailPoints[i * TRAIL_LENGTH + k] = vec4(0, 0, 0, -1);
+	}
+}
+#endif
+
+#ifdef MODULE_SPAWN_REQUESTS
+// Requests this system receives from its parent, each one is used by one dead particle.
+layout(binding = 3) buffer incomingSpawnBlock
+{
+	uint count;
+	uint consumed;
+	uint padding[2];
+	SpawnRequest requests[];
+} incomingSpawns;
+#endif
+
+
+#ifdef MODULE_FORCES
+// Bounding box of the particles in this work group.
+shared vec3 groupMin[WORK_GROUP_SIZE];
+shared vec3 groupMax[WORK_GROUP_SIZE];
+
+// The force fields that overlap this work group's bounding box.
+// Particles only loop over these, instead of every force field.
+shared uint groupForceFields[MAX_GROUP_FORCE_FIELDS];
+shared uint groupForceFieldCount;
+#endif
+
+
+// Each work group updates WORK_GROUP_SIZE particles.
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+// An arbitrary "random" function found on the internet.
+// Gets a value between 0 and 1.
+float Random(vec2 seed)
+{
+	return fract(sin(dot(seed, vec2(12.9898,78.233))) * 43758.5453);
+}
+
+#ifdef MODULE_FORCES
+// Changes the velocity of a particle at position p by one force field.
+vec3 ApplyForceField(ForceField field, vec3 p, vec3 velocity)
+{
+	int type = int(field.boundsMin.w);
+	float strength = field.boundsMax.w;
+	float radius = field.center.w;
+
+	if (type == FORCE_ATTRACTOR)
+	{
+		// Pull towards the center, fading out to nothing at the radius.
+		vec3 r = field.center.xyz - p;
+		float distance = length(r);
+		if (distance < radius && distance > 0.0001)
+		{
+			velocity += r / distance * strength * (1 - distance / radius) * dt;
+		}
+	}
+	else if (type == FORCE_VORTEX)
+	{
+		// Spin around the axis, fading out to nothing at the radius.
+		vec3 r = p - field.center.xyz;
+		float along = dot(r, field.axis.xyz);
+		vec3 radial = r - field.axis.xyz * along;
+		float distance = length(radial);
+		if (abs(along) < field.axis.w && distance < radius && distance > 0.0001)
+		{
+			velocity += cross(field.axis.xyz, radial) / distance * strength * (1 - distance / radius) * dt;
+		}
+	}
+	else if (type == FORCE_DRAG)
+	{
+		// Slow down anything inside the box.
+		if (all(greaterThanEqual(p, field.boundsMin.xyz)) && all(lessThanEqual(p, field.boundsMax.xyz)))
+		{
+			velocity -= velocity * min(strength * dt, 1);
+		}
+	}
+	return velocity;
+}
+#endif
+
+#ifdef MODULE_EVENTS
+// Adds an event for the CPU, if there is still room for one this frame.
+void RecordEvent(uint type, uint particle, vec3 position, vec3 velocity)
+{
+	uint slot = atomicAdd(events.count, 1);
+	if (slot < events.records.length())
+	{
+		events.records[slot].position = position;
+		events.records[slot].type = type;
+		events.records[slot].velocity = velocity;
+		events.records[slot].particle = particle;
+	}
+}
+#endif
+
+#ifdef MODULE_MESH_COLLISION
+// True if the segment start + step * t, for t between 0 and maxT, goes through the box.
+bool SegmentHitsBox(vec3 start, vec3 inverseStep, float maxT, vec3 boxMin, vec3 boxMax)
+{
+	// Find where the segment goes in and out of the slab between the two planes on each axis.
+	vec3 t0 = (boxMin - start) * inverseStep;
+	vec3 t1 = (boxMax - start) * inverseStep;
+	vec3 tNear = min(t0, t1);
+	vec3 tFar = max(t0, t1);
+	float enter = max(max(tNear.x, tNear.y), max(tNear.z, 0));
+	float exit = min(min(tFar.x, tFar.y), min(tFar.z, maxT));
+	return enter <= exit;
+}
+
+// Finds t where the segment start + step * t goes through the triangle abc (Moller-Trumbore).
+// Returns 2 if it doesn't, anything above 1 is past the end of the segment.
+float SegmentHitsTriangle(vec3 start, vec3 step, vec3 a, vec3 b, vec3 c)
+{
+	vec3 edge1 = b - a;
+	vec3 edge2 = c - a;
+	vec3 p = cross(step, edge2);
+	float determinant = dot(edge1, p);
+
+	// Moving parallel to the triangle.
+	if (determinant == 0)
+	{
+		return 2;
+	}
+	float inverseDeterminant = 1 / determinant;
+
+	// Barycentric coordinates of the hit, both have to be inside the triangle.
+	vec3 s = start - a;
+	float u = dot(s, p) * inverseDeterminant;
+	if (u < 0 || u > 1)
+	{
+		return 2;
+	}
+	vec3 q = cross(s, edge1);
+	float v = dot(step, q) * inverseDeterminant;
+	if (v < 0 || u + v > 1)
+	{
+		return 2;
+	}
+
+	float t = dot(edge2, q) * inverseDeterminant;
+	return t >= 0 ? t : 2;
+}
+#endif
+
+#ifdef SLEEP_PASS
+// Sleeping particles inside this box wake up. The particle system grows it when something around them changes.
+uniform vec3 wakeMin;
+uniform vec3 wakeMax;
+
+shared uint groupAwakeCount;
+shared uint groupFirstSlot;
+
+// The sleep pass runs over every particle before the update, and lists the ones that are awake.
+// Sleeping particles are aged here, which is all they need, and are left out of the update until something wakes them.
+void main()
+{
+	uint i = gl_GlobalInvocationID.x;
+	uint local = gl_LocalInvocationID.x;
+	if (local == 0)
+	{
+		groupAwakeCount = 0;
+	}
+	barrier();
+
+	bool awake = false;
+	if (i < uint(particleCount))
+	{
+		awake = outBuffer.data[i].restTime < SLEEP_TIME;
+		if (!awake)
+		{
+			vec3 position = outBuffer.data[i].position.xyz;
+
+			// Particles that are about to die wake up, so the update can send death events and respawn them.
+			float age = outBuffer.data[i].age - dt * burnRate;
+			awake = age < 0 || (all(greaterThanEqual(position, wakeMin)) && all(lessThanEqual(position, wakeMax)));
+
+#ifdef MODULE_FORCES
+			// Force fields wake anything inside their bounding box.
+			for (int f = 0; f < forceFieldCount && !awake; f++)
+			{
+				awake = all(greaterThanEqual(position, forceFields[f].boundsMin.xyz)) && all(lessThanEqual(position, forceFields[f].boundsMax.xyz));
+			}
+#endif
+
+#ifdef MODULE_WIND
+			// So does air moving faster than a particle can sleep at.
+			vec3 windCoordinate = (position - windBoundsMin) / windBoundsSize;
+			if (!awake && all(greaterThanEqual(windCoordinate, vec3(0))) && all(lessThan(windCoordinate, vec3(1))))
+			{
+				awake = length(texture(windVelocity, windCoordinate).xyz) > SLEEP_SPEED;
+			}
+#endif
+
+			if (awake)
+			{
+				outBuffer.data[i].restTime = 0;
+			}
+			else
+			{
+				outBuffer.data[i].age = age;
+			}
+		}
+	}
+
+	uint slot = 0;
+	if (awake)
+	{
+		slot = atomicAdd(groupAwakeCount, 1);
+	}
+	barrier();
+
+	// One atomic per work group reserves room for all of its awake particles. The reserved ranges
+	// line up end to end, so adding up the update work groups each range finishes gives the total.
+	if (local == 0)
+	{
+		groupFirstSlot = atomicAdd(awakeList.count, groupAwakeCount);
+		uint groupsBefore = (groupFirstSlot + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE;
+		uint groupsAfter = (groupFirstSlot + groupAwakeCount + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE;
+		atomicAdd(awakeList.groupsX, groupsAfter - groupsBefore);
+	}
+	barrier();
+
+	if (awake)
+	{
+		awakeList.particles[groupFirstSlot + slot] = i;
+	}
+}
+#else
 // Declare main program function which is executed when
 void main()
 {
 
 	// Get the index of this object into the buffer
+	uint local = gl_LocalInvocationID.x;
+
+	// The last work group can run past the end of the buffer.
+	// Those invocations still have to take part in the culling below, so they can't return yet.
+	// They use the first particle in the group instead, which is always in range.
+#if defined(MODULE_BATCH)
+	batchSystem = batchSystems[batchGroups[gl_WorkGroupID.x].x];
+	uint groupFirstParticle = batchGroups[gl_WorkGroupID.x].y;
+	uint i = groupFirstParticle + local;
+	bool inRange = i - batchSystem.firstParticle < batchSystem.particleCount;
+#elif defined(MODULE_SLEEP)
+	// Only particles the sleep pass listed as awake are updated.
+	bool inRange = gl_GlobalInvocationID.x < awakeList.count;
+	uint groupFirstParticle = awakeList.particles[gl_WorkGroupID.x * WORK_GROUP_SIZE];
+	uint i = inRange ? awakeList.particles[gl_GlobalInvocationID.x] : groupFirstParticle;
+#else
 	uint i = gl_GlobalInvocationID.x;
+	bool inRange = i < uint(particleCount);
+	uint groupFirstParticle = gl_WorkGroupID.x * WORK_GROUP_SIZE;
+#endif
+
+	float age = 1;
+	if (inRange)
+	{
+		// Increment particle life
+		outBuffer.data[i].age -= dt * burnRate;
+
+		age = outBuffer.data[i].age;
+
+#ifdef MODULE_DEATH_EVENTS
+		// Tell the child system about particles that just died, so it can spawn its own particles there.
+		if (deathSpawnCount > 0 && age < 0 && age + dt * burnRate >= 0)
+		{
+			uint first = atomicAdd(deathSpawns.count, deathSpawnCount);
+			for (uint k = 0; k < uint(deathSpawnCount) && first + k < deathSpawns.requests.length(); k++)
+			{
+				deathSpawns.requests[first + k].position = outBuffer.data[i].position;
+				deathSpawns.requests[first + k].velocity = outBuffer.data[i].velocity * inheritVelocity;
+			}
+		}
+#endif
+
+#ifdef MODULE_EVENTS
+		if (age < 0 && age + dt * burnRate >= 0)
+		{
+			RecordEvent(EVENT_DEATH, i, outBuffer.data[i].position.xyz, outBuffer.data[i].velocity.xyz);
+		}
+#endif
 
-	// Increment particle life
-    outBuffer.data[i].age -= dt * burnRate;
+		bool withinBudget = true;
+#ifdef MODULE_BUDGET
+		withinBudget = i < budget.quotas[budgetSlot];
+#endif
+#if defined(MODULE_BATCH)
+		withinBudget = withinBudget && i - batchSystem.firstParticle < uint(particleLimit);
+#elif defined(MODULE_PARTICLE_LIMIT)
+		withinBudget = withinBudget && i < uint(particleLimit);
+#endif
+#if defined(MODULE_BUDGET) || defined(MODULE_PARTICLE_LIMIT) || defined(MODULE_BATCH)
+		// Particles over the quota or limit are held dead. Their age keeps wrapping around inside [-1, 0), so
+		// they don't all come back at the same moment when there is room again, and aren't mistaken for new deaths.
+		if (age < 0 && !withinBudget)
+		{
+			outBuffer.data[i].age = fract(age) - 1;
+		}
+#endif
 
-	float age = outBuffer.data[i].age;
+#if defined(MODULE_SPAWN)
+		// If the particle has reached the end of its life, reset it.
+		if (age < 0 && withinBudget)
+		{
+			float rand = Random(vec2(dt, i));
 
-	// If the particle has reached the end of its life, reset it.
-	if (age < 0)
-    {
-		// An arbitrary "random" function found on the internet.
-		// Gets a value between 0 and 1.
-		float rand = fract(sin(dot(vec2(dt, i) ,vec2(12.9898,78.233))) * 43758.5453);
-		
-		// Has to increment by one instead of just setting to one.
-		// Otherwise, when multiple particles reset in the same frame, they would become permanently synced.
-		outBuffer.data[i].age += 1;
+			// Has to increment by one instead of just setting to one.
+			// Otherwise, when multiple particles reset in the same frame, they would become permanently synced.
+			outBuffer.data[i].age += 1;
+			outBuffer.data[i].restTime = 0;
+			age = outBuffer.data[i].age;
+#ifdef MODULE_TRAILS
+			ResetTrail(i);
+#endif
 
-		// Starting rotation and angular velocity are distributed "randomly"
-		outBuffer.data[i].rotation = i % 7;
-		outBuffer.data[i].angularVelocity = i % 11;
+			// Starting rotation and angular velocity are distributed "randomly"
+			outBuffer.data[i].rotation = i % 7;
+			outBuffer.data[i].angularVelocity = i % 11;
 
-		// Move the particle back to the center.
-		outBuffer.data[i].position = vec4(basePosition, 1);
+#ifdef MODULE_MESH_EMITTER
+			// Pick a triangle with the alias table. Bigger triangles are picked more often,
+			// so particles are spread evenly over the surface, and it only takes one lookup.
+			uint column = min(uint(rand * emitterTriangleCount), uint(emitterTriangleCount - 1));
+			uint triangle = Random(vec2(i, dt)) < emitterAliases[column].probability ? column : emitterAliases[column].alias;
 
-		// Send the particle in a random direction.
-		outBuffer.data[i].velocity = vec4(cos(i + rand) * (5f), 0, sin(i + rand) * (5f), 0);
+			vec3 a = emitterVertices[triangle * 3].xyz;
+			vec3 b = emitterVertices[triangle * 3 + 1].xyz;
+			vec3 c = emitterVertices[triangle * 3 + 2].xyz;
+
+			// Uniform random point in the triangle.
+			float r1 = sqrt(Random(vec2(dt + i, i)));
+			float r2 = Random(vec2(i, dt + i));
+			vec3 surfacePoint = a * (1 - r1) + b * (r1 * (1 - r2)) + c * (r1 * r2);
+
+			// Leave the surface along its normal.
+			outBuffer.data[i].position = vec4(basePosition + surfacePoint, 1);
+			outBuffer.data[i].velocity = vec4(normalize(cross(b - a, c - a)) * emitterSpeed, 0);
+#else
+			// Move the particle back to the center.
+			outBuffer.data[i].position = vec4(basePosition, 1);
+
+			// Send the particle in a random direction.
+			outBuffer.data[i].velocity = vec4(cos(i + rand) * 5.0, 0, sin(i + rand) * 5.0, 0);
+#endif
+		}
+#elif defined(MODULE_SPAWN_REQUESTS)
+		if (age < 0 && withinBudget)
+		{
+			// Dead particles take the next unclaimed request from the parent, if there is one.
+			// Checking first saves every dead particle from hitting the same atomic once the requests run out.
+			uint available = min(incomingSpawns.count, incomingSpawns.requests.length());
+			uint request = incomingSpawns.consumed < available ? atomicAdd(incomingSpawns.consumed, 1) : available;
+			if (request < available)
+			{
+				// Burst out in a random direction, on top of the velocity passed down from the parent.
+				float theta = Random(vec2(dt, i)) * 6.2832;
+				float z = Random(vec2(i, dt)) * 2 - 1;
+				float speed = Random(vec2(dt + i, i)) * 5.0;
+				vec3 direction = vec3(sqrt(1 - z * z) * vec2(cos(theta), sin(theta)), z);
+
+				outBuffer.data[i].age = 1;
+				outBuffer.data[i].restTime = 0;
+#ifdef MODULE_TRAILS
+				ResetTrail(i);
+#endif
+				outBuffer.data[i].rotation = i % 7;
+				outBuffer.data[i].angularVelocity = i % 11;
+				outBuffer.data[i].position = incomingSpawns.requests[request].position;
+				outBuffer.data[i].velocity = incomingSpawns.requests[request].velocity + vec4(direction * speed, 0);
+				age = 1;
+			}
+		}
+#endif
+	}
+
+#ifdef MODULE_FORCES
+	if (forceFieldCount > 0)
+	{
+		// Find the bounding box of the work group. Invocations past the end use the
+		// first particle in the group, so they don't change the result.
+		vec3 position = outBuffer.data[inRange ? i : groupFirstParticle].position.xyz;
+		groupMin[local] = position;
+		groupMax[local] = position;
+		if (local == 0)
+		{
+			groupForceFieldCount = 0;
+		}
+		barrier();
+
+		for (uint stride = WORK_GROUP_SIZE / 2; stride > 0; stride /= 2)
+		{
+			if (local < stride)
+			{
+				groupMin[local] = min(groupMin[local], groupMin[local + stride]);
+				groupMax[local] = max(groupMax[local], groupMax[local + stride]);
+			}
+			barrier();
+		}
+
+		// Each invocation tests a few force fields against the box, and keeps the ones that overlap it.
+		for (uint f = local; f < uint(forceFieldCount); f += WORK_GROUP_SIZE)
+		{
+			if (all(lessThanEqual(forceFields[f].boundsMin.xyz, groupMax[0])) && all(greaterThanEqual(forceFields[f].boundsMax.xyz, groupMin[0])))
+			{
+				uint slot = atomicAdd(groupForceFieldCount, 1);
+				if (slot < MAX_GROUP_FORCE_FIELDS)
+				{
+					groupForceFields[slot] = f;
+				}
+			}
+		}
+		barrier();
+
+		if (inRange)
+		{
+			vec3 velocity = outBuffer.data[i].velocity.xyz;
+			uint count = min(groupForceFieldCount, MAX_GROUP_FORCE_FIELDS);
+			for (uint f = 0; f < count; f++)
+			{
+				velocity = ApplyForceField(forceFields[groupForceFields[f]], position, velocity);
+			}
+			outBuffer.data[i].velocity.xyz = velocity;
+		}
+	}
+#endif
+
+	// Nothing left to do for dead particles.
+	if (!inRange || age < 0)
+	{
+		return;
 	}
 
 	// Update the particle position
-    outBuffer.data[i].position += outBuffer.data[i].velocity * dt;
+	vec3 previous = outBuffer.data[i].position.xyz;
+	outBuffer.data[i].position += outBuffer.data[i].velocity * dt;
+
+#ifdef MODULE_MESH_COLLISION
+	// Find the first triangle along the path the particle just moved, by walking the collision mesh's tree.
+	// Each node says where to go next whether its box is hit or missed, so there is no stack to keep.
+	// Once a triangle is hit, only boxes closer than it are worth opening.
+	vec3 step = outBuffer.data[i].position.xyz - previous;
+	if (dot(step, step) > 0)
+	{
+		// Zero components become huge instead of infinite, so the box test never multiplies 0 by infinity.
+		vec3 inverseStep = 1 / mix(step, vec3(1e-20), equal(step, vec3(0)));
+		float closest = 1;
+		int hitTriangle = -1;
+
+		int node = 0;
+		while (node >= 0)
+		{
+			CollisionNode current = collisionNodes[node];
+			if (SegmentHitsBox(previous, inverseStep, closest, current.boundsMin, current.boundsMax))
+			{
+				if (current.first >= 0)
+				{
+					node = current.first;
+					continue;
+				}
+
+				int triangle = ~current.first;
+				float t = SegmentHitsTriangle(previous, step, collisionVertices[triangle * 3].xyz, collisionVertices[triangle * 3 + 1].xyz, collisionVertices[triangle * 3 + 2].xyz);
+				if (t <= closest)
+				{
+					closest = t;
+					hitTriangle = triangle;
+				}
+			}
+			node = current.miss;
+		}
+
+		if (hitTriangle >= 0)
+		{
+			// Stop just in front of the triangle, on the side the particle came from, and bounce off it.
+			vec3 a = collisionVertices[hitTriangle * 3].xyz;
+			vec3 normal = normalize(cross(collisionVertices[hitTriangle * 3 + 1].xyz - a, collisionVertices[hitTriangle * 3 + 2].xyz - a));
+			if (dot(normal, step) > 0)
+			{
+				normal = -normal;
+			}
+			outBuffer.data[i].position.xyz = previous + step * closest + normal * MESH_COLLISION_OFFSET;
+			float speed = dot(outBuffer.data[i].velocity.xyz, normal);
+			if (speed < 0)
+			{
+#ifdef MODULE_EVENTS
+				if (-speed >= EVENT_IMPACT_SPEED)
+				{
+					RecordEvent(EVENT_COLLISION, i, outBuffer.data[i].position.xyz, outBuffer.data[i].velocity.xyz);
+				}
+#endif
+#ifdef MODULE_COLLISION_EVENTS
+				RequestCollisionSpawns(i, -speed);
+#endif
+				outBuffer.data[i].velocity.xyz -= normal * speed * (1 + RESTITUTION);
+			}
+		}
+	}
+#endif
+
+#ifdef MODULE_COLLISION
+	// Push particles that went through the plane back out, and bounce them off it.
+	// The plane is (normal, distance), particles stay on the side where dot(normal, p) + distance >= 0.
+	float depth = dot(COLLISION_PLANE.xyz, outBuffer.data[i].position.xyz) + COLLISION_PLANE.w;
+	if (depth < 0)
+	{
+		outBuffer.data[i].position.xyz -= COLLISION_PLANE.xyz * depth;
+		float speed = dot(outBuffer.data[i].velocity.xyz, COLLISION_PLANE.xyz);
+		if (speed < 0)
+		{
+#ifdef MODULE_EVENTS
+			if (-speed >= EVENT_IMPACT_SPEED)
+			{
+				RecordEvent(EVENT_COLLISION, i, outBuffer.data[i].position.xyz, outBuffer.data[i].velocity.xyz);
+			}
+#endif
+#ifdef MODULE_COLLISION_EVENTS
+			RequestCollisionSpawns(i, -speed);
+#endif
+			outBuffer.data[i].velocity.xyz -= COLLISION_PLANE.xyz * speed * (1 + RESTITUTION);
+		}
+	}
+#endif
 
+#ifdef MODULE_DAMPING
 	// Dampen Velocity over time.
-	outBuffer.data[i].velocity -= outBuffer.data[i].velocity * dt * 5f;
+	outBuffer.data[i].velocity -= outBuffer.data[i].velocity * dt * DAMPING_RATE;
+#endif
 
+#ifdef MODULE_FORCES
 	// Apply acceleration
-    outBuffer.data[i].velocity += vec4(acceleration, 0) * dt;
+	outBuffer.data[i].velocity += vec4(acceleration, 0) * dt;
+#endif
+
+#ifdef MODULE_WIND
+	// Pull the particle towards the velocity of the air around it. Outside the grid, there is no wind.
+	vec3 windCoordinate = (outBuffer.data[i].position.xyz - windBoundsMin) / windBoundsSize;
+	if (all(greaterThanEqual(windCoordinate, vec3(0))) && all(lessThan(windCoordinate, vec3(1))))
+	{
+		vec3 change = (texture(windVelocity, windCoordinate).xyz - outBuffer.data[i].velocity.xyz) * min(WIND_COUPLING * dt, 1);
+		outBuffer.data[i].velocity.xyz += change;
+
+#ifdef MODULE_WIND_SPLAT
+		// Push the air in the particle's cell the other way, so particles can drag the air along with them.
+		ivec3 cell = ivec3(windCoordinate * windResolution);
+		int index = (cell.z * windResolution * windResolution + cell.y * windResolution + cell.x) * 3;
+		ivec3 momentum = ivec3(-change * WIND_SPLAT * WIND_SPLAT_SCALE);
+		atomicAdd(windSplat[index], momentum.x);
+		atomicAdd(windSplat[index + 1], momentum.y);
+		atomicAdd(windSplat[index + 2], momentum.z);
+#endif
+	}
+#endif
 
+#ifdef MODULE_ROTATION
 	// Apply rotation
-    outBuffer.data[i].rotation += outBuffer.data[i].angularVelocity * dt;
+	outBuffer.data[i].rotation += outBuffer.data[i].angularVelocity * dt;
+#endif
+
+#ifdef MODULE_SLEEP
+	// Count how long the particle has barely been moving. Once it has been long enough, it stops,
+	// and the sleep pass leaves it out of the update until something wakes it up.
+	if (length(outBuffer.data[i].position.xyz - previous) < SLEEP_SPEED * dt)
+	{
+		outBuffer.data[i].restTime += dt;
+		if (outBuffer.data[i].restTime >= SLEEP_TIME)
+		{
+			outBuffer.data[i].velocity.xyz = vec3(0);
+		}
+	}
+	else
+	{
+		outBuffer.data[i].restTime = 0;
+	}
+#endif
+
+#ifdef MODULE_TRAILS
+	// The point for the current spacing follows the particle, and is left behind once its life moves on to the next one.
+	float life = 1 - outBuffer.data[i].age;
+	uint point = uint(life / TRAIL_SPACING) % TRAIL_LENGTH;
+	trailPoints[i * TRAIL_LENGTH + point] = vec4(outBuffer.data[i].position.xyz, life);
+#endif
 
-	// Arbitrary color change formula, makes colors look cool
-	outBuffer.data[i].color = vec4(.2f / age, .1f / age, .6f * age, 1);
-	
-}
\ No newline at end of file
+	// Color isn't stored per particle, it is looked up from age when the particle is drawn.
+}
+#endif
@@ -25,7 +25,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #version 400 core
 
+#ifdef MODULE_FLIPBOOK
+// Every frame of the animation is a layer.
+uniform sampler2DArray tex;
+in float frame;
+#else
 uniform sampler2D tex;
+#endif
 
 in vec2 uv;
 in vec4 color;
@@ -34,5 +40,15 @@ in vec4 color;
 void main(void)
 {
 	// Easiest part, just sample from the texture and apply a color like normal.
+#if defined(FLIPBOOK_BLEND)
+	// Fade from the frame before into the frame after.
+	float first = floor(frame);
+	float second = min(first + 1, float(FLIPBOOK_FRAMES - 1));
+	vec4 texel = mix(texture(tex, vec3(uv, first)), texture(tex, vec3(uv, second)), frame - first);
+	gl_FragColor = texel * color;
+#elif defined(MODULE_FLIPBOOK)
+	gl_FragColor = texture(tex, vec3(uv, frame)) * color;
+#else
 	gl_FragColor = texture(tex, uv) * color; 
+#endif
 }
\ No newline at end of file
@@ -23,36 +23,167 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 
-#version 400 core
+#version 430 core
+
+// Like compute.glsl, this is compiled with a MODULE_ #define for each behaviour the particle system uses.
 
 // Scale used to convert particle size based on screen dimensions and particle size.
+// Particle size is compiled in as PARTICLE_SIZE when it never changes.
+#ifdef PARTICLE_SIZE
+#define particleSize PARTICLE_SIZE
+#else
 uniform vec2 particleSize;
+#endif
 uniform vec2 viewport;
 
+#ifdef MODULE_COLOR
+// Color and size over a particle's life, baked from curves (see lifetimeCurve.h).
+// The first row is color, and the red channel of the second row is size.
+// x is how far through its life the particle is, from 0 when it is born to 1 when it dies.
+uniform sampler2D lifetime;
+#endif
+
 layout(points) in;
 
-in vec4 vertOutColor[];
+#ifdef MODULE_ROTATION
 in float vertOutRotation[];
+#endif
 in float vertOutAge[];
 
+#ifdef MODULE_TRAILS
+// Points are brought into clip space here, since only the particle itself goes through the vertex shader.
+uniform mat4 cameraView;
+
+// The ring of past positions compute.glsl keeps for each particle, see MODULE_TRAILS there.
+layout(binding = 14) buffer trailBlock
+{
+	vec4 trailPoints[];
+};
+
+// Without culling every particle is drawn, so the primitive number is the particle number.
+#ifdef MODULE_CULLING
+in uint vertOutParticle[];
+#define PARTICLE_INDEX vertOutParticle[0]
+#else
+#define PARTICLE_INDEX uint(gl_PrimitiveIDIn)
+#endif
+
+// Two vertices per point, which is also enough for a quad.
+layout(triangle_strip, max_vertices = TRAIL_VERTICES) out;
+#else
 layout(triangle_strip, max_vertices = 4) out;
+#endif
 
 out vec2 uv;
 out vec4 color;
+#ifdef MODULE_FLIPBOOK
+// Flipbook frame to draw. With blending it has a fraction, and the fragment shader mixes the frames either side.
+out float frame;
+#endif
+
+#ifdef MODULE_TRAILS
+// Draws a ribbon from the particle back through its trail, facing the camera, narrowing and fading towards the tail.
+// Returns false without drawing anything if there aren't two points to draw between yet.
+bool EmitTrail(vec4 baseColor, float size)
+{
+	// Walk back around the ring from the newest point. Points from an earlier life,
+	// or left over from before the particle skipped ahead, are out of order, and end the trail.
+	float life = 1 - vertOutAge[0];
+	uint newest = uint(life / TRAIL_SPACING);
+	uint first = PARTICLE_INDEX * TRAIL_LENGTH;
+	vec4 points[TRAIL_LENGTH];
+	int count = 0;
+	float lastLife = life;
+	for (uint k = 0; k < TRAIL_LENGTH && k <= newest; k++)
+	{
+		vec4 point = trailPoints[first + (newest - k) % TRAIL_LENGTH];
+		if (point.w < 0 || point.w > lastLife)
+		{
+			break;
+		}
+		lastLife = point.w;
+		points[count] = cameraView * vec4(point.xyz, 1);
+		count++;
+	}
+	if (count < 2)
+	{
+		return false;
+	}
+
+	for (int k = 0; k < count; k++)
+	{
+		// Direction of the trail on screen, in pixels, from the neighbouring points.
+		vec4 newer = points[max(k - 1, 0)];
+		vec4 older = points[min(k + 1, count - 1)];
+		vec2 direction = (newer.xy / newer.w - older.xy / older.w) * viewport;
+		vec2 side = length(direction) > 0 ? normalize(vec2(-direction.y, direction.x)) : vec2(1, 0);
+
+		// Same width as the particle's quad at the head.
+		float along = float(k) / (count - 1);
+		float taper = 1 - along;
+		vec2 offset = side * particleSize.x * size * taper * .5 / viewport;
+		color = baseColor * vec4(1, 1, 1, taper);
+
+		uv = vec2(0, along);
+		gl_Position = points[k] + vec4(offset, 0, 0);
+		EmitVertex();
+		uv = vec2(1, along);
+		gl_Position = points[k] - vec4(offset, 0, 0);
+		EmitVertex();
+	}
+	EndPrimitive();
+	return true;
+}
+#endif
 
 void main()
 {
-	// Make the color fade with age (in 1 to 0 range)
-	color = vertOutColor[0];
+	// Dead particles are waiting to be spawned, don't draw them.
+	if (vertOutAge[0] <= 0)
+	{
+		return;
+	}
+
+#ifdef MODULE_COLOR
+	// Age counts down from 1 to 0, turn it around so the lookup goes from birth to death.
+	float lifeProgress = 1 - vertOutAge[0];
+	color = texture(lifetime, vec2(lifeProgress, .25));
+	float size = texture(lifetime, vec2(lifeProgress, .75)).r;
+#else
+	// Without the color module every particle looks the same for its whole life.
+	color = CONSTANT_COLOR;
+	float size = 1;
+#endif
+
+#ifdef MODULE_FLIPBOOK
+	// The animation plays once over the particle's life.
+#ifdef FLIPBOOK_BLEND
+	frame = (1 - vertOutAge[0]) * float(FLIPBOOK_FRAMES - 1);
+#else
+	frame = min(floor((1 - vertOutAge[0]) * float(FLIPBOOK_FRAMES)), float(FLIPBOOK_FRAMES - 1));
+#endif
+#endif
+
+#ifdef MODULE_TRAILS
+	// Particles that have only just been born have no trail yet, and are drawn as quads.
+	if (EmitTrail(color, size))
+	{
+		return;
+	}
+#endif
 
 	// Get the base position of the particle on screen.
 	vec4 pos = gl_in[0].gl_Position;
 	
 	// Make a transform matrix that rotates and scales vertices.
+	vec2 scale = particleSize / viewport;
+#ifdef MODULE_ROTATION
 	float c = cos(vertOutRotation[0]);
 	float s = sin(vertOutRotation[0]);
-	vec2 scale = particleSize / viewport;
-	mat2 T = mat2(c * scale.x, s * scale.y, -s * scale.x, c * scale.y) * vertOutAge[0];
+	mat2 T = mat2(c * scale.x, s * scale.y, -s * scale.x, c * scale.y) * size;
+#else
+	mat2 T = mat2(scale.x, 0, 0, scale.y) * size;
+#endif
 
 	// Make a quad:
 	// Generate 4 vertices
@@ -0,0 +1,105 @@
+/*
+Title: GPU Simulated Particle System
+File Name: gpuEmitters.glsl
+Copyright  2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+// Compute shaders are part of openGL core since version 4.3
+#version 430
+
+// Must match GPUEmitters::WORK_GROUP_SIZE
+#define WORK_GROUP_SIZE 256
+
+// Turns every emitter with one effect into spawn requests for that effect's particle system.
+// One invocation per emitter. The system picks the requests up in its next Update, the same way a child
+// picks up requests from its parent, so emitters never have to be seen by the CPU after they are written.
+uniform int emitterCount;
+uniform int effect;
+uniform float dt;
+uniform float inheritVelocity;
+
+// Must match GPUEmitter in gpuEmitters.h
+struct Emitter
+{
+	vec3 position;
+	float rate;			// Particles per second.
+	vec3 velocity;
+	int effect;			// Negative for none.
+};
+
+// Must match SpawnRequest in compute.glsl
+struct SpawnRequest
+{
+	vec4 position;
+	vec4 velocity;
+};
+
+// Written by gameplay code through a mapped buffer.
+layout(binding = 0) buffer emitterBlock
+{
+	Emitter emitters[];
+};
+
+// Part of a particle each emitter owes from earlier frames, so low rates still emit at the right average.
+layout(binding = 1) buffer carryBlock
+{
+	float carry[];
+};
+
+// The effect's system reads these as its incoming spawn requests.
+// count can go past the end of the array, requests that don't fit are dropped.
+layout(binding = 2) buffer spawnBlock
+{
+	uint count;
+	uint consumed;
+	uint padding[2];
+	SpawnRequest requests[];
+} spawns;
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+void main()
+{
+	uint e = gl_GlobalInvocationID.x;
+	if (e >= uint(emitterCount) || emitters[e].effect != effect)
+	{
+		return;
+	}
+
+	// Whole particles owed this frame, keeping the fraction for next time.
+	float owed = carry[e] + max(emitters[e].rate, 0) * dt;
+	uint spawnCount = uint(owed);
+	carry[e] = owed - spawnCount;
+	if (spawnCount == 0)
+	{
+		return;
+	}
+
+	// Spread the particles along the path the emitter took this frame, so fast emitters leave
+	// a continuous trail instead of a clump per frame.
+	vec3 position = emitters[e].position;
+	vec3 velocity = emitters[e].velocity;
+	uint first = atomicAdd(spawns.count, spawnCount);
+	for (uint k = 0; k < spawnCount && first + k < spawns.requests.length(); k++)
+	{
+		float back = (k + 0.5) / spawnCount * dt;
+		spawns.requests[first + k].position = vec4(position - velocity * back, 1);
+		spawns.requests[first + k].velocity = vec4(velocity * inheritVelocity, 0);
+	}
+}
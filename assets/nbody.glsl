@@ -0,0 +1,120 @@
+/*
+Title: GPU Simulated Particle System
+File Name: nbody.glsl
+Copyright  2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Compute shaders are part of openGL core since version 4.3
+#version 430
+
+// The number of particles handled by each work group.
+// This is also the number of particle positions loaded into shared memory at a time.
+// Must match ParticleSystem::WORK_GROUP_SIZE.
+#define TILE_SIZE 256
+
+
+// Inputs from the particle system.
+uniform vec3 acceleration;
+uniform float dt;
+uniform float particleMass;
+uniform float softening;
+uniform int particleCount;
+
+// 0 applies gravity to velocity, 1 moves the particles.
+// These have to be separate dispatches, otherwise some work groups would move
+// particles while others are still reading their old positions.
+uniform int stage;
+
+
+// A basic definition of what our vertex data looks like.
+struct VertexData
+{
+    vec4 position;
+    vec4 velocity;
+    float rotation;
+    float angularVelocity;
+    float age;
+};
+
+
+// A layout describing the vertex buffer.
+layout(binding = 0) buffer block
+{
+	VertexData data[];
+} outBuffer;
+
+
+// Every particle in a work group needs the position of every other particle.
+// Instead of each one reading every position from the buffer, the work group
+// loads one tile of positions into shared memory together, and they all read from there.
+shared vec4 tile[TILE_SIZE];
+
+layout(local_size_x = TILE_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+void main()
+{
+	// Get the index of this object into the buffer
+	uint i = gl_GlobalInvocationID.x;
+
+	// The last work group can hang off the end of the buffer.
+	// Those invocations still have to help load tiles, so they can't return yet.
+	bool inRange = i < uint(particleCount);
+
+	if (stage == 1)
+	{
+		if (inRange)
+		{
+			// Update the particle position and rotation
+			outBuffer.data[i].position += outBuffer.data[i].velocity * dt;
+			outBuffer.data[i].rotation += outBuffer.data[i].angularVelocity * dt;
+		}
+		return;
+	}
+
+	vec3 position = inRange ? outBuffer.data[i].position.xyz : vec3(0);
+	vec3 gravity = vec3(0);
+
+	// Softening keeps the force from going to infinity when two particles overlap.
+	float softeningSquared = softening * softening;
+
+	for (uint tileStart = 0; tileStart < uint(particleCount); tileStart += TILE_SIZE)
+	{
+		// Each invocation loads one position into the tile.
+		// The mass goes in w, so padding past the end of the buffer has no effect.
+		uint j = tileStart + gl_LocalInvocationID.x;
+		tile[gl_LocalInvocationID.x] = j < uint(particleCount) ? vec4(outBuffer.data[j].position.xyz, particleMass) : vec4(0);
+
+		// Wait until the whole tile is loaded.
+		barrier();
+
+		for (int k = 0; k < TILE_SIZE; k++)
+		{
+			// a = m * r / (|r|^2 + e^2)^(3/2)
+			vec3 r = tile[k].xyz - position;
+			float invDistance = inversesqrt(dot(r, r) + softeningSquared);
+			gravity += r * (tile[k].w * invDistance * invDistance * invDistance);
+		}
+
+		// Wait until everyone is done with the tile before it gets overwritten.
+		barrier();
+	}
+
+	if (inRange)
+	{
+		outBuffer.data[i].velocity += vec4(gravity + acceleration, 0) * dt;
+	}
+}
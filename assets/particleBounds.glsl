@@ -0,0 +1,147 @@
+/*
+Title: GPU Simulated Particle System
+File Name: particleBounds.glsl
+Copyright  2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Compute shaders are part of openGL core since version 4.3
+#version 430
+
+// Must match ParticleSystem::WORK_GROUP_SIZE
+#define WORK_GROUP_SIZE 256
+
+// Finds the box around every living particle in two stages.
+// Stage 0: every work group shrinks its particles down to one box in shared memory, and writes it out.
+// Stage 1: a single work group shrinks the boxes from stage 0 down to the final one, the same way.
+uniform int stage;
+uniform int particleCount;
+uniform int partialCount;
+
+// A basic definition of what our vertex data looks like.
+struct VertexData
+{
+    vec4 position;
+    vec4 velocity;
+    float rotation;
+    float angularVelocity;
+    float age;
+    float restTime;
+};
+
+// Must match ParticleBounds in particleSystem.h
+// An empty box is inside out, with min at +infinity and max at -infinity.
+struct Bounds
+{
+	vec3 boundsMin;
+	uint count;			// Living particles inside the box.
+	vec3 boundsMax;
+	float maxSpeed;		// Fastest living particle, for guessing how far the box could have moved since.
+};
+
+#define NO_BOUNDS 3.402823e38
+
+layout(binding = 0) buffer block
+{
+	VertexData data[];
+} particles;
+
+// A box per work group from stage 0.
+layout(binding = 1) buffer partialBlock
+{
+	Bounds partials[];
+};
+
+layout(binding = 2) buffer boundsBlock
+{
+	Bounds bounds;
+};
+
+shared vec3 sharedMin[WORK_GROUP_SIZE];
+shared vec3 sharedMax[WORK_GROUP_SIZE];
+shared uint sharedCount[WORK_GROUP_SIZE];
+shared float sharedMaxSpeed[WORK_GROUP_SIZE];
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+void main()
+{
+	uint i = gl_GlobalInvocationID.x;
+	uint local = gl_LocalInvocationID.x;
+
+	// Each invocation starts with one particle in stage 0, or every WORK_GROUP_SIZEth box in stage 1.
+	vec3 boundsMin = vec3(NO_BOUNDS);
+	vec3 boundsMax = vec3(-NO_BOUNDS);
+	uint count = 0;
+	float maxSpeed = 0;
+	if (stage == 0)
+	{
+		if (i < particleCount && particles.data[i].age >= 0)
+		{
+			boundsMin = particles.data[i].position.xyz;
+			boundsMax = boundsMin;
+			count = 1;
+			maxSpeed = length(particles.data[i].velocity.xyz);
+		}
+	}
+	else
+	{
+		for (uint partial = local; partial < partialCount; partial += WORK_GROUP_SIZE)
+		{
+			boundsMin = min(boundsMin, partials[partial].boundsMin);
+			boundsMax = max(boundsMax, partials[partial].boundsMax);
+			count += partials[partial].count;
+			maxSpeed = max(maxSpeed, partials[partial].maxSpeed);
+		}
+	}
+	sharedMin[local] = boundsMin;
+	sharedMax[local] = boundsMax;
+	sharedCount[local] = count;
+	sharedMaxSpeed[local] = maxSpeed;
+	barrier();
+
+	// Reduce the work group down to one box, halving the number of active invocations each step.
+	for (uint stride = WORK_GROUP_SIZE / 2; stride > 0; stride /= 2)
+	{
+		if (local < stride)
+		{
+			sharedMin[local] = min(sharedMin[local], sharedMin[local + stride]);
+			sharedMax[local] = max(sharedMax[local], sharedMax[local + stride]);
+			sharedCount[local] += sharedCount[local + stride];
+			sharedMaxSpeed[local] = max(sharedMaxSpeed[local], sharedMaxSpeed[local + stride]);
+		}
+		barrier();
+	}
+
+	if (local == 0)
+	{
+		if (stage == 0)
+		{
+			partials[gl_WorkGroupID.x].boundsMin = sharedMin[0];
+			partials[gl_WorkGroupID.x].boundsMax = sharedMax[0];
+			partials[gl_WorkGroupID.x].count = sharedCount[0];
+			partials[gl_WorkGroupID.x].maxSpeed = sharedMaxSpeed[0];
+		}
+		else
+		{
+			bounds.boundsMin = sharedMin[0];
+			bounds.boundsMax = sharedMax[0];
+			bounds.count = sharedCount[0];
+			bounds.maxSpeed = sharedMaxSpeed[0];
+		}
+	}
+}
@@ -0,0 +1,154 @@
+/*
+Title: GPU Simulated Particle System
+File Name: particleBudget.glsl
+Copyright  2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Compute shaders are part of openGL core since version 4.3
+#version 430
+
+// Must match ParticleBudget::MAX_SYSTEMS. Every system gets its own invocation in a single work group.
+#define MAX_SYSTEMS 256
+
+// Systems smaller than this are treated as this big, so a system that hasn't spawned anything yet still counts for something.
+#define MIN_RADIUS .1
+
+// Splits the particle cap between systems. Each system's importance is its priority times how big it looks from
+// the camera, and the most important systems are handed their whole request first. A prefix sum over the requests
+// in that order says how much of the cap is already taken by the time each system's turn comes.
+uniform int systemCount;
+uniform int particleCap;
+uniform vec3 cameraPosition;
+uniform mat4 viewProjection;
+uniform float offscreenImportance;
+
+// Must match ParticleBounds in particleSystem.h
+struct Bounds
+{
+	vec3 boundsMin;
+	uint count;
+	vec3 boundsMax;
+	float maxSpeed;
+};
+
+// Must match BudgetSystem in particleBudget.cpp
+struct System
+{
+	vec3 position;
+	float priority;
+	uint requested;
+	uint padding[3];
+};
+
+// Each system's box from this frame, copied out of their bounds buffers.
+layout(binding = 0) buffer boundsBlock
+{
+	Bounds bounds[];
+};
+
+layout(binding = 1) buffer systemBlock
+{
+	System systems[];
+};
+
+// Read by compute.glsl in every system on the budget.
+layout(binding = 2) buffer quotaBlock
+{
+	uint quotas[];
+};
+
+shared float sharedImportance[MAX_SYSTEMS];
+shared uint sharedRequested[MAX_SYSTEMS];
+
+layout(local_size_x = MAX_SYSTEMS, local_size_y = 1, local_size_z = 1) in;
+
+// True unless every corner of the box is outside the same side of the view.
+bool OnScreen(vec3 boundsMin, vec3 boundsMax)
+{
+	bvec3 outsideLow = bvec3(true);
+	bvec3 outsideHigh = bvec3(true);
+	for (int corner = 0; corner < 8; corner++)
+	{
+		vec3 p = mix(boundsMin, boundsMax, vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1));
+		vec4 clip = viewProjection * vec4(p, 1);
+		outsideLow = bvec3(ivec3(outsideLow) & ivec3(lessThan(clip.xyz, vec3(-clip.w))));
+		outsideHigh = bvec3(ivec3(outsideHigh) & ivec3(greaterThan(clip.xyz, vec3(clip.w))));
+	}
+	return !any(outsideLow) && !any(outsideHigh);
+}
+
+void main()
+{
+	uint s = gl_LocalInvocationID.x;
+	bool valid = s < uint(systemCount);
+
+	// How big the system looks: the radius of its box over the distance to it.
+	// The emitter is always included, so systems with nothing alive yet are still placed somewhere.
+	float importance = 0;
+	uint requested = 0;
+	if (valid)
+	{
+		vec3 boundsMin = min(bounds[s].boundsMin, systems[s].position);
+		vec3 boundsMax = max(bounds[s].boundsMax, systems[s].position);
+		vec3 center = (boundsMin + boundsMax) * .5;
+		float radius = max(length(boundsMax - boundsMin) * .5, MIN_RADIUS);
+		float distance = max(length(center - cameraPosition) - radius, MIN_RADIUS);
+		importance = systems[s].priority * radius / distance;
+		if (!OnScreen(boundsMin, boundsMax))
+		{
+			importance *= offscreenImportance;
+		}
+		requested = systems[s].requested;
+	}
+	sharedImportance[s] = importance;
+	barrier();
+
+	// Sort by importance. There are few enough systems to simply count how many come before this one.
+	// Ties go to the lower slot, so every system ends up with a different rank.
+	uint rank = s;
+	if (valid)
+	{
+		rank = 0;
+		for (uint other = 0; other < uint(systemCount); other++)
+		{
+			float otherImportance = sharedImportance[other];
+			if (otherImportance > importance || (otherImportance == importance && other < s))
+			{
+				rank++;
+			}
+		}
+	}
+	sharedRequested[rank] = requested;
+	barrier();
+
+	// Inclusive prefix sum of the requests in rank order. Each step adds the sum from stride places back.
+	for (uint stride = 1; stride < MAX_SYSTEMS; stride *= 2)
+	{
+		uint sum = sharedRequested[rank] + (rank >= stride ? sharedRequested[rank - stride] : 0);
+		barrier();
+		sharedRequested[rank] = sum;
+		barrier();
+	}
+
+	// Whatever the systems before this one left of the cap, up to what this one asked for.
+	if (valid)
+	{
+		uint taken = sharedRequested[rank] - requested;
+		quotas[s] = taken >= uint(particleCap) ? 0 : min(requested, uint(particleCap) - taken);
+	}
+}
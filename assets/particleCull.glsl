@@ -0,0 +1,144 @@
+/*
+Title: GPU Simulated Particle System
+File Name: particleCull.glsl
+Copyright  2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Compute shaders are part of openGL core since version 4.3
+#version 430
+
+// Must match ParticleSystem::WORK_GROUP_SIZE
+#define WORK_GROUP_SIZE 256
+
+// Lists the particles that can be seen, so only they go through the vertex and geometry shaders.
+// The list starts with the arguments for glDrawArraysIndirect, so the draw is sized on the GPU too.
+uniform int particleCount;
+
+// The matrix and viewport the system is drawn with, see ParticleSystem::SetView.
+uniform mat4 viewProjection;
+
+// How far quads reach out from their particle in clip space (before dividing by w), at the biggest they get.
+// Quads are added in clip space (see geometry.glsl), so this is the particle's bounding sphere, as seen by the frustum planes.
+uniform vec2 quadReach;
+
+// Which value in the draw arguments counts the visible particles: 0 for points (the vertex count),
+// or 1 for vertex-pulled quads, which are drawn as one instance each (the instance count).
+uniform int countIndex;
+
+// A basic definition of what our vertex data looks like.
+struct VertexData
+{
+    vec4 position;
+    vec4 velocity;
+    float rotation;
+    float angularVelocity;
+    float age;
+    float restTime;
+};
+
+layout(binding = 0) buffer block
+{
+	VertexData data[];
+} particles;
+
+#ifdef MODULE_TRAILS
+// The ring of past positions compute.glsl keeps for each particle. A ribbon can reach into view
+// while its particle is outside, so every point of it is tested too.
+layout(binding = 14) buffer trailBlock
+{
+	vec4 trailPoints[];
+};
+#endif
+
+// Also read by vertex.glsl and quadVertex.glsl, to find each particle they draw.
+layout(binding = 15) buffer visibleListBlock
+{
+	uint drawArguments[4];
+	uint particles[];
+} visibleList;
+
+shared uint groupVisibleCount;
+shared uint groupFirstSlot;
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+// One bit for each frustum plane the point's quad is entirely outside of.
+uint OutsidePlanes(vec4 position)
+{
+	vec4 clip = viewProjection * position;
+	uint outside = 0;
+	outside |= clip.x + quadReach.x < -clip.w ? 1u : 0u;
+	outside |= clip.x - quadReach.x > clip.w ? 2u : 0u;
+	outside |= clip.y + quadReach.y < -clip.w ? 4u : 0u;
+	outside |= clip.y - quadReach.y > clip.w ? 8u : 0u;
+	outside |= clip.z < -clip.w ? 16u : 0u;
+	outside |= clip.z > clip.w ? 32u : 0u;
+	return outside;
+}
+
+void main()
+{
+	uint i = gl_GlobalInvocationID.x;
+	uint local = gl_LocalInvocationID.x;
+
+	if (local == 0)
+	{
+		groupVisibleCount = 0;
+	}
+	barrier();
+
+	// Dead particles aren't drawn anyway. Living ones are kept unless they are entirely outside one of the
+	// six frustum planes, which in clip space are x, y and z against plus or minus w.
+	bool visible = false;
+	if (i < particleCount && particles.data[i].age > 0)
+	{
+		uint outside = OutsidePlanes(particles.data[i].position);
+#ifdef MODULE_TRAILS
+		// A ribbon is drawn between its points, so it is only outside a plane if all of them are.
+		// Points that aren't part of the trail anymore can only keep a particle that could have been culled.
+		for (uint k = 0; k < TRAIL_LENGTH; k++)
+		{
+			vec4 point = trailPoints[i * TRAIL_LENGTH + k];
+			if (point.w >= 0)
+			{
+				outside &= OutsidePlanes(vec4(point.xyz, 1));
+			}
+		}
+#endif
+		visible = outside == 0;
+	}
+
+	uint slot = 0;
+	if (visible)
+	{
+		slot = atomicAdd(groupVisibleCount, 1);
+	}
+	barrier();
+
+	// One atomic per work group reserves room for all of its visible particles.
+	if (local == 0)
+	{
+		groupFirstSlot = atomicAdd(visibleList.drawArguments[countIndex], groupVisibleCount);
+	}
+	barrier();
+
+	if (visible)
+	{
+		visibleList.particles[groupFirstSlot + slot] = i;
+	}
+}
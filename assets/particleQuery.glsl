@@ -0,0 +1,207 @@
+/*
+Title: GPU Simulated Particle System
+File Name: particleQuery.glsl
+Copyright  2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Compute shaders are part of openGL core since version 4.3
+#version 430
+
+// Must match ParticleQueries::WORK_GROUP_SIZE
+#define WORK_GROUP_SIZE 256
+
+// Must match ParticleQueryType in particleQueries.h
+#define QUERY_COUNT_IN_SPHERE 0
+#define QUERY_NEAREST_TO_RAY 1
+
+// Answers a whole batch of spatial queries in one dispatch.
+// Work groups go across the particles in x and across the queries in y. Each group boils its share of the particles
+// down to one partial result in shared memory, and whichever group finishes last for a query combines the partials.
+uniform int particleCount;
+
+// A basic definition of what our vertex data looks like.
+struct VertexData
+{
+    vec4 position;
+    vec4 velocity;
+    float rotation;
+    float angularVelocity;
+    float age;
+    float restTime;
+};
+
+// Must match ParticleQuery in particleQueries.h
+struct Query
+{
+	vec3 origin;		// Center of the sphere, or start of the ray.
+	int type;
+	vec3 direction;		// Unit direction of the ray.
+	float size;			// Radius of the sphere, or length of the ray.
+};
+
+// Must match QueryResult in particleQueries.cpp
+struct Result
+{
+	vec3 position;		// Position of the nearest particle.
+	float distance;		// Distance from the ray to the nearest particle.
+	uint count;			// Particles inside the sphere.
+	uint particle;		// Index of the nearest particle, NO_PARTICLE if there wasn't one.
+	uint padding0;
+	uint padding1;
+};
+
+#define NO_PARTICLE 0xFFFFFFFFu
+#define NO_DISTANCE 3.402823e38
+
+layout(binding = 0) buffer block
+{
+	VertexData data[];
+} particles;
+
+layout(binding = 1) buffer queryBlock
+{
+	Query queries[];
+};
+
+// One partial result per work group per query. Other groups read these, so they can't be cached.
+layout(binding = 2) coherent buffer partialBlock
+{
+	Result partials[];
+};
+
+// Counts how many groups have finished each query. Cleared to 0 before this runs.
+layout(binding = 3) buffer doneBlock
+{
+	uint groupsDone[];
+};
+
+layout(binding = 4) buffer resultBlock
+{
+	Result results[];
+};
+
+shared uint sharedCount[WORK_GROUP_SIZE];
+shared float sharedDistance[WORK_GROUP_SIZE];
+shared uint sharedParticle[WORK_GROUP_SIZE];
+shared bool lastGroup;
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+// Combines every invocation's count and nearest particle into the first one, by halving the active invocations every step.
+// Ties go to the lower particle index, so the answer doesn't depend on which group finished first.
+void Reduce(uint local)
+{
+	for (uint stride = WORK_GROUP_SIZE / 2; stride > 0; stride /= 2)
+	{
+		barrier();
+		if (local < stride)
+		{
+			sharedCount[local] += sharedCount[local + stride];
+			float otherDistance = sharedDistance[local + stride];
+			uint otherParticle = sharedParticle[local + stride];
+			if (otherDistance < sharedDistance[local] || (otherDistance == sharedDistance[local] && otherParticle < sharedParticle[local]))
+			{
+				sharedDistance[local] = otherDistance;
+				sharedParticle[local] = otherParticle;
+			}
+		}
+	}
+	barrier();
+}
+
+void main()
+{
+	uint i = gl_GlobalInvocationID.x;
+	uint local = gl_LocalInvocationID.x;
+	uint queryIndex = gl_WorkGroupID.y;
+	uint groupCount = gl_NumWorkGroups.x;
+	Query query = queries[queryIndex];
+
+	// Test this invocation's particle against the query. Dead particles don't count.
+	uint count = 0;
+	float distance = NO_DISTANCE;
+	uint particle = NO_PARTICLE;
+	if (i < particleCount && particles.data[i].age >= 0)
+	{
+		vec3 position = particles.data[i].position.xyz;
+		if (query.type == QUERY_COUNT_IN_SPHERE)
+		{
+			vec3 offset = position - query.origin;
+			count = dot(offset, offset) <= query.size * query.size ? 1 : 0;
+		}
+		else
+		{
+			// Only particles alongside the ray, not behind it or past the end.
+			float along = dot(position - query.origin, query.direction);
+			if (along >= 0 && along <= query.size)
+			{
+				distance = length(position - (query.origin + query.direction * along));
+				particle = i;
+			}
+		}
+	}
+	sharedCount[local] = count;
+	sharedDistance[local] = distance;
+	sharedParticle[local] = particle;
+	Reduce(local);
+
+	// Hand this group's result on, and find out if it was the last one.
+	if (local == 0)
+	{
+		uint partial = queryIndex * groupCount + gl_WorkGroupID.x;
+		partials[partial].count = sharedCount[0];
+		partials[partial].distance = sharedDistance[0];
+		partials[partial].particle = sharedParticle[0];
+
+		// Make sure the partial is visible before telling the other groups about it.
+		memoryBarrierBuffer();
+		lastGroup = atomicAdd(groupsDone[queryIndex], 1) == groupCount - 1;
+	}
+	barrier();
+	if (!lastGroup)
+	{
+		return;
+	}
+
+	// Every other group is done with this query, so combine all of their partials the same way.
+	count = 0;
+	distance = NO_DISTANCE;
+	particle = NO_PARTICLE;
+	for (uint group = local; group < groupCount; group += WORK_GROUP_SIZE)
+	{
+		Result partial = partials[queryIndex * groupCount + group];
+		count += partial.count;
+		if (partial.distance < distance || (partial.distance == distance && partial.particle < particle))
+		{
+			distance = partial.distance;
+			particle = partial.particle;
+		}
+	}
+	sharedCount[local] = count;
+	sharedDistance[local] = distance;
+	sharedParticle[local] = particle;
+	Reduce(local);
+
+	if (local == 0)
+	{
+		results[queryIndex].count = sharedCount[0];
+		results[queryIndex].distance = sharedDistance[0];
+		results[queryIndex].particle = sharedParticle[0];
+		results[queryIndex].position = sharedParticle[0] != NO_PARTICLE ? particles.data[sharedParticle[0]].position.xyz : vec3(0);
+	}
+}
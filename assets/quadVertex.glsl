@@ -0,0 +1,133 @@
+/*
+Title: GPU Simulated Particle System
+File Name: quadVertex.glsl
+Copyright  2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#version 430 core
+
+// Draws particles without a geometry shader. Instead of one point per particle, every particle is drawn
+// as an indexed quad: four vertices, each of which reads its particle straight from the particle buffer,
+// and works out the same rotated and sized corner geometry.glsl would have made.
+// Compiled with the same render defines as vertex.glsl and geometry.glsl, except MODULE_TRAILS, which needs the geometry shader.
+
+// camera view projection matrix.
+uniform mat4 cameraView;
+
+// Particle size is compiled in as PARTICLE_SIZE when it never changes.
+#ifdef PARTICLE_SIZE
+#define particleSize PARTICLE_SIZE
+#else
+uniform vec2 particleSize;
+#endif
+uniform vec2 viewport;
+
+#ifdef MODULE_COLOR
+// Color and size over a particle's life, see geometry.glsl.
+uniform sampler2D lifetime;
+#endif
+
+// Must match the particle struct in compute.glsl
+struct VertexData
+{
+	vec4 position;
+	vec4 velocity;
+	float rotation;
+	float angularVelocity;
+	float age;
+	float restTime;
+};
+
+layout(binding = 0) buffer block
+{
+	VertexData data[];
+} particles;
+
+#ifdef MODULE_CULLING
+// The particles that can be seen, listed by particleCull.glsl.
+layout(binding = 15) buffer visibleListBlock
+{
+	uint drawArguments[4];
+	uint particles[];
+} visibleList;
+#endif
+
+out vec2 uv;
+out vec4 color;
+#ifdef MODULE_FLIPBOOK
+out float frame;
+#endif
+
+void main(void)
+{
+#ifdef MODULE_CULLING
+	// Culled quads are drawn as a 4 vertex strip, one instance for each particle in the visible list.
+	int corner = gl_VertexID;
+	VertexData particle = particles.data[visibleList.particles[gl_InstanceID]];
+#else
+	// Four vertices per particle, one for each corner.
+	int corner = gl_VertexID % 4;
+	VertexData particle = particles.data[gl_VertexID / 4];
+#endif
+
+	uv = vec2(corner % 2, corner / 2);
+
+	// Dead particles are waiting to be spawned. Putting every corner in the same place outside the view
+	// makes triangles with no area, which are thrown away before any pixels are drawn.
+	if (particle.age <= 0)
+	{
+		color = vec4(0);
+#ifdef MODULE_FLIPBOOK
+		frame = 0;
+#endif
+		gl_Position = vec4(2, 2, 2, 1);
+		return;
+	}
+
+#ifdef MODULE_COLOR
+	// Age counts down from 1 to 0, turn it around so the lookup goes from birth to death.
+	float lifeProgress = 1 - particle.age;
+	color = texture(lifetime, vec2(lifeProgress, .25));
+	float size = texture(lifetime, vec2(lifeProgress, .75)).r;
+#else
+	color = CONSTANT_COLOR;
+	float size = 1;
+#endif
+
+#ifdef MODULE_FLIPBOOK
+	// The animation plays once over the particle's life.
+#ifdef FLIPBOOK_BLEND
+	frame = (1 - particle.age) * float(FLIPBOOK_FRAMES - 1);
+#else
+	frame = min(floor((1 - particle.age) * float(FLIPBOOK_FRAMES)), float(FLIPBOOK_FRAMES - 1));
+#endif
+#endif
+
+	// Same transform as geometry.glsl: rotate and scale the corner, then offset it from the particle on screen.
+	vec2 scale = particleSize / viewport;
+#ifdef MODULE_ROTATION
+	float c = cos(particle.rotation);
+	float s = sin(particle.rotation);
+	mat2 T = mat2(c * scale.x, s * scale.y, -s * scale.x, c * scale.y) * size;
+#else
+	mat2 T = mat2(scale.x, 0, 0, scale.y) * size;
+#endif
+
+	vec2 offset = T * (uv - vec2(0.5));
+	gl_Position = cameraView * particle.position + vec4(offset, 0, 0);
+}
@@ -0,0 +1,184 @@
+/*
+Title: GPU Simulated Particle System
+File Name: radixSort.glsl
+Copyright  2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Compute shaders are part of openGL core since version 4.3
+#version 430
+
+// Each invocation handles one element, so a work group covers a block of this many.
+// Must match ParallelPrimitives::WORK_GROUP_SIZE
+#define WORK_GROUP_SIZE 256
+
+// Each pass sorts by this many bits of the key.
+// Must match ParallelPrimitives::RADIX_BITS
+#define RADIX_BITS 4
+#define RADIX_SIZE (1 << RADIX_BITS)
+
+// Number of keys being sorted, and the number of blocks they are split into.
+uniform int count;
+uniform int blockCount;
+
+// Lowest bit of the digit this pass sorts by.
+uniform int shift;
+
+// 0: sort each block by the digit in shared memory, write it back in place, and count each digit in the block.
+// 1: move every element of the locally sorted blocks to its place in the output.
+uniform int mode;
+
+layout(binding = 0) buffer keyBlock
+{
+	uint keys[];
+};
+
+layout(binding = 1) buffer valueBlock
+{
+	uint values[];
+};
+
+layout(binding = 2) buffer sortedKeyBlock
+{
+	uint sortedKeys[];
+};
+
+layout(binding = 3) buffer sortedValueBlock
+{
+	uint sortedValues[];
+};
+
+// How many of each digit there are in each block, digit by digit: counts[digit * blockCount + block].
+// Laid out like that, an exclusive scan over the whole thing gives where each block's run of each digit starts in the output.
+layout(binding = 4) buffer countBlock
+{
+	uint counts[];
+};
+
+layout(binding = 5) buffer offsetBlock
+{
+	uint offsets[];
+};
+
+shared uint sharedKeys[WORK_GROUP_SIZE];
+shared uint sharedValues[WORK_GROUP_SIZE];
+shared uint sharedScan[WORK_GROUP_SIZE];
+shared uint digitCounts[RADIX_SIZE];
+shared uint digitStarts[RADIX_SIZE];
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+uint Digit(uint key)
+{
+	return (key >> uint(shift)) & uint(RADIX_SIZE - 1);
+}
+
+// Exclusive scan across the work group, in shared memory. Every invocation gets the total.
+uint WorkGroupScan(uint value, out uint total)
+{
+	uint local = gl_LocalInvocationID.x;
+	sharedScan[local] = value;
+	barrier();
+	for (uint distance = 1; distance < WORK_GROUP_SIZE; distance *= 2)
+	{
+		uint sum = local >= distance ? sharedScan[local - distance] : 0;
+		barrier();
+		sharedScan[local] += sum;
+		barrier();
+	}
+	uint inclusive = sharedScan[local];
+	total = sharedScan[WORK_GROUP_SIZE - 1];
+	barrier();
+	return inclusive - value;
+}
+
+void main()
+{
+	uint local = gl_LocalInvocationID.x;
+	uint i = gl_WorkGroupID.x * WORK_GROUP_SIZE + local;
+	bool inRange = i < uint(count);
+
+	if (local < RADIX_SIZE)
+	{
+		digitCounts[local] = 0;
+	}
+
+	if (mode == 0)
+	{
+		// The last block is padded with the largest key, so the padding sorts after everything real.
+		uint key = inRange ? keys[i] : 0xFFFFFFFF;
+		uint value = inRange ? values[i] : 0;
+
+		// Sort the block one bit at a time. Each step is a stable split, zeros first, then ones,
+		// so elements with the same digit stay in the order they came in.
+		for (uint bit = 0; bit < RADIX_BITS; bit++)
+		{
+			uint one = (key >> (uint(shift) + bit)) & 1u;
+			uint ones;
+			uint onesBefore = WorkGroupScan(one, ones);
+			uint destination = one == 0 ? local - onesBefore : WORK_GROUP_SIZE - ones + onesBefore;
+			sharedKeys[destination] = key;
+			sharedValues[destination] = value;
+			barrier();
+			key = sharedKeys[local];
+			value = sharedValues[local];
+			barrier();
+		}
+
+		// Only real elements end up in the first part of the block, so they are the only ones written back and counted.
+		if (inRange)
+		{
+			keys[i] = key;
+			values[i] = value;
+			atomicAdd(digitCounts[Digit(key)], 1);
+		}
+		barrier();
+		if (local < RADIX_SIZE)
+		{
+			counts[local * uint(blockCount) + gl_WorkGroupID.x] = digitCounts[local];
+		}
+		return;
+	}
+
+	// The block is already sorted by digit, so each element's place among elements with the same digit
+	// is its distance from the start of that digit's run.
+	uint key = inRange ? keys[i] : 0;
+	barrier();
+	if (inRange)
+	{
+		atomicAdd(digitCounts[Digit(key)], 1);
+	}
+	barrier();
+	if (local == 0)
+	{
+		uint start = 0;
+		for (uint digit = 0; digit < RADIX_SIZE; digit++)
+		{
+			digitStarts[digit] = start;
+			start += digitCounts[digit];
+		}
+	}
+	barrier();
+
+	if (inRange)
+	{
+		uint digit = Digit(key);
+		uint destination = offsets[digit * uint(blockCount) + gl_WorkGroupID.x] + local - digitStarts[digit];
+		sortedKeys[destination] = key;
+		sortedValues[destination] = values[i];
+	}
+}
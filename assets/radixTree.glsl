@@ -0,0 +1,129 @@
+/*
+Title: GPU Simulated Particle System
+File Name: radixTree.glsl
+Copyright  2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Compute shaders are part of openGL core since version 4.3
+#version 430
+
+#define WORK_GROUP_SIZE 256
+
+// Builds a binary radix tree over sorted morton codes (Karras 2012, "Maximizing Parallelism in the Construction of BVHs, Octrees, and k-d Trees").
+// Each internal node is found independently, so every node is built in parallel.
+// Nodes 0 to leafCount - 2 are internal nodes, with node 0 as the root.
+// Nodes leafCount - 1 to 2 * leafCount - 2 are leaves, one for each sorted key.
+uniform int leafCount;
+
+// Sorted by bitonicSort.glsl
+layout(binding = 0) buffer keyBlock
+{
+	uint keys[];
+};
+
+// Left and right child of each internal node.
+layout(binding = 1) buffer childBlock
+{
+	ivec2 children[];
+};
+
+// Parent of every node, -1 for the root.
+layout(binding = 2) buffer parentBlock
+{
+	int parents[];
+};
+
+// Length of the common prefix of keys a and b, or -1 if b is out of range.
+// Equal keys fall back to comparing the indices, so every key is effectively unique.
+int Delta(int a, int b)
+{
+	if (b < 0 || b >= leafCount)
+	{
+		return -1;
+	}
+
+	uint difference = keys[a] ^ keys[b];
+	if (difference == 0)
+	{
+		return 32 + 31 - findMSB(uint(a ^ b));
+	}
+	return 31 - findMSB(difference);
+}
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+void main()
+{
+	int i = int(gl_GlobalInvocationID.x);
+	if (i >= leafCount - 1)
+	{
+		return;
+	}
+
+	// Find which direction the range of keys under this node extends.
+	int direction = sign(Delta(i, i + 1) - Delta(i, i - 1));
+	int minDelta = Delta(i, i - direction);
+
+	// Find an upper bound on the length of the range.
+	int maxLength = 2;
+	while (Delta(i, i + maxLength * direction) > minDelta)
+	{
+		maxLength *= 2;
+	}
+
+	// Binary search for the other end of the range.
+	int length = 0;
+	for (int step = maxLength / 2; step >= 1; step /= 2)
+	{
+		if (Delta(i, i + (length + step) * direction) > minDelta)
+		{
+			length += step;
+		}
+	}
+	int other = i + length * direction;
+
+	// Binary search for where the range splits between the two children.
+	int nodeDelta = Delta(i, other);
+	int split = 0;
+	int divisor = 2;
+	for (int step = (length + 1) / 2; step >= 1; step = (length + divisor - 1) / divisor)
+	{
+		if (Delta(i, i + (split + step) * direction) > nodeDelta)
+		{
+			split += step;
+		}
+		if (step == 1)
+		{
+			break;
+		}
+		divisor *= 2;
+	}
+	int gamma = i + split * direction + min(direction, 0);
+
+	// A child that covers a single key is a leaf.
+	int left = min(i, other) == gamma ? leafCount - 1 + gamma : gamma;
+	int right = max(i, other) == gamma + 1 ? leafCount + gamma : gamma + 1;
+
+	children[i] = ivec2(left, right);
+	parents[left] = i;
+	parents[right] = i;
+
+	if (i == 0)
+	{
+		parents[0] = -1;
+	}
+}
@@ -0,0 +1,105 @@
+/*
+Title: GPU Simulated Particle System
+File Name: reduce.glsl
+Copyright  2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Compute shaders are part of openGL core since version 4.3
+#version 430
+
+// Each invocation combines two elements, so a work group reduces a block of twice this many to one value.
+// Must match ParallelPrimitives::WORK_GROUP_SIZE
+#define WORK_GROUP_SIZE 256
+#define BLOCK_SIZE (WORK_GROUP_SIZE * 2)
+
+// Number of elements being reduced.
+uniform int count;
+
+// How elements are combined, must match ReduceOperation. 0: sum, 1: minimum, 2: maximum.
+uniform int operation;
+
+layout(binding = 0) buffer inputBlock
+{
+	float inputs[];
+};
+
+// One value for each block.
+layout(binding = 1) buffer outputBlock
+{
+	float outputs[];
+};
+
+shared float sharedValues[WORK_GROUP_SIZE];
+
+float Combine(float a, float b)
+{
+	if (operation == 1)
+	{
+		return min(a, b);
+	}
+	if (operation == 2)
+	{
+		return max(a, b);
+	}
+	return a + b;
+}
+
+// The value that doesn't change anything it is combined with, used for elements past the end.
+float Identity()
+{
+	if (operation == 1)
+	{
+		return uintBitsToFloat(0x7F800000);
+	}
+	if (operation == 2)
+	{
+		return -uintBitsToFloat(0x7F800000);
+	}
+	return 0;
+}
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+void main()
+{
+	uint local = gl_LocalInvocationID.x;
+	uint a = gl_WorkGroupID.x * BLOCK_SIZE + local;
+	uint b = a + WORK_GROUP_SIZE;
+
+	float value = a < uint(count) ? inputs[a] : Identity();
+	if (b < uint(count))
+	{
+		value = Combine(value, inputs[b]);
+	}
+	sharedValues[local] = value;
+
+	// Halve the number of values each step, until only one is left.
+	for (uint width = WORK_GROUP_SIZE / 2; width > 0; width /= 2)
+	{
+		barrier();
+		if (local < width)
+		{
+			sharedValues[local] = Combine(sharedValues[local], sharedValues[local + width]);
+		}
+	}
+
+	if (local == 0)
+	{
+		outputs[gl_WorkGroupID.x] = sharedValues[0];
+	}
+}
@@ -0,0 +1,126 @@
+/*
+Title: GPU Simulated Particle System
+File Name: scan.glsl
+Copyright  2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Compute shaders are part of openGL core since version 4.3
+#version 430
+
+// Each invocation handles two elements, so a work group scans a block of twice this many.
+// Must match ParallelPrimitives::WORK_GROUP_SIZE
+#define WORK_GROUP_SIZE 256
+#define BLOCK_SIZE (WORK_GROUP_SIZE * 2)
+
+// Number of elements being scanned.
+uniform int count;
+
+// 0: exclusive scan of each block in shared memory, writing the block's total to blockSums.
+// 1: add the scanned block totals to every element of their block, once blockSums has been scanned itself.
+uniform int mode;
+
+// Input and output can be the same buffer, each work group reads all of its block before writing any of it.
+layout(binding = 0) buffer inputBlock
+{
+	uint inputs[];
+};
+
+layout(binding = 1) buffer outputBlock
+{
+	uint outputs[];
+};
+
+layout(binding = 2) buffer sumBlock
+{
+	uint blockSums[];
+};
+
+shared uint sharedSums[BLOCK_SIZE];
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+void main()
+{
+	uint local = gl_LocalInvocationID.x;
+	uint a = gl_WorkGroupID.x * BLOCK_SIZE + local;
+	uint b = a + WORK_GROUP_SIZE;
+
+	if (mode == 1)
+	{
+		uint blockSum = blockSums[gl_WorkGroupID.x];
+		if (a < uint(count))
+		{
+			outputs[a] += blockSum;
+		}
+		if (b < uint(count))
+		{
+			outputs[b] += blockSum;
+		}
+		return;
+	}
+
+	// Elements past the end count as 0, so they don't change the total.
+	sharedSums[local] = a < uint(count) ? inputs[a] : 0;
+	sharedSums[local + WORK_GROUP_SIZE] = b < uint(count) ? inputs[b] : 0;
+
+	// Work efficient scan (Blelloch). First build a tree of partial sums in place, from the leaves up...
+	uint stride = 1;
+	for (uint width = BLOCK_SIZE / 2; width > 0; width /= 2)
+	{
+		barrier();
+		if (local < width)
+		{
+			uint left = stride * (2 * local + 1) - 1;
+			uint right = stride * (2 * local + 2) - 1;
+			sharedSums[right] += sharedSums[left];
+		}
+		stride *= 2;
+	}
+
+	// ...then the root holds the total. Clear it, and push the sums back down,
+	// so every element ends up with the sum of everything before it.
+	barrier();
+	if (local == 0)
+	{
+		blockSums[gl_WorkGroupID.x] = sharedSums[BLOCK_SIZE - 1];
+		sharedSums[BLOCK_SIZE - 1] = 0;
+	}
+	for (uint width = 1; width < BLOCK_SIZE; width *= 2)
+	{
+		stride /= 2;
+		barrier();
+		if (local < width)
+		{
+			uint left = stride * (2 * local + 1) - 1;
+			uint right = stride * (2 * local + 2) - 1;
+			uint sum = sharedSums[left];
+			sharedSums[left] = sharedSums[right];
+			sharedSums[right] += sum;
+		}
+	}
+	barrier();
+
+	if (a < uint(count))
+	{
+		outputs[a] = sharedSums[local];
+	}
+	if (b < uint(count))
+	{
+		outputs[b] = sharedSums[local + WORK_GROUP_SIZE];
+	}
+}
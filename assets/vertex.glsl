@@ -23,30 +23,68 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 
-#version 400 core
+#version 430 core
 
 // camera view projection matrix.
 uniform mat4 cameraView;
 
-// Vertex attributes for every variable in the particle struct
+#ifdef MODULE_CULLING
+// With culling, only the particles in the visible list are drawn (see particleCull.glsl),
+// so each vertex looks up its particle and reads it from the particle buffer, instead of using attributes.
+struct VertexData
+{
+	vec4 position;
+	vec4 velocity;
+	float rotation;
+	float angularVelocity;
+	float age;
+	float restTime;
+};
+
+layout(binding = 0) buffer block
+{
+	VertexData data[];
+} particles;
+
+layout(binding = 15) buffer visibleListBlock
+{
+	uint drawArguments[4];
+	uint particles[];
+} visibleList;
+
+// Points are numbered by their place in the list, so trails need to be told which particle they belong to.
+out uint vertOutParticle;
+#else
+// Vertex attributes for the variables in the particle struct that are drawn with.
+// Locations match the order of the struct, velocity (1) and angular velocity (3) are left out.
 layout(location = 0) in vec4 in_position;
-layout(location = 1) in vec4 in_velocity;
-layout(location = 2) in vec4 in_color;
-layout(location = 3) in float in_rotation;
-layout(location = 4) in float in_angular;
-layout(location = 5) in float in_age;
+#ifdef MODULE_ROTATION
+layout(location = 2) in float in_rotation;
+#endif
+layout(location = 4) in float in_age;
+#endif
 
-out vec4 vertOutColor;
+#ifdef MODULE_ROTATION
 out float vertOutRotation;
+#endif
 out float vertOutAge;
 
 void main(void)
 {
+#ifdef MODULE_CULLING
+	uint particle = visibleList.particles[gl_VertexID];
+	vec4 in_position = particles.data[particle].position;
+	float in_rotation = particles.data[particle].rotation;
+	float in_age = particles.data[particle].age;
+	vertOutParticle = particle;
+#endif
+
 	// Move the vertex position into clip space.
 	gl_Position = cameraView * in_position;
 
-	// Pass color, rotation, and age forward to the geometry shader.
-	vertOutColor = in_color;
+	// Pass rotation and age forward to the geometry shader.
+#ifdef MODULE_ROTATION
 	vertOutRotation = in_rotation;
+#endif
 	vertOutAge = in_age;
 }
\ No newline at end of file
@@ -0,0 +1,160 @@
+/*
+Title: GPU Simulated Particle System
+File Name: windGrid.glsl
+Copyright  2026
+Author: GPU Simulated Particle System contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Compute shaders are part of openGL core since version 4.3
+#version 430
+
+// A coarse grid of air velocity, simulated with stable fluids (Jos Stam, 1999).
+// Every cell stores the velocity of the air at its center. Each frame runs these stages, one dispatch each:
+// 0: add forces: momentum splatted by particles, and impulses from the CPU.
+// 1: advect: every cell looks back along its velocity, and takes the velocity it finds there.
+// 2: divergence: how much air is flowing out of every cell.
+// 3: pressure: one Jacobi iteration, run many times, solving for the pressure that cancels the divergence.
+// 4: project: subtract the pressure gradient, leaving air that doesn't compress.
+// Outside the grid, pressure and velocity are treated as 0, so air can flow in and out of the sides.
+
+
+// Must match WindGrid::WORK_GROUP_SIZE
+#define WORK_GROUP_SIZE 4
+
+// Particles splat momentum as fixed point integers, because there are no float atomics.
+// Must match WIND_SPLAT_SCALE in compute.glsl.
+#define WIND_SPLAT_SCALE 65536.0
+
+#define STAGE_FORCES 0
+#define STAGE_ADVECT 1
+#define STAGE_DIVERGENCE 2
+#define STAGE_PRESSURE 3
+#define STAGE_PROJECT 4
+
+
+uniform int stage;
+uniform float dt;
+uniform int resolution;
+
+// Size of one cell in world space.
+uniform vec3 cellSize;
+uniform vec3 boundsMin;
+
+// Fraction of the velocity lost every second.
+uniform float dissipation;
+
+uniform int impulseCount;
+
+
+// A push of air from the CPU, fading out to nothing at the radius.
+struct Impulse
+{
+	vec4 position;      // w: radius
+	vec4 velocity;
+};
+
+layout(binding = 0) buffer splatBlock
+{
+	int splat[];
+};
+
+layout(binding = 1) buffer impulseBlock
+{
+	Impulse impulses[];
+};
+
+// Velocity is read with filtering while advecting, and read and written directly the rest of the time.
+uniform sampler3D velocitySampler;
+layout(rgba32f, binding = 0) uniform readonly image3D velocityIn;
+layout(rgba32f, binding = 1) uniform image3D velocityOut;
+layout(r32f, binding = 2) uniform readonly image3D pressureIn;
+layout(r32f, binding = 3) uniform writeonly image3D pressureOut;
+layout(r32f, binding = 4) uniform image3D divergence;
+
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = WORK_GROUP_SIZE, local_size_z = WORK_GROUP_SIZE) in;
+
+void main()
+{
+	ivec3 cell = ivec3(gl_GlobalInvocationID);
+	if (any(greaterThanEqual(cell, ivec3(resolution))))
+	{
+		return;
+	}
+
+	if (stage == STAGE_FORCES)
+	{
+		vec3 velocity = imageLoad(velocityOut, cell).xyz;
+
+		// Take the momentum particles added last frame, and empty the cell for this frame.
+		int index = (cell.z * resolution * resolution + cell.y * resolution + cell.x) * 3;
+		velocity += vec3(splat[index], splat[index + 1], splat[index + 2]) / WIND_SPLAT_SCALE;
+		splat[index] = 0;
+		splat[index + 1] = 0;
+		splat[index + 2] = 0;
+
+		vec3 position = boundsMin + (vec3(cell) + .5) * cellSize;
+		for (int i = 0; i < impulseCount; i++)
+		{
+			float radius = impulses[i].position.w;
+			float distance = length(position - impulses[i].position.xyz);
+			if (distance < radius)
+			{
+				velocity += impulses[i].velocity.xyz * (1 - distance / radius) * dt;
+			}
+		}
+
+		velocity -= velocity * min(dissipation * dt, 1);
+		imageStore(velocityOut, cell, vec4(velocity, 0));
+	}
+	else if (stage == STAGE_ADVECT)
+	{
+		// Trace back in cell units, and let the sampler blend the 8 cells around where it lands.
+		vec3 velocity = texelFetch(velocitySampler, cell, 0).xyz;
+		vec3 from = vec3(cell) + .5 - velocity * dt / cellSize;
+		imageStore(velocityOut, cell, texture(velocitySampler, from / resolution));
+	}
+	else if (stage == STAGE_DIVERGENCE)
+	{
+		float right = imageLoad(velocityIn, cell + ivec3(1, 0, 0)).x;
+		float left = imageLoad(velocityIn, cell - ivec3(1, 0, 0)).x;
+		float up = imageLoad(velocityIn, cell + ivec3(0, 1, 0)).y;
+		float down = imageLoad(velocityIn, cell - ivec3(0, 1, 0)).y;
+		float front = imageLoad(velocityIn, cell + ivec3(0, 0, 1)).z;
+		float back = imageLoad(velocityIn, cell - ivec3(0, 0, 1)).z;
+		float flow = (right - left) / cellSize.x + (up - down) / cellSize.y + (front - back) / cellSize.z;
+		imageStore(divergence, cell, vec4(flow * .5));
+	}
+	else if (stage == STAGE_PRESSURE)
+	{
+		// Assumes roughly cube shaped cells, which is what the pressure solve needs to converge nicely anyway.
+		float neighbours = imageLoad(pressureIn, cell + ivec3(1, 0, 0)).x + imageLoad(pressureIn, cell - ivec3(1, 0, 0)).x
+			+ imageLoad(pressureIn, cell + ivec3(0, 1, 0)).x + imageLoad(pressureIn, cell - ivec3(0, 1, 0)).x
+			+ imageLoad(pressureIn, cell + ivec3(0, 0, 1)).x + imageLoad(pressureIn, cell - ivec3(0, 0, 1)).x;
+		float h = (cellSize.x + cellSize.y + cellSize.z) / 3;
+		float pressure = (neighbours - imageLoad(divergence, cell).x * h * h) / 6;
+		imageStore(pressureOut, cell, vec4(pressure));
+	}
+	else if (stage == STAGE_PROJECT)
+	{
+		vec3 gradient = vec3(
+			imageLoad(pressureIn, cell + ivec3(1, 0, 0)).x - imageLoad(pressureIn, cell - ivec3(1, 0, 0)).x,
+			imageLoad(pressureIn, cell + ivec3(0, 1, 0)).x - imageLoad(pressureIn, cell - ivec3(0, 1, 0)).x,
+			imageLoad(pressureIn, cell + ivec3(0, 0, 1)).x - imageLoad(pressureIn, cell - ivec3(0, 0, 1)).x) * .5 / cellSize;
+		vec3 velocity = imageLoad(velocityOut, cell).xyz - gradient;
+		imageStore(velocityOut, cell, vec4(velocity, 0));
+	}
+}